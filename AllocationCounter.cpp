@@ -0,0 +1,49 @@
+﻿#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	std::atomic<unsigned long long> g_count(0);
+	std::atomic<unsigned long long> g_bytes(0);
+	//plain integer, nothing to construct before the first new on a thread
+	thread_local unsigned long long t_count = 0;
+}
+
+void AllocationCounter::CountAllocation(size_t size)
+{
+	t_count++;
+	g_count.fetch_add(1, std::memory_order_relaxed);
+	g_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+unsigned long long AllocationCounter::GetCount()
+{
+	return g_count.load(std::memory_order_relaxed);
+}
+
+unsigned long long AllocationCounter::GetBytes()
+{
+	return g_bytes.load(std::memory_order_relaxed);
+}
+
+unsigned long long AllocationCounter::GetThreadCount()
+{
+	return t_count;
+}
+
+#if !defined(NDEBUG)
+NoAllocationScope::~NoAllocationScope()
+{
+	if (!m_enabled)
+		return;
+	unsigned long long allocations = AllocationCounter::GetThreadCount() - m_start;
+	if (allocations > 0)
+		fprintf(stderr, "%s allocated %llu times, it should run without allocating\n", m_name, allocations);
+	assert(allocations == 0);
+}
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+namespace DirectX11_Game
+{
+	//Counts every allocation made through the global operator new, from any thread,
+	//so take the difference of two reads around the code being measured. Nothing
+	//is counted unless the program compiles in AllocationHooks.cpp, which replaces
+	//the global new and delete. The benchmarks and headless tools count in every
+	//build, the game only in debug, and without it every count stays 0 and the
+	//scopes below pass.
+	class AllocationCounter
+	{
+	public:
+		//called by the replacement operator new for every allocation
+		static void CountAllocation(size_t size);
+
+		static unsigned long long GetCount();
+		static unsigned long long GetBytes();
+		//only the calling thread's, so other threads can't throw a measurement off
+		static unsigned long long GetThreadCount();
+	};
+
+	//Asserts in debug builds that the calling thread allocates nothing from the
+	//general heap while it is in scope, for the parts of a frame that should run
+	//from memory they already have. Pass false for a frame that is allowed to,
+	//the first one after a resize or a mode change.
+	class NoAllocationScope
+	{
+	public:
+#if defined(NDEBUG)
+		NoAllocationScope(const char*, bool = true) {}
+#else
+		NoAllocationScope(const char* name, bool enabled = true) :
+			m_name(name), m_enabled(enabled), m_start(enabled ? AllocationCounter::GetThreadCount() : 0) {}
+		~NoAllocationScope();
+	private:
+		const char* m_name;
+		bool m_enabled;
+		unsigned long long m_start;
+#endif
+	};
+}
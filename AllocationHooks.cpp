@@ -0,0 +1,152 @@
+﻿//The global new and delete, counting every allocation into AllocationCounter.
+//The benchmarks and headless tools compile this in with ALLOCATION_COUNTING
+//defined, so they count in release as well. The game compiles it in without,
+//so it only replaces anything in debug builds, where NoAllocationScope checks
+//the counts, and a release game keeps the standard allocator.
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#if !defined(NDEBUG) || defined(ALLOCATION_COUNTING)
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	void* Allocate(size_t size)
+	{
+		AllocationCounter::CountAllocation(size);
+		return malloc(size ? size : 1);
+	}
+
+	void* AllocateAligned(size_t size, size_t alignment)
+	{
+		AllocationCounter::CountAllocation(size);
+#if defined(_MSC_VER)
+		return _aligned_malloc(size ? size : 1, alignment);
+#else
+		//aligned_alloc wants the size to be a multiple of the alignment
+		size_t rounded = (size + alignment - 1) / alignment * alignment;
+		return aligned_alloc(alignment, rounded ? rounded : alignment);
+#endif
+	}
+
+	void FreeAligned(void* memory)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(memory);
+#else
+		free(memory);
+#endif
+	}
+}
+
+void* operator new(size_t size)
+{
+	void* memory = Allocate(size);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* memory = AllocateAligned(size, static_cast<size_t>(alignment));
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	FreeAligned(memory);
+}
+
+#endif
@@ -0,0 +1,338 @@
+﻿#include "AssetArchive.h"
+#include "Profiler.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	size_t MeshIndexOffset(size_t vertexBytes)
+	{
+		return (vertexBytes + 3) & ~static_cast<size_t>(3);
+	}
+}
+
+AssetArchive::AssetArchive() :
+	m_data(nullptr),
+	m_size(0),
+	m_entries(nullptr),
+	m_entryCount(0)
+#if defined(_WIN32)
+	, m_file(nullptr),
+	m_mapping(nullptr)
+#endif
+{
+}
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+bool AssetArchive::Open(const char* path)
+{
+	//archive paths are plain ascii, widening each byte is enough
+	std::wstring widePath(path, path + strlen(path));
+	return Open(widePath.c_str());
+}
+
+bool AssetArchive::Open(const wchar_t* path)
+{
+	PROFILE_ZONE("AssetArchive::Open");
+	Close();
+
+	//the FromApp calls are the ones a store app is allowed, and work on the desktop as well
+	HANDLE file = CreateFile2(path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		m_error = "could not open the archive";
+		return false;
+	}
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		m_error = "the archive is empty";
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingFromApp(file, nullptr, PAGE_READONLY, 0, nullptr);
+	void* view = m_mapping ? MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0) : nullptr;
+	if (!view)
+	{
+		m_error = "could not map the archive";
+		Close();
+		return false;
+	}
+
+	m_data = static_cast<const unsigned char*>(view);
+	m_size = static_cast<size_t>(size.QuadPart);
+	return Validate();
+}
+
+void AssetArchive::Close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+	m_entries = nullptr;
+	m_entryCount = 0;
+}
+#else
+bool AssetArchive::Open(const char* path)
+{
+	PROFILE_ZONE("AssetArchive::Open");
+	Close();
+
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		m_error = "could not open the archive";
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		m_error = "the archive is empty";
+		close(file);
+		return false;
+	}
+
+	//the mapping keeps the file alive on its own
+	void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+	{
+		m_error = "could not map the archive";
+		return false;
+	}
+
+	m_data = static_cast<const unsigned char*>(view);
+	m_size = static_cast<size_t>(status.st_size);
+	return Validate();
+}
+
+void AssetArchive::Close()
+{
+	if (m_data)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	m_data = nullptr;
+	m_size = 0;
+	m_entries = nullptr;
+	m_entryCount = 0;
+}
+#endif
+
+//Checks the header and the index against the file, so nothing handed out
+//afterwards can point outside the mapping.
+bool AssetArchive::Validate()
+{
+	Header header;
+	if (m_size < sizeof(Header))
+	{
+		m_error = "the archive is shorter than its header";
+		Close();
+		return false;
+	}
+	memcpy(&header, m_data, sizeof(Header));
+
+	if (header.magic != MAGIC || header.version != VERSION)
+	{
+		m_error = "not an asset archive, or a different version";
+		Close();
+		return false;
+	}
+
+	uint64_t indexSize = static_cast<uint64_t>(header.entryCount) * sizeof(Entry);
+	if (header.indexOffset % alignof(Entry) != 0 || header.indexOffset > m_size || indexSize > m_size - header.indexOffset)
+	{
+		m_error = "the index is outside the archive";
+		Close();
+		return false;
+	}
+
+	const unsigned char* index = m_data + header.indexOffset;
+	if (Checksum(index, static_cast<size_t>(indexSize)) != header.indexChecksum)
+	{
+		m_error = "the index checksum doesn't match";
+		Close();
+		return false;
+	}
+
+	m_entries = reinterpret_cast<const Entry*>(index);
+	m_entryCount = static_cast<int>(header.entryCount);
+	for (int i = 0; i < m_entryCount; i++)
+	{
+		const Entry& entry = m_entries[i];
+		bool named = memchr(entry.name, 0, NAME_LENGTH) != nullptr;
+		bool inside = entry.offset <= m_size && entry.size <= m_size - entry.offset;
+		bool sorted = i == 0 || strcmp(m_entries[i - 1].name, entry.name) < 0;
+
+		//the views read the rest of the layout from info, so it has to fit the payload as well
+		bool fits = true;
+		if (entry.type == Texture)
+		{
+			int mipCount = static_cast<int>(entry.info[3]);
+			fits = entry.info[0] > 0 && entry.info[1] > 0 && entry.info[0] <= 16384 && entry.info[1] <= 16384 &&
+				entry.info[2] == Rgba8 && mipCount >= 1 && mipCount <= MAX_MIPS &&
+				GetTextureSize(entry.info[0], entry.info[1], mipCount) <= entry.size;
+		}
+		else if (entry.type == Mesh)
+		{
+			uint64_t vertexBytes = static_cast<uint64_t>(entry.info[0]) * entry.info[1];
+			uint64_t indexBytes = static_cast<uint64_t>(entry.info[2]) * entry.info[3];
+			fits = (entry.info[3] == 2 || entry.info[3] == 4) && MeshIndexOffset(static_cast<size_t>(vertexBytes)) + indexBytes <= entry.size;
+		}
+
+		if (!named || !inside || !sorted || !fits)
+		{
+			m_error = "a damaged index entry";
+			Close();
+			return false;
+		}
+	}
+
+	m_error.clear();
+	return true;
+}
+
+const AssetArchive::Entry* AssetArchive::Find(const char* name) const
+{
+	//the index is sorted by name
+	int low = 0;
+	int high = m_entryCount - 1;
+	while (low <= high)
+	{
+		int middle = (low + high) / 2;
+		int order = strcmp(m_entries[middle].name, name);
+		if (order == 0)
+			return &m_entries[middle];
+		if (order < 0)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+	return nullptr;
+}
+
+bool AssetArchive::GetBlob(const char* name, BlobView& view) const
+{
+	const Entry* entry = Find(name);
+	if (!entry)
+		return false;
+	view.data = m_data + entry->offset;
+	view.size = static_cast<size_t>(entry->size);
+	return true;
+}
+
+bool AssetArchive::GetShader(const char* name, BlobView& view) const
+{
+	const Entry* entry = Find(name);
+	return entry && entry->type == Shader && GetBlob(name, view);
+}
+
+bool AssetArchive::GetTexture(const char* name, TextureView& view) const
+{
+	const Entry* entry = Find(name);
+	if (!entry || entry->type != Texture)
+		return false;
+
+	view.width = static_cast<int>(entry->info[0]);
+	view.height = static_cast<int>(entry->info[1]);
+	view.format = static_cast<TextureFormat>(entry->info[2]);
+	view.mipCount = static_cast<int>(entry->info[3]);
+
+	const unsigned char* pixels = m_data + entry->offset;
+	int width = view.width;
+	int height = view.height;
+	for (int mip = 0; mip < view.mipCount; mip++)
+	{
+		view.mips[mip].pixels = pixels;
+		view.mips[mip].width = width;
+		view.mips[mip].height = height;
+		view.mips[mip].rowPitch = static_cast<unsigned int>(width) * 4;
+		pixels += static_cast<size_t>(width) * height * 4;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return true;
+}
+
+bool AssetArchive::GetMesh(const char* name, MeshView& view) const
+{
+	const Entry* entry = Find(name);
+	if (!entry || entry->type != Mesh)
+		return false;
+
+	const unsigned char* payload = m_data + entry->offset;
+	view.vertexCount = static_cast<int>(entry->info[0]);
+	view.vertexStride = static_cast<int>(entry->info[1]);
+	view.indexCount = static_cast<int>(entry->info[2]);
+	view.indexSize = static_cast<int>(entry->info[3]);
+	view.vertices = payload;
+	view.indices = payload + MeshIndexOffset(static_cast<size_t>(view.vertexCount) * view.vertexStride);
+	return true;
+}
+
+bool AssetArchive::Verify()
+{
+	PROFILE_ZONE("AssetArchive::Verify");
+	for (int i = 0; i < m_entryCount; i++)
+	{
+		const Entry& entry = m_entries[i];
+		if (Checksum(m_data + entry.offset, static_cast<size_t>(entry.size)) != entry.checksum)
+		{
+			m_error = std::string("the checksum doesn't match for ") + entry.name;
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t AssetArchive::Checksum(const void* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+size_t AssetArchive::GetTextureSize(int width, int height, int mipCount)
+{
+	size_t size = 0;
+	for (int mip = 0; mip < mipCount; mip++)
+	{
+		size += static_cast<size_t>(width) * height * 4;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	return size;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace DirectX11_Game
+{
+	//Read side of the packed asset file AssetPacker writes. The whole file is
+	//mapped into memory once and every asset handed out is a view straight into
+	//the mapping, so loading a texture, shader or mesh reads no file and decodes
+	//nothing. Views stay valid until the archive is closed.
+	//
+	//Layout, all little endian:
+	//	Header		at 0
+	//	payloads	each starting on a PAYLOAD_ALIGNMENT boundary
+	//	Entry[]		at header.indexOffset, sorted by name
+	//
+	//Every payload and the index carry a 64 bit FNV-1a checksum. Open only checks
+	//the index, so a cold start touches just the pages it uses, Verify checks
+	//every payload as well.
+	class AssetArchive
+	{
+	public:
+		static const uint32_t MAGIC = 0x4b415053; // "SPAK"
+		static const uint32_t VERSION = 1;
+		static const int PAYLOAD_ALIGNMENT = 64;
+		static const int NAME_LENGTH = 48;
+		static const int MAX_MIPS = 16;
+
+		enum AssetType : uint32_t
+		{
+			Blob,
+			Texture,
+			Shader,
+			Mesh
+		};
+
+		//textures are always 8 bit rgba with straight alpha, the same as the
+		//renderer got from WIC before
+		enum TextureFormat : uint32_t
+		{
+			Rgba8
+		};
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t reserved;
+			uint64_t indexOffset;
+			uint64_t indexChecksum;
+		};
+
+		struct Entry
+		{
+			char name[NAME_LENGTH];
+			uint32_t type;
+			uint32_t reserved;
+			uint64_t offset;
+			uint64_t size;
+			uint64_t checksum;
+			//texture: width, height, format, mip count
+			//mesh: vertex count, vertex stride, index count, index size in bytes
+			uint32_t info[4];
+		};
+
+		struct BlobView
+		{
+			const unsigned char* data;
+			size_t size;
+		};
+
+		//each mip follows the one before it, rows tightly packed
+		struct TextureView
+		{
+			int width;
+			int height;
+			TextureFormat format;
+			int mipCount;
+			struct Mip
+			{
+				const unsigned char* pixels;
+				int width;
+				int height;
+				unsigned int rowPitch;
+			} mips[MAX_MIPS];
+		};
+
+		struct MeshView
+		{
+			const void* vertices;
+			int vertexCount;
+			int vertexStride;
+			//on the next 4 byte boundary after the vertices
+			const void* indices;
+			int indexCount;
+			int indexSize;
+		};
+
+		AssetArchive();
+		~AssetArchive();
+
+		AssetArchive(const AssetArchive&) = delete;
+		AssetArchive& operator=(const AssetArchive&) = delete;
+
+		//false with the reason in GetError when the file can't be mapped or its index is damaged
+		bool Open(const char* path);
+#if defined(_WIN32)
+		bool Open(const wchar_t* path);
+#endif
+		void Close();
+		bool IsOpen() const { return m_data != nullptr; }
+		const std::string& GetError() const { return m_error; }
+
+		int GetEntryCount() const { return m_entryCount; }
+		const Entry& GetEntry(int index) const { return m_entries[index]; }
+		//nullptr when there is no asset with that name
+		const Entry* Find(const char* name) const;
+
+		//false when the asset is missing or isn't that type
+		bool GetBlob(const char* name, BlobView& view) const;
+		bool GetShader(const char* name, BlobView& view) const;
+		bool GetTexture(const char* name, TextureView& view) const;
+		bool GetMesh(const char* name, MeshView& view) const;
+
+		//reads every payload and compares its checksum, the name of the first bad one goes in GetError
+		bool Verify();
+
+		//the checksum every part of the archive is stored with
+		static uint64_t Checksum(const void* data, size_t size);
+
+		//bytes in a texture with this many mips, each half the size of the last down to 1x1
+		static size_t GetTextureSize(int width, int height, int mipCount);
+
+	private:
+		bool Validate();
+
+		const unsigned char* m_data;
+		size_t m_size;
+		const Entry* m_entries;
+		int m_entryCount;
+		std::string m_error;
+
+#if defined(_WIN32)
+		void* m_file;
+		void* m_mapping;
+#endif
+	};
+}
@@ -0,0 +1,203 @@
+﻿//Packs a few assets, reads them back through AssetArchive and checks every
+//byte, then damages copies of the archive and checks each one is turned away.
+//Registered with ctest, exits non zero when any check fails.
+//
+//	AssetArchiveTest [scratch path]
+//
+//The archives are written to the scratch path, AssetArchiveTest.pak in the
+//working directory by default, and removed at the end.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "AssetPacker.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	int g_failures = 0;
+
+	void Check(bool passed, const char* test, const char* what)
+	{
+		if (passed)
+			return;
+		printf("  %s: %s\n", test, what);
+		g_failures++;
+	}
+
+	bool WriteBytes(const char* path, const std::vector<unsigned char>& bytes)
+	{
+		FILE* file = fopen(path, "wb");
+		if (!file)
+			return false;
+		bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+		fclose(file);
+		return written;
+	}
+
+	//bytes that aren't the same at any offset, so a payload read from the wrong place shows
+	std::vector<unsigned char> Pattern(size_t size, unsigned int seed)
+	{
+		std::vector<unsigned char> bytes(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			bytes[i] = static_cast<unsigned char>(seed >> 24);
+		}
+		return bytes;
+	}
+
+	//an entry in a copy of the archive, for damaging
+	AssetArchive::Entry* GetEntry(std::vector<unsigned char>& bytes, int index)
+	{
+		AssetArchive::Header* header = reinterpret_cast<AssetArchive::Header*>(bytes.data());
+		return reinterpret_cast<AssetArchive::Entry*>(bytes.data() + header->indexOffset) + index;
+	}
+
+	//after changing an entry, so only the check being tested can catch it
+	void FixIndexChecksum(std::vector<unsigned char>& bytes)
+	{
+		AssetArchive::Header* header = reinterpret_cast<AssetArchive::Header*>(bytes.data());
+		header->indexChecksum = AssetArchive::Checksum(bytes.data() + header->indexOffset, header->entryCount * sizeof(AssetArchive::Entry));
+	}
+
+	void CheckRejected(const char* path, const std::vector<unsigned char>& bytes, const char* test)
+	{
+		if (!WriteBytes(path, bytes))
+		{
+			Check(false, test, "could not write the damaged archive");
+			return;
+		}
+		AssetArchive archive;
+		Check(!archive.Open(path), test, "the damaged archive was opened");
+		Check(!archive.IsOpen() && !archive.GetError().empty(), test, "no error for the damaged archive");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : "AssetArchiveTest.pak";
+
+	//an empty blob, one smaller than the alignment and a few that cross it
+	const char* const names[] = { "empty", "small", "aligned", "large", "odd" };
+	const size_t sizes[] = { 0, 7, AssetArchive::PAYLOAD_ALIGNMENT, 70000, 1023 };
+	const int BLOB_COUNT = sizeof(sizes) / sizeof(sizes[0]);
+
+	AssetPacker packer;
+	std::vector<std::vector<unsigned char>> blobs;
+	for (int i = 0; i < BLOB_COUNT; i++)
+	{
+		blobs.push_back(Pattern(sizes[i], i + 1));
+		Check(packer.AddBlob(names[i], blobs[i].data(), blobs[i].size()), "pack", packer.GetError().c_str());
+	}
+	Check(!packer.AddBlob("small", blobs[1].data(), blobs[1].size()), "pack", "a name was taken twice");
+	Check(!packer.AddBlob(std::string(AssetArchive::NAME_LENGTH, 'n'), blobs[1].data(), blobs[1].size()), "pack", "a name too long was taken");
+
+	uint16_t indices[] = { 0, 1, 2, 2, 1, 3 };
+	float vertices[] = { 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0 };
+	Check(packer.AddMesh("quad", vertices, 4, sizeof(float) * 3, indices, 6, sizeof(uint16_t)), "pack", packer.GetError().c_str());
+	if (!packer.Write(path))
+	{
+		printf("could not write %s: %s\n", path, packer.GetError().c_str());
+		return 1;
+	}
+
+	{
+		AssetArchive archive;
+		Check(archive.Open(path), "read", archive.GetError().c_str());
+		Check(archive.GetEntryCount() == BLOB_COUNT + 1, "read", "wrong entry count");
+		for (int i = 0; i < BLOB_COUNT && archive.IsOpen(); i++)
+		{
+			AssetArchive::BlobView view;
+			bool found = archive.GetBlob(names[i], view);
+			Check(found && view.size == blobs[i].size(), names[i], "missing or the wrong size");
+			Check(!found || view.size == 0 || memcmp(view.data, blobs[i].data(), view.size) == 0, names[i], "the bytes differ");
+			Check(!found || reinterpret_cast<uintptr_t>(view.data) % AssetArchive::PAYLOAD_ALIGNMENT == 0, names[i], "not aligned");
+		}
+
+		AssetArchive::MeshView mesh;
+		bool found = archive.IsOpen() && archive.GetMesh("quad", mesh);
+		Check(found && mesh.vertexCount == 4 && mesh.indexCount == 6 && mesh.indexSize == 2, "quad", "wrong mesh layout");
+		Check(!found || (memcmp(mesh.vertices, vertices, sizeof(vertices)) == 0 && memcmp(mesh.indices, indices, sizeof(indices)) == 0),
+			"quad", "the mesh bytes differ");
+
+		AssetArchive::BlobView view;
+		Check(!archive.GetBlob("missing", view), "read", "found an asset that was never packed");
+		Check(!archive.GetShader("quad", view), "read", "a mesh was handed out as a shader");
+		Check(archive.Verify(), "verify", archive.GetError().c_str());
+	}
+
+	std::vector<unsigned char> original;
+	std::string error;
+	if (!AssetPacker::ReadFile(path, original, error))
+	{
+		printf("could not read %s back: %s\n", path, error.c_str());
+		return 1;
+	}
+
+	//cut anywhere, through the index or before it
+	std::vector<unsigned char> damaged(original.begin(), original.end() - 1);
+	CheckRejected(path, damaged, "truncated index");
+	damaged.assign(original.begin(), original.begin() + original.size() / 2);
+	CheckRejected(path, damaged, "truncated payloads");
+	damaged.assign(original.begin(), original.begin() + sizeof(AssetArchive::Header) - 1);
+	CheckRejected(path, damaged, "truncated header");
+
+	//the index where it says it is, with the checksum matching what was changed
+	damaged = original;
+	GetEntry(damaged, 0)->offset = original.size();
+	GetEntry(damaged, 0)->size = 1;
+	FixIndexChecksum(damaged);
+	CheckRejected(path, damaged, "offset past the end");
+
+	damaged = original;
+	GetEntry(damaged, 1)->size = original.size();
+	FixIndexChecksum(damaged);
+	CheckRejected(path, damaged, "size past the end");
+
+	damaged = original;
+	GetEntry(damaged, 2)->offset = ~0ull - 8;
+	GetEntry(damaged, 2)->size = 16;
+	FixIndexChecksum(damaged);
+	CheckRejected(path, damaged, "offset and size wrapping");
+
+	damaged = original;
+	reinterpret_cast<AssetArchive::Header*>(damaged.data())->indexOffset = original.size();
+	CheckRejected(path, damaged, "index past the end");
+
+	//a changed index without the checksum following it
+	damaged = original;
+	GetEntry(damaged, 0)->size += 1;
+	CheckRejected(path, damaged, "index checksum");
+
+	//a damaged payload still opens, only Verify reads far enough to see it
+	damaged = original;
+	AssetArchive::Entry* large = nullptr;
+	for (int i = 0; i < BLOB_COUNT + 1; i++)
+	{
+		if (strcmp(GetEntry(damaged, i)->name, "large") == 0)
+			large = GetEntry(damaged, i);
+	}
+	if (large)
+		damaged[large->offset + large->size / 2] ^= 0xff;
+	Check(large && WriteBytes(path, damaged), "payload checksum", "could not write the damaged archive");
+	{
+		AssetArchive archive;
+		Check(archive.Open(path), "payload checksum", "a damaged payload stopped the archive opening");
+		Check(!archive.Verify() && archive.GetError().find("large") != std::string::npos, "payload checksum", "Verify missed the damaged payload");
+	}
+
+	remove(path);
+	if (g_failures > 0)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("archive round trip and damage checks passed\n");
+	return 0;
+}
@@ -0,0 +1,156 @@
+﻿//Builds the asset archive the game maps at startup, and lists or checks one.
+//
+//	AssetPack pack out.pak [--texture name image] [--shader name file.cso] [--mesh name file.obj] [--blob name file] ...
+//	AssetPack list archive
+//	AssetPack verify archive
+//
+//Images are tga, pam or ppm, see AssetPacker::LoadImageFile. Meshes are
+//positions only, three floats a vertex, with 16 bit indices when they fit.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "AssetPacker.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const char* TypeName(uint32_t type)
+	{
+		switch (type)
+		{
+		case AssetArchive::Blob: return "blob";
+		case AssetArchive::Texture: return "texture";
+		case AssetArchive::Shader: return "shader";
+		case AssetArchive::Mesh: return "mesh";
+		default: return "unknown";
+		}
+	}
+
+	bool AddAsset(AssetPacker& packer, const char* kind, const char* name, const char* path, std::string& error)
+	{
+		if (strcmp(kind, "--texture") == 0)
+		{
+			int width, height;
+			std::vector<unsigned char> rgba;
+			if (!AssetPacker::LoadImageFile(path, width, height, rgba, error))
+				return false;
+			return packer.AddTexture(name, width, height, rgba.data());
+		}
+
+		if (strcmp(kind, "--mesh") == 0)
+		{
+			std::vector<float> positions;
+			std::vector<uint32_t> indices;
+			if (!AssetPacker::LoadObj(path, positions, indices, error))
+				return false;
+
+			int vertexCount = static_cast<int>(positions.size() / 3);
+			if (vertexCount <= 0xffff)
+			{
+				std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+				return packer.AddMesh(name, positions.data(), vertexCount, sizeof(float) * 3,
+					shortIndices.data(), static_cast<int>(shortIndices.size()), sizeof(uint16_t));
+			}
+			return packer.AddMesh(name, positions.data(), vertexCount, sizeof(float) * 3,
+				indices.data(), static_cast<int>(indices.size()), sizeof(uint32_t));
+		}
+
+		std::vector<unsigned char> data;
+		if (!AssetPacker::ReadFile(path, data, error))
+			return false;
+		if (strcmp(kind, "--shader") == 0)
+			return packer.AddShader(name, data.data(), data.size());
+		if (strcmp(kind, "--blob") == 0)
+			return packer.AddBlob(name, data.data(), data.size());
+
+		error = std::string("unknown option ") + kind;
+		return false;
+	}
+
+	int Pack(int argc, char** argv)
+	{
+		AssetPacker packer;
+		for (int i = 3; i < argc; i += 3)
+		{
+			if (i + 2 >= argc)
+			{
+				fprintf(stderr, "%s needs a name and a file\n", argv[i]);
+				return 1;
+			}
+
+			std::string error;
+			if (!AddAsset(packer, argv[i], argv[i + 1], argv[i + 2], error))
+			{
+				fprintf(stderr, "%s\n", error.empty() ? packer.GetError().c_str() : error.c_str());
+				return 1;
+			}
+		}
+
+		if (!packer.Write(argv[2]))
+		{
+			fprintf(stderr, "%s\n", packer.GetError().c_str());
+			return 1;
+		}
+		printf("packed %d assets into %s\n", packer.GetAssetCount(), argv[2]);
+		return 0;
+	}
+
+	int List(AssetArchive& archive)
+	{
+		for (int i = 0; i < archive.GetEntryCount(); i++)
+		{
+			const AssetArchive::Entry& entry = archive.GetEntry(i);
+			printf("%-8s %-32s %10llu bytes at %llu", TypeName(entry.type), entry.name,
+				static_cast<unsigned long long>(entry.size), static_cast<unsigned long long>(entry.offset));
+			if (entry.type == AssetArchive::Texture)
+				printf("  %ux%u, %u mips", entry.info[0], entry.info[1], entry.info[3]);
+			else if (entry.type == AssetArchive::Mesh)
+				printf("  %u vertices, %u indices", entry.info[0], entry.info[2]);
+			printf("\n");
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: AssetPack pack out.pak [--texture|--shader|--mesh|--blob name file] ...\n"
+			"       AssetPack list archive\n"
+			"       AssetPack verify archive\n");
+		return 1;
+	}
+
+	if (strcmp(argv[1], "pack") == 0)
+		return Pack(argc, argv);
+
+	AssetArchive archive;
+	if (!archive.Open(argv[2]))
+	{
+		fprintf(stderr, "%s: %s\n", argv[2], archive.GetError().c_str());
+		return 1;
+	}
+
+	if (strcmp(argv[1], "list") == 0)
+		return List(archive);
+
+	if (strcmp(argv[1], "verify") == 0)
+	{
+		if (!archive.Verify())
+		{
+			fprintf(stderr, "%s: %s\n", argv[2], archive.GetError().c_str());
+			return 1;
+		}
+		printf("%s: %d assets OK\n", argv[2], archive.GetEntryCount());
+		return 0;
+	}
+
+	fprintf(stderr, "unknown command %s\n", argv[1]);
+	return 1;
+}
@@ -0,0 +1,507 @@
+﻿#include "AssetPacker.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	//Halves an rgba image, a 2x2 block at a time. Colour is weighted by alpha so
+	//the colour under fully transparent pixels doesn't bleed into the edges.
+	void Downsample(const unsigned char* source, int width, int height, unsigned char* target)
+	{
+		int targetWidth = width > 1 ? width / 2 : 1;
+		int targetHeight = height > 1 ? height / 2 : 1;
+		for (int y = 0; y < targetHeight; y++)
+		{
+			for (int x = 0; x < targetWidth; x++)
+			{
+				int x0 = std::min(x * 2, width - 1);
+				int x1 = std::min(x * 2 + 1, width - 1);
+				int y0 = std::min(y * 2, height - 1);
+				int y1 = std::min(y * 2 + 1, height - 1);
+				const unsigned char* corners[4] = {
+					source + (static_cast<size_t>(y0) * width + x0) * 4,
+					source + (static_cast<size_t>(y0) * width + x1) * 4,
+					source + (static_cast<size_t>(y1) * width + x0) * 4,
+					source + (static_cast<size_t>(y1) * width + x1) * 4
+				};
+
+				unsigned int alpha = 0;
+				unsigned int weighted[3] = { 0, 0, 0 };
+				unsigned int plain[3] = { 0, 0, 0 };
+				for (const unsigned char* corner : corners)
+				{
+					alpha += corner[3];
+					for (int c = 0; c < 3; c++)
+					{
+						weighted[c] += corner[c] * corner[3];
+						plain[c] += corner[c];
+					}
+				}
+
+				unsigned char* pixel = target + (static_cast<size_t>(y) * targetWidth + x) * 4;
+				for (int c = 0; c < 3; c++)
+					pixel[c] = static_cast<unsigned char>(alpha > 0 ? (weighted[c] + alpha / 2) / alpha : (plain[c] + 2) / 4);
+				pixel[3] = static_cast<unsigned char>((alpha + 2) / 4);
+			}
+		}
+	}
+
+	bool LoadTga(const std::vector<unsigned char>& file, int& width, int& height, std::vector<unsigned char>& rgba, std::string& error)
+	{
+		if (file.size() < 18)
+		{
+			error = "tga header is cut short";
+			return false;
+		}
+
+		int idLength = file[0];
+		int colorMapType = file[1];
+		int imageType = file[2];
+		width = file[12] | (file[13] << 8);
+		height = file[14] | (file[15] << 8);
+		int bitsPerPixel = file[16];
+		bool topDown = (file[17] & 0x20) != 0;
+
+		//true colour only, 2 plain and 10 run length encoded
+		if (colorMapType != 0 || (imageType != 2 && imageType != 10) || (bitsPerPixel != 24 && bitsPerPixel != 32))
+		{
+			error = "only 24 and 32 bit true colour tga is supported";
+			return false;
+		}
+		if (width == 0 || height == 0)
+		{
+			error = "tga has no pixels";
+			return false;
+		}
+
+		int bytesPerPixel = bitsPerPixel / 8;
+		size_t pixelCount = static_cast<size_t>(width) * height;
+		size_t position = 18 + idLength;
+		rgba.resize(pixelCount * 4);
+
+		auto readPixel = [&](size_t at, unsigned char* pixel)
+		{
+			//stored as bgr(a)
+			pixel[0] = file[at + 2];
+			pixel[1] = file[at + 1];
+			pixel[2] = file[at];
+			pixel[3] = bytesPerPixel == 4 ? file[at + 3] : 255;
+		};
+
+		size_t written = 0;
+		while (written < pixelCount)
+		{
+			int run = 1;
+			bool repeat = false;
+			if (imageType == 10)
+			{
+				if (position >= file.size())
+					break;
+				unsigned char packet = file[position++];
+				run = (packet & 0x7f) + 1;
+				repeat = (packet & 0x80) != 0;
+			}
+			else
+			{
+				run = static_cast<int>(pixelCount);
+			}
+			run = static_cast<int>(std::min<size_t>(run, pixelCount - written));
+
+			size_t needed = static_cast<size_t>(repeat ? 1 : run) * bytesPerPixel;
+			if (position + needed > file.size())
+				break;
+
+			for (int i = 0; i < run; i++)
+			{
+				readPixel(position, &rgba[(written + i) * 4]);
+				if (!repeat)
+					position += bytesPerPixel;
+			}
+			if (repeat)
+				position += bytesPerPixel;
+			written += run;
+		}
+
+		if (written < pixelCount)
+		{
+			error = "tga pixel data is cut short";
+			return false;
+		}
+
+		//bottom up unless the descriptor says otherwise
+		if (!topDown)
+		{
+			size_t rowBytes = static_cast<size_t>(width) * 4;
+			for (int y = 0; y < height / 2; y++)
+				std::swap_ranges(rgba.begin() + y * rowBytes, rgba.begin() + (y + 1) * rowBytes, rgba.begin() + (height - 1 - y) * rowBytes);
+		}
+		return true;
+	}
+
+	//skips whitespace and # comments between netpbm header fields
+	bool ReadNetpbmToken(const std::vector<unsigned char>& file, size_t& position, std::string& token)
+	{
+		token.clear();
+		while (position < file.size())
+		{
+			char c = static_cast<char>(file[position]);
+			if (c == '#')
+			{
+				while (position < file.size() && file[position] != '\n')
+					position++;
+			}
+			else if (isspace(static_cast<unsigned char>(c)))
+			{
+				position++;
+			}
+			else
+			{
+				break;
+			}
+		}
+		while (position < file.size() && !isspace(file[position]))
+			token += static_cast<char>(file[position++]);
+		return !token.empty();
+	}
+
+	bool LoadNetpbm(const std::vector<unsigned char>& file, int& width, int& height, std::vector<unsigned char>& rgba, std::string& error)
+	{
+		size_t position = 2;
+		int depth = 3;
+		int maxValue = 0;
+		width = height = 0;
+		std::string token;
+
+		if (file[1] == '6')
+		{
+			std::string fields[3];
+			for (std::string& field : fields)
+			{
+				if (!ReadNetpbmToken(file, position, field))
+				{
+					error = "ppm header is cut short";
+					return false;
+				}
+			}
+			width = atoi(fields[0].c_str());
+			height = atoi(fields[1].c_str());
+			maxValue = atoi(fields[2].c_str());
+		}
+		else
+		{
+			//pam, named fields up to ENDHDR
+			while (ReadNetpbmToken(file, position, token) && token != "ENDHDR")
+			{
+				std::string value;
+				ReadNetpbmToken(file, position, value);
+				if (token == "WIDTH")
+					width = atoi(value.c_str());
+				else if (token == "HEIGHT")
+					height = atoi(value.c_str());
+				else if (token == "DEPTH")
+					depth = atoi(value.c_str());
+				else if (token == "MAXVAL")
+					maxValue = atoi(value.c_str());
+			}
+			if (token != "ENDHDR")
+			{
+				error = "pam header has no ENDHDR";
+				return false;
+			}
+		}
+		//exactly one whitespace byte between the header and the pixels
+		position++;
+
+		if (width <= 0 || height <= 0 || depth < 1 || depth > 4 || maxValue != 255)
+		{
+			error = "only 8 bit netpbm images with 1 to 4 channels are supported";
+			return false;
+		}
+
+		size_t pixelCount = static_cast<size_t>(width) * height;
+		if (position + pixelCount * depth > file.size())
+		{
+			error = "netpbm pixel data is cut short";
+			return false;
+		}
+
+		rgba.resize(pixelCount * 4);
+		for (size_t i = 0; i < pixelCount; i++)
+		{
+			const unsigned char* source = &file[position + i * depth];
+			unsigned char* pixel = &rgba[i * 4];
+			//grayscale, grayscale with alpha, rgb or rgb with alpha
+			bool gray = depth < 3;
+			pixel[0] = source[0];
+			pixel[1] = gray ? source[0] : source[1];
+			pixel[2] = gray ? source[0] : source[2];
+			pixel[3] = depth == 2 ? source[1] : depth == 4 ? source[3] : 255;
+		}
+		return true;
+	}
+}
+
+AssetPacker::Asset* AssetPacker::Begin(const std::string& name, AssetArchive::AssetType type)
+{
+	if (name.empty() || name.size() >= AssetArchive::NAME_LENGTH)
+	{
+		m_error = "asset names must be 1 to " + std::to_string(AssetArchive::NAME_LENGTH - 1) + " characters: " + name;
+		return nullptr;
+	}
+	for (const Asset& asset : m_assets)
+	{
+		if (name == asset.entry.name)
+		{
+			m_error = "there is already an asset called " + name;
+			return nullptr;
+		}
+	}
+
+	m_assets.emplace_back();
+	Asset& asset = m_assets.back();
+	memset(&asset.entry, 0, sizeof(asset.entry));
+	memcpy(asset.entry.name, name.c_str(), name.size());
+	asset.entry.type = type;
+	return &asset;
+}
+
+bool AssetPacker::AddBlob(const std::string& name, const void* data, size_t size)
+{
+	Asset* asset = Begin(name, AssetArchive::Blob);
+	if (!asset)
+		return false;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	asset->payload.assign(bytes, bytes + size);
+	return true;
+}
+
+bool AssetPacker::AddShader(const std::string& name, const void* bytecode, size_t size)
+{
+	if (!AddBlob(name, bytecode, size))
+		return false;
+	m_assets.back().entry.type = AssetArchive::Shader;
+	return true;
+}
+
+bool AssetPacker::AddTexture(const std::string& name, int width, int height, const unsigned char* rgba, bool buildMips)
+{
+	if (width <= 0 || height <= 0 || width > 16384 || height > 16384)
+	{
+		m_error = "texture sizes must be 1 to 16384: " + name;
+		return false;
+	}
+
+	int mipCount = 1;
+	if (buildMips)
+	{
+		for (int side = std::max(width, height); side > 1; side /= 2)
+			mipCount++;
+	}
+
+	Asset* asset = Begin(name, AssetArchive::Texture);
+	if (!asset)
+		return false;
+
+	asset->payload.resize(AssetArchive::GetTextureSize(width, height, mipCount));
+	memcpy(asset->payload.data(), rgba, static_cast<size_t>(width) * height * 4);
+
+	//each mip straight after the one it was made from
+	unsigned char* source = asset->payload.data();
+	int mipWidth = width;
+	int mipHeight = height;
+	for (int mip = 1; mip < mipCount; mip++)
+	{
+		unsigned char* target = source + static_cast<size_t>(mipWidth) * mipHeight * 4;
+		Downsample(source, mipWidth, mipHeight, target);
+		source = target;
+		mipWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+		mipHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+	}
+
+	asset->entry.info[0] = width;
+	asset->entry.info[1] = height;
+	asset->entry.info[2] = AssetArchive::Rgba8;
+	asset->entry.info[3] = mipCount;
+	return true;
+}
+
+bool AssetPacker::AddMesh(const std::string& name, const void* vertices, int vertexCount, int vertexStride,
+	const void* indices, int indexCount, int indexSize)
+{
+	if (vertexCount < 0 || vertexStride <= 0 || indexCount < 0 || (indexSize != 2 && indexSize != 4))
+	{
+		m_error = "meshes need a vertex stride and 2 or 4 byte indices: " + name;
+		return false;
+	}
+
+	Asset* asset = Begin(name, AssetArchive::Mesh);
+	if (!asset)
+		return false;
+
+	//the same layout AssetArchive::GetMesh reads back
+	size_t vertexBytes = static_cast<size_t>(vertexCount) * vertexStride;
+	size_t indexOffset = AlignUp(vertexBytes, 4);
+	asset->payload.assign(indexOffset + static_cast<size_t>(indexCount) * indexSize, 0);
+	memcpy(asset->payload.data(), vertices, vertexBytes);
+	memcpy(asset->payload.data() + indexOffset, indices, static_cast<size_t>(indexCount) * indexSize);
+
+	asset->entry.info[0] = vertexCount;
+	asset->entry.info[1] = vertexStride;
+	asset->entry.info[2] = indexCount;
+	asset->entry.info[3] = indexSize;
+	return true;
+}
+
+bool AssetPacker::Write(const char* path)
+{
+	//sorted so the reader can search the index
+	std::vector<Asset*> sorted;
+	for (Asset& asset : m_assets)
+		sorted.push_back(&asset);
+	std::sort(sorted.begin(), sorted.end(), [](const Asset* a, const Asset* b) { return strcmp(a->entry.name, b->entry.name) < 0; });
+
+	//payloads first, each on its own alignment boundary, then the index
+	std::vector<unsigned char> file(sizeof(AssetArchive::Header), 0);
+	std::vector<AssetArchive::Entry> index;
+	for (Asset* asset : sorted)
+	{
+		file.resize(AlignUp(file.size(), AssetArchive::PAYLOAD_ALIGNMENT), 0);
+		AssetArchive::Entry entry = asset->entry;
+		entry.offset = file.size();
+		entry.size = asset->payload.size();
+		entry.checksum = AssetArchive::Checksum(asset->payload.data(), asset->payload.size());
+		file.insert(file.end(), asset->payload.begin(), asset->payload.end());
+		index.push_back(entry);
+	}
+	file.resize(AlignUp(file.size(), AssetArchive::PAYLOAD_ALIGNMENT), 0);
+
+	AssetArchive::Header header = {};
+	header.magic = AssetArchive::MAGIC;
+	header.version = AssetArchive::VERSION;
+	header.entryCount = static_cast<uint32_t>(index.size());
+	header.indexOffset = file.size();
+	header.indexChecksum = AssetArchive::Checksum(index.data(), index.size() * sizeof(AssetArchive::Entry));
+	memcpy(file.data(), &header, sizeof(header));
+
+	const unsigned char* indexBytes = reinterpret_cast<const unsigned char*>(index.data());
+	file.insert(file.end(), indexBytes, indexBytes + index.size() * sizeof(AssetArchive::Entry));
+
+	FILE* output = fopen(path, "wb");
+	if (!output)
+	{
+		m_error = std::string("could not write ") + path;
+		return false;
+	}
+	bool written = fwrite(file.data(), 1, file.size(), output) == file.size();
+	written = fclose(output) == 0 && written;
+	if (!written)
+		m_error = std::string("could not write all of ") + path;
+	return written;
+}
+
+bool AssetPacker::ReadFile(const char* path, std::vector<unsigned char>& data, std::string& error)
+{
+	FILE* input = fopen(path, "rb");
+	if (!input)
+	{
+		error = std::string("could not open ") + path;
+		return false;
+	}
+
+	data.clear();
+	unsigned char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), input)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	fclose(input);
+	return true;
+}
+
+bool AssetPacker::LoadImageFile(const char* path, int& width, int& height, std::vector<unsigned char>& rgba, std::string& error)
+{
+	std::vector<unsigned char> file;
+	if (!ReadFile(path, file, error))
+		return false;
+
+	//netpbm starts with its magic number, tga has none so it is told apart by its extension
+	if (file.size() >= 2 && file[0] == 'P' && (file[1] == '6' || file[1] == '7'))
+		return LoadNetpbm(file, width, height, rgba, error);
+
+	const char* extension = strrchr(path, '.');
+	if (extension && (strcmp(extension, ".tga") == 0 || strcmp(extension, ".TGA") == 0))
+		return LoadTga(file, width, height, rgba, error);
+
+	error = std::string("not a tga, pam or ppm image: ") + path;
+	return false;
+}
+
+bool AssetPacker::LoadObj(const char* path, std::vector<float>& positions, std::vector<uint32_t>& indices, std::string& error)
+{
+	std::vector<unsigned char> file;
+	if (!ReadFile(path, file, error))
+		return false;
+
+	positions.clear();
+	indices.clear();
+	std::istringstream lines(std::string(file.begin(), file.end()));
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+
+		if (kind == "v")
+		{
+			float x = 0, y = 0, z = 0;
+			fields >> x >> y >> z;
+			positions.push_back(x);
+			positions.push_back(y);
+			positions.push_back(z);
+		}
+		else if (kind == "f")
+		{
+			//v, v/vt, v//vn or v/vt/vn, only the position is kept, negative counts back from the last
+			std::vector<uint32_t> corners;
+			std::string corner;
+			int vertexCount = static_cast<int>(positions.size() / 3);
+			while (fields >> corner)
+			{
+				int index = atoi(corner.c_str());
+				index = index < 0 ? vertexCount + index : index - 1;
+				if (index < 0 || index >= vertexCount)
+				{
+					error = std::string(path) + ":" + std::to_string(lineNumber) + " face uses a vertex that doesn't exist";
+					return false;
+				}
+				corners.push_back(static_cast<uint32_t>(index));
+			}
+			for (size_t i = 2; i < corners.size(); i++)
+			{
+				indices.push_back(corners[0]);
+				indices.push_back(corners[i - 1]);
+				indices.push_back(corners[i]);
+			}
+		}
+	}
+
+	if (indices.empty())
+	{
+		error = std::string(path) + " has no faces";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+
+namespace DirectX11_Game
+{
+	//Offline side of AssetArchive. Everything the game would otherwise decode
+	//or build at load time is done here once: images are decoded to rgba and
+	//mipped, shader bytecode and mesh buffers are copied in as they will be
+	//handed to the device.
+	//
+	//	AssetPacker packer;
+	//	packer.AddTexture("cat", width, height, pixels.data());
+	//	packer.AddShader("GridVertexShader", bytecode.data(), bytecode.size());
+	//	packer.Write("assets.pak");
+	class AssetPacker
+	{
+	public:
+		//false when the name is too long, empty or already taken, see GetError
+		bool AddBlob(const std::string& name, const void* data, size_t size);
+		bool AddShader(const std::string& name, const void* bytecode, size_t size);
+		//straight alpha rgba, the full mip chain is built with a box filter unless buildMips is off
+		bool AddTexture(const std::string& name, int width, int height, const unsigned char* rgba, bool buildMips = true);
+		// indexSize	- 2 or 4 bytes
+		bool AddMesh(const std::string& name, const void* vertices, int vertexCount, int vertexStride,
+			const void* indices, int indexCount, int indexSize);
+
+		bool Write(const char* path);
+
+		int GetAssetCount() const { return static_cast<int>(m_assets.size()); }
+		const std::string& GetError() const { return m_error; }
+
+		//Uncompressed or run length encoded 24 and 32 bit tga, or netpbm pam and
+		//ppm, decoded to straight alpha rgba with the first row at the top.
+		static bool LoadImageFile(const char* path, int& width, int& height, std::vector<unsigned char>& rgba, std::string& error);
+
+		//Positions and faces from a wavefront obj, faces with more than three
+		//corners are split into a fan. The vertices are three floats each.
+		static bool LoadObj(const char* path, std::vector<float>& positions, std::vector<uint32_t>& indices, std::string& error);
+
+		static bool ReadFile(const char* path, std::vector<unsigned char>& data, std::string& error);
+
+	private:
+		struct Asset
+		{
+			AssetArchive::Entry entry;
+			std::vector<unsigned char> payload;
+		};
+
+		Asset* Begin(const std::string& name, AssetArchive::AssetType type);
+
+		std::vector<Asset> m_assets;
+		std::string m_error;
+	};
+}
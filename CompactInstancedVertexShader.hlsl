@@ -0,0 +1,48 @@
+// Same as InstancedVertexShader, except each instance is only position, yaw and
+// scale and the model matrix is built here instead of on the cpu.
+cbuffer ViewProjectionConstantBuffer : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 color : COLOR0;
+	// CompactInstance, xyz is the position and w the yaw
+	float4 placement : INSTANCEPLACEMENT;
+	float scale : INSTANCESCALE;
+};
+
+struct PixelShaderInput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	PixelShaderInput output;
+	float4 pos = float4(input.pos, 1.0f);
+
+	// the transpose of Translation * RotationY * Scaling, the same rows TransformBatch writes
+	float s, c;
+	sincos(input.placement.w, s, c);
+	float3 t = input.placement.xyz;
+	float k = input.scale;
+	float4x4 instanceModel = float4x4(
+		c * k, 0.0f, s * k, (t.x * c + t.z * s) * k,
+		0.0f, k, 0.0f, t.y * k,
+		-s * k, 0.0f, c * k, (t.z * c - t.x * s) * k,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	pos = mul(instanceModel, pos);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+
+	output.color = input.color;
+
+	return output;
+}
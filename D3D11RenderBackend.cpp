@@ -0,0 +1,98 @@
+﻿#include "pch.h"
+#include "D3D11RenderBackend.h"
+
+#include "..\Common\DirectXHelper.h"
+
+using namespace DirectX11_Game;
+
+D3D11RenderBackend::D3D11RenderBackend(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources)
+{
+}
+
+void D3D11RenderBackend::UpdateBuffer(void* buffer, const void* data, unsigned int size)
+{
+	//default usage buffers are replaced whole, size is implied by the buffer
+	(void)size;
+	m_deviceResources->GetD3DDeviceContext()->UpdateSubresource1(
+		static_cast<ID3D11Buffer*>(buffer), 0, NULL, data, 0, 0, 0);
+}
+
+void D3D11RenderBackend::UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	//only buffers can be updated in part, the box is in bytes along x
+	D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+	m_deviceResources->GetD3DDeviceContext()->UpdateSubresource1(
+		static_cast<ID3D11Buffer*>(buffer), 0, &box, data, 0, 0, 0);
+}
+
+void D3D11RenderBackend::WriteDynamicBuffer(void* buffer, const void* data, unsigned int size)
+{
+	auto context = m_deviceResources->GetD3DDeviceContext();
+	ID3D11Buffer* d3dBuffer = static_cast<ID3D11Buffer*>(buffer);
+
+	//discard hands back fresh memory so the gpu can keep reading last frame's copy
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(context->Map(d3dBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, data, size);
+	context->Unmap(d3dBuffer, 0);
+}
+
+void D3D11RenderBackend::SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset)
+{
+	ID3D11Buffer* d3dBuffer = static_cast<ID3D11Buffer*>(buffer);
+	UINT d3dStride = stride;
+	UINT d3dOffset = offset;
+	m_deviceResources->GetD3DDeviceContext()->IASetVertexBuffers(slot, 1, &d3dBuffer, &d3dStride, &d3dOffset);
+}
+
+void D3D11RenderBackend::SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset)
+{
+	m_deviceResources->GetD3DDeviceContext()->IASetIndexBuffer(
+		static_cast<ID3D11Buffer*>(buffer),
+		format == IndexFormat::Index16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT,
+		offset);
+}
+
+void D3D11RenderBackend::SetPrimitiveTopology(PrimitiveTopology topology)
+{
+	switch (topology)
+	{
+	case PrimitiveTopology::TriangleList:
+	default:
+		m_deviceResources->GetD3DDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		break;
+	}
+}
+
+void D3D11RenderBackend::SetInputLayout(void* inputLayout)
+{
+	m_deviceResources->GetD3DDeviceContext()->IASetInputLayout(static_cast<ID3D11InputLayout*>(inputLayout));
+}
+
+void D3D11RenderBackend::SetVertexShader(void* shader)
+{
+	m_deviceResources->GetD3DDeviceContext()->VSSetShader(static_cast<ID3D11VertexShader*>(shader), nullptr, 0);
+}
+
+void D3D11RenderBackend::SetVertexConstantBuffer(unsigned int slot, void* buffer)
+{
+	ID3D11Buffer* d3dBuffer = static_cast<ID3D11Buffer*>(buffer);
+	m_deviceResources->GetD3DDeviceContext()->VSSetConstantBuffers1(slot, 1, &d3dBuffer, nullptr, nullptr);
+}
+
+void D3D11RenderBackend::SetPixelShader(void* shader)
+{
+	m_deviceResources->GetD3DDeviceContext()->PSSetShader(static_cast<ID3D11PixelShader*>(shader), nullptr, 0);
+}
+
+void D3D11RenderBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	m_deviceResources->GetD3DDeviceContext()->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+	unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	m_deviceResources->GetD3DDeviceContext()->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
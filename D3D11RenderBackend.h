@@ -0,0 +1,34 @@
+#pragma once
+
+#include "RenderBackend.h"
+#include "..\Common\DeviceResources.h"
+
+namespace DirectX11_Game
+{
+	//Forwards the RenderBackend calls to the D3D11 immediate context.
+	class D3D11RenderBackend : public RenderBackend
+	{
+	public:
+		D3D11RenderBackend(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+		void UpdateBuffer(void* buffer, const void* data, unsigned int size) override;
+		void UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size) override;
+		void WriteDynamicBuffer(void* buffer, const void* data, unsigned int size) override;
+
+		void SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset) override;
+		void SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset) override;
+		void SetPrimitiveTopology(PrimitiveTopology topology) override;
+		void SetInputLayout(void* inputLayout) override;
+		void SetVertexShader(void* shader) override;
+		void SetVertexConstantBuffer(unsigned int slot, void* buffer) override;
+		void SetPixelShader(void* shader) override;
+
+		void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+		void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+			unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+
+	private:
+		// Cached pointer to device resources, the context is looked up per call as it changes when the device is lost.
+		std::shared_ptr<DX::DeviceResources> m_deviceResources;
+	};
+}
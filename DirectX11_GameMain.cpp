@@ -1,5 +1,6 @@
 ﻿#include "pch.h"
 #include "DirectX11_GameMain.h"
+#include "Profiler.h"
 #include "Common\DirectXHelper.h"
 
 using namespace Microsoft::WRL;
@@ -19,27 +20,54 @@ DirectX11_GameMain::DirectX11_GameMain(const std::shared_ptr<DX::DeviceResources
 	m_yOff(1),
 	m_displayVal(),
 	m_drawBackdrop(false),
-	m_userPresses(0)
+	m_userPresses(0),
+	m_inputPending(false),
+	m_inputMark(0)
 {
 	// Register to be notified if the Device is lost or recreated
 	m_deviceResources->RegisterDeviceNotify(this);
-	
+
+	//one mapping for every texture and shader, the loose files are only used when it isn't packaged
+	std::wstring assetPath = std::wstring(Windows::ApplicationModel::Package::Current->InstalledLocation->Path->Data()) + L"\\assets.pak";
+	m_assets = std::make_shared<AssetArchive>();
+	if (!m_assets->Open(assetPath.c_str()))
+		m_assets.reset();
+
 	LoadCatResources();
 
 	// TODO: Replace this with your app's content initialization.
 	//m_sceneRenderer = std::unique_ptr<Sample3DSceneRenderer>(new Sample3DSceneRenderer(m_deviceResources, m_xOff, m_yOff));
-	m_gameRenderer = std::unique_ptr<GameRenderer>(new GameRenderer(m_deviceResources, m_xOff, m_yOff));
+	m_gameRenderer = std::unique_ptr<GameRenderer>(new GameRenderer(m_deviceResources, m_xOff, m_yOff, m_assets));
     m_fpsTextRenderer = std::unique_ptr<SampleFpsTextRenderer>(new SampleFpsTextRenderer(m_deviceResources));
 
-	//assign the public variable these values
-	m_fpsTextRenderer->SetPublicVariable(m_displayVal[0]);
-	m_fpsTextRenderer->SetPublicVariable(m_displayVal[1]);
-	m_fpsTextRenderer->SetPublicVariable(m_displayVal[2]);
-	m_fpsTextRenderer->SetPublicVariable(m_userInput);
-	m_fpsTextRenderer->SetPublicVariable(m_displayVal[3]);
-	m_fpsTextRenderer->SetPublicVariable(m_displayVal[4]);
-	m_fpsTextRenderer->SetPublicVariable(m_gameRenderer->m_xOffset);
-	m_fpsTextRenderer->SetPublicVariable(m_gameRenderer->m_publicZ);
+	//the overlay reads everything from the registry, looked up once here so
+	//publishing a value each frame is just an atomic store
+	m_displayGauges[0] = m_metrics.GetGauge("display 0");
+	m_displayGauges[1] = m_metrics.GetGauge("display 1");
+	m_displayGauges[2] = m_metrics.GetGauge("display 2");
+	m_userInputGauge = m_metrics.GetGauge("user input");
+	m_displayGauges[3] = m_metrics.GetGauge("display 3");
+	m_displayGauges[4] = m_metrics.GetGauge("display 4");
+	m_xOffsetGauge = m_metrics.GetGauge("x offset");
+	m_publicZGauge = m_metrics.GetGauge("public z");
+	m_visibleCellsGauge = m_metrics.GetGauge("visible cells");
+	m_culledCellsGauge = m_metrics.GetGauge("culled cells");
+	m_dirtyCellsGauge = m_metrics.GetGauge("dirty cells");
+	m_gridMemoryGauge = m_metrics.GetGauge("grid memory KB");
+	m_liveDrawCallsGauge = m_metrics.GetGauge("live draw calls");
+	m_bakedDrawCallsGauge = m_metrics.GetGauge("baked draw calls");
+	m_bakeTimeGauge = m_metrics.GetGauge("bake ms");
+	m_droppedInputsGauge = m_metrics.GetGauge("inputs dropped");
+	m_inputEventsCounter = m_metrics.GetCounter("input events");
+	m_appliedInputsCounter = m_metrics.GetCounter("inputs applied");
+	m_inputLatencyTimer = m_metrics.GetTimer("input latency ms");
+	m_pickedCellGauge = m_metrics.GetGauge("picked cell");
+	m_pickTimeGauge = m_metrics.GetGauge("pick ms");
+	m_frameCounter = m_metrics.GetCounter("frames");
+	m_frameTimer = m_metrics.GetTimer("frame ms");
+	m_updateTimer = m_metrics.GetTimer("update ms");
+	m_renderTimer = m_metrics.GetTimer("render ms");
+	m_fpsTextRenderer->SetMetrics(&m_metrics);
 
 	// TODO: Change the timer settings if you want something other than the default variable timestep mode.
 	// e.g. for 60 FPS fixed timestep update logic, call:
@@ -75,6 +103,9 @@ void DirectX11_GameMain::Update()
 	{
 		// TODO: Replace this with your app's content update functions.
 		//m_sceneRenderer->Update(m_timer);
+		MetricsRegistry::ScopedTimer updateTime(m_updateTimer);
+		PROFILE_ZONE("GameMain::Update");
+		ApplyInputs();
 		m_gameRenderer->Update(GetRadians());
 		
 		m_fpsTextRenderer->Update(m_timer,
@@ -93,6 +124,16 @@ bool DirectX11_GameMain::Render()
 		return false;
 	}
 
+	MetricsRegistry::ScopedTimer renderTime(m_renderTimer);
+	PROFILE_ZONE("GameMain::Render");
+
+	//frame time is from one render to the next, whatever ran in between
+	auto now = std::chrono::steady_clock::now();
+	if (m_frameCounter->Get() > 0)
+		m_frameTimer->Record(std::chrono::duration<double, std::milli>(now - m_lastFrameTime).count());
+	m_lastFrameTime = now;
+	m_frameCounter->Add();
+
 	auto context = m_deviceResources->GetD3DDeviceContext();
 
 	/*ID3D11RasterizerState** state = m_deviceResources->GetD3DDevice()->CreateRasterizerState();
@@ -116,7 +157,12 @@ bool DirectX11_GameMain::Render()
 	// TODO: Replace this with your app's content rendering functions.
 	//m_sceneRenderer->Render();
 	m_gameRenderer->Render();
-	m_fpsTextRenderer->Render();
+	MeasureInputLatency();
+	PublishMetrics();
+	{
+		PROFILE_ZONE("SampleFpsTextRenderer::Render");
+		m_fpsTextRenderer->Render();
+	}
 
 	return true;
 }
@@ -145,40 +191,98 @@ void DirectX11_GameMain::OnDeviceRestored()
 	CreateWindowSizeDependentResources();
 }
 
+//Called on the input thread, only queues the event. Moves and zooms are typed
+//here so the ones that arrive in the same tick can be added together.
 void DirectX11_GameMain::SetPlayerInputs(int input)
 {
-	m_userInput = input;
-
 	//m_fpsTextRenderer->SetPublicVariable(input);
 	switch (input)
 	{
 	//0-3 wasd
 	case 0: //w
-		m_gameRenderer->ModifyCameraPosition(1, 1);
+		m_inputQueue.PushMove(input, 1, 1);
 		break;
 	case 1: //a 
-		m_gameRenderer->ModifyCameraPosition(-1, 0);
+		m_inputQueue.PushMove(input, 0, -1);
 		break;
 	case 2: //s
-		m_gameRenderer->ModifyCameraPosition(-1, 1);
+		m_inputQueue.PushMove(input, 1, -1);
 		break;
 	case 3: //d
-		m_gameRenderer->ModifyCameraPosition(1, 0);
+		m_inputQueue.PushMove(input, 0, 1);
 		break;
 	//pointer scrolling 4, 5, 6, 7
 	case 4:
-		m_gameRenderer->UpdatePerspective(0.02f);
+		m_inputQueue.PushZoom(input, 0.02f);
 		break;
 	case 5: 
-		m_gameRenderer->UpdatePerspective(-0.02f);
+		m_inputQueue.PushZoom(input, -0.02f);
 		break;
 	//with control down 6 or 7
 	case 6:
-		m_gameRenderer->UpdatePerspective(0.2f);
+		m_inputQueue.PushZoom(input, 0.2f);
 		break;
 	case 7:
-		m_gameRenderer->UpdatePerspective(-0.2f);
+		m_inputQueue.PushZoom(input, -0.2f);
+		break;
+	default:
+		m_inputQueue.PushKey(input);
 		break;
+	}
+}
+
+//Everything the input thread queued since the last tick, merged, applied on the
+//thread that updates and renders so nothing in the renderer is touched from two.
+void DirectX11_GameMain::ApplyInputs()
+{
+	int drained = m_inputQueue.Drain(m_inputEvents);
+	if (drained == 0)
+		return;
+	m_inputEventsCounter->Add(drained);
+	m_appliedInputsCounter->Add(m_inputEvents.size());
+
+	for (const InputEvent& event : m_inputEvents)
+	{
+		m_userInput = event.code;
+		switch (event.type)
+		{
+		case InputEvent::Move:
+			m_gameRenderer->ModifyCameraPosition(event.amount, event.direction);
+			break;
+		case InputEvent::Zoom:
+			m_gameRenderer->UpdatePerspective(event.amount);
+			break;
+		case InputEvent::Pointer:
+			ApplyPointer(event.x, event.y);
+			break;
+		case InputEvent::Key:
+			ApplyKey(event.code);
+			break;
+		}
+	}
+
+	//one measurement at a time, from the oldest event here to the first frame drawn with all of it
+	if (!m_inputPending)
+	{
+		m_inputPending = true;
+		m_inputQueuedTime = m_inputEvents.front().queued;
+		m_inputMark = m_gameRenderer->GetQueuedInputCount();
+	}
+}
+
+//after the renderer has submitted a frame, not when it reaches the screen
+void DirectX11_GameMain::MeasureInputLatency()
+{
+	if (!m_inputPending || m_gameRenderer->m_drawnInputCount < m_inputMark)
+		return;
+	m_inputLatencyTimer->Record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_inputQueuedTime).count());
+	m_inputPending = false;
+}
+
+void DirectX11_GameMain::ApplyKey(int input)
+{
+	switch (input)
+	{
 	//change speed of rotation
 	case 8: //q
 		m_gameRenderer->ModifyDegreesPerSecond(-1, input);
@@ -213,7 +317,19 @@ void DirectX11_GameMain::SetPlayerInputs(int input)
 		break;
 	case 18: //t
 		m_userPresses += 1;
+		break;
 	case 19: //y
+		m_gameRenderer->ToggleWavePaused();
+		break;
+	case 20: //p
+		DumpProfile();
+		break;
+	//halve or double the cells on each side of the grid
+	case 21: //[
+		m_gameRenderer->SetGridSize(m_gameRenderer->GetGridColumns() / 2, m_gameRenderer->GetGridRows() / 2);
+		break;
+	case 22: //]
+		m_gameRenderer->SetGridSize(m_gameRenderer->GetGridColumns() * 2, m_gameRenderer->GetGridRows() * 2);
 		break;
 	}
 
@@ -221,30 +337,73 @@ void DirectX11_GameMain::SetPlayerInputs(int input)
 	//play audio track based off the input provided
 }
 
+//copies the values the overlay shows into their gauges
+void DirectX11_GameMain::PublishMetrics()
+{
+	//where the last pick landed on the grid, in the two slots the old guess went to
+	m_displayVal[3] = m_gameRenderer->m_pickedPoint.x;
+	m_displayVal[4] = m_gameRenderer->m_pickedPoint.z;
+	for (int i = 0; i < 5; i++)
+		m_displayGauges[i]->Set(m_displayVal[i]);
+	m_userInputGauge->Set(m_userInput);
+	m_xOffsetGauge->Set(m_gameRenderer->m_xOffset);
+	m_publicZGauge->Set(m_gameRenderer->m_publicZ);
+	m_visibleCellsGauge->Set(m_gameRenderer->m_visibleCells);
+	m_culledCellsGauge->Set(m_gameRenderer->m_culledCells);
+	m_dirtyCellsGauge->Set(m_gameRenderer->m_dirtyCells);
+	m_gridMemoryGauge->Set(m_gameRenderer->m_gridMemoryBytes / 1024.0);
+	m_liveDrawCallsGauge->Set(m_gameRenderer->m_liveDrawCalls);
+	m_bakedDrawCallsGauge->Set(m_gameRenderer->m_bakedDrawCalls);
+	m_bakeTimeGauge->Set(m_gameRenderer->m_bakeMilliseconds);
+	m_droppedInputsGauge->Set(m_inputQueue.GetDroppedCount());
+	m_pickedCellGauge->Set(m_gameRenderer->m_pickedCell);
+	m_pickTimeGauge->Set(m_gameRenderer->m_pickMilliseconds);
+}
+
+//writes every zone still in the profiler to trace.json in the app's local folder,
+//open it in chrome://tracing or ui.perfetto.dev, and the summary to the debug output.
+//The session's inputs go next to it in journal.bin, for JournalReplay to run again.
+void DirectX11_GameMain::DumpProfile()
+{
+	std::wstring folder = Windows::Storage::ApplicationData::Current->LocalFolder->Path->Data();
+	std::string trace = Profiler::ChromeTrace();
+
+	FILE* file = nullptr;
+	if (_wfopen_s(&file, (folder + L"\\trace.json").c_str(), L"wb") == 0 && file)
+	{
+		fwrite(trace.data(), 1, trace.size(), file);
+		fclose(file);
+	}
+
+	std::vector<uint8_t> journal = m_gameRenderer->FinishJournal();
+	file = nullptr;
+	if (_wfopen_s(&file, (folder + L"\\journal.bin").c_str(), L"wb") == 0 && file)
+	{
+		fwrite(journal.data(), 1, journal.size(), file);
+		fclose(file);
+	}
+
+	OutputDebugStringA(Profiler::Summary().c_str());
+	Profiler::Reset();
+}
+
+//called on the input thread like SetPlayerInputs, only the newest position in a tick is used
 void DirectX11_GameMain::SetPlayerData(int valueType, float data[]) 
 {
 	switch (valueType) 
 	{
 	case 0: //pointer position information
-		//doesn't work, easy to sample the texture and pull the location from the results
-		auto rotation = GetRadians();
-		float x = data[0];
-		float y = 0;
-		float z = data[1];
-		XMVECTOR vector = XMVECTOR({ x, y, z});
-		
-		XMMATRIX location = XMMatrixRotationNormal(vector, rotation);
-		auto modLocation = location.r[0].m128_f32;
-		
-		m_displayVal[3] = modLocation[0];
-		m_displayVal[4] = modLocation[2];
-		
-		m_gameRenderer->SetMouseClickLocation(modLocation[0], modLocation[2]);
-
+		m_inputQueue.PushPointer(valueType, data[0], data[1]);
 		break;
 	}
 }
 
+//the pointer in dips from the top left of the window, hit tested against the cubes on the next render
+void DirectX11_GameMain::ApplyPointer(float pointerX, float pointerY)
+{
+	m_gameRenderer->PickAt(pointerX, pointerY);
+}
+
 
 void DirectX11_GameMain::LoadCatResources()
 {
@@ -261,9 +420,30 @@ void DirectX11_GameMain::LoadCatResources()
 	ComPtr<ID3D11Resource> resource;
 	CD3D11_TEXTURE2D_DESC catDesc;
 
-	DX::ThrowIfFailed(
-		CreateWICTextureFromFile(device, L"cat.png", nullptr,
-			m_texture.ReleaseAndGetAddressOf()));
+	AssetArchive::TextureView catView;
+	if (m_assets && m_assets->GetTexture("cat", catView))
+	{
+		//already decoded and mipped by the packer, each mip goes to the device straight from the mapping
+		D3D11_SUBRESOURCE_DATA mips[AssetArchive::MAX_MIPS];
+		for (int mip = 0; mip < catView.mipCount; mip++)
+		{
+			mips[mip].pSysMem = catView.mips[mip].pixels;
+			mips[mip].SysMemPitch = catView.mips[mip].rowPitch;
+			mips[mip].SysMemSlicePitch = 0;
+		}
+
+		CD3D11_TEXTURE2D_DESC packedDesc(DXGI_FORMAT_R8G8B8A8_UNORM, catView.width, catView.height, 1, catView.mipCount,
+			D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+		ComPtr<ID3D11Texture2D> packed;
+		DX::ThrowIfFailed(device->CreateTexture2D(&packedDesc, mips, &packed));
+		DX::ThrowIfFailed(device->CreateShaderResourceView(packed.Get(), nullptr, m_texture.ReleaseAndGetAddressOf()));
+	}
+	else
+	{
+		DX::ThrowIfFailed(
+			CreateWICTextureFromFile(device, L"cat.png", nullptr,
+				m_texture.ReleaseAndGetAddressOf()));
+	}
 
 	//get the resources from the image
 	m_texture->GetResource(&resource);
@@ -283,6 +463,7 @@ void DirectX11_GameMain::LoadCatResources()
 }
 void DirectX11_GameMain::RenderCatTexture() 
 {
+	PROFILE_ZONE("GameMain::RenderCatTexture");
 	float time = float(m_timer.GetTotalSeconds());
 
 	//CatBackdrop
@@ -0,0 +1,151 @@
+﻿#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+	const size_t PAGE_SIZE = 4096;
+
+	size_t RoundUp(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	void* AllocateOverflow(size_t bytes)
+	{
+		return ::operator new(bytes, std::align_val_t(FrameArena::ALIGNMENT));
+	}
+
+	void FreeOverflow(void* memory)
+	{
+		::operator delete(memory, std::align_val_t(FrameArena::ALIGNMENT));
+	}
+}
+
+FrameArena::FrameArena(size_t capacity, bool hugePages) :
+	m_wantHugePages(hugePages),
+	m_hugePages(false),
+	m_memory(nullptr),
+	m_capacity(0),
+	m_mapped(0),
+	m_used(0),
+	m_overflowUsed(0),
+	m_highWater(0)
+{
+	//room for the overflow blocks of a frame, so noting one doesn't allocate as well
+	m_overflow.reserve(64);
+	if (capacity > 0)
+		Map(capacity);
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+	Unmap();
+}
+
+void* FrameArena::AllocateBytes(size_t bytes)
+{
+	size_t padded = RoundUp(bytes > 0 ? bytes : 1, ALIGNMENT);
+	if (m_used + padded <= m_capacity)
+	{
+		void* block = m_memory + m_used;
+		m_used += padded;
+		m_highWater = std::max(m_highWater, m_used + m_overflowUsed);
+		return block;
+	}
+
+	//doesn't fit this frame, Reset makes room for next time
+	void* block = AllocateOverflow(padded);
+	m_overflow.push_back(block);
+	m_overflowUsed += padded;
+	m_highWater = std::max(m_highWater, m_used + m_overflowUsed);
+	return block;
+}
+
+void FrameArena::Reset()
+{
+	if (!m_overflow.empty())
+	{
+		for (void* block : m_overflow)
+			FreeOverflow(block);
+		m_overflow.clear();
+
+		//grow once to what the busiest frame wanted, with a quarter spare
+		Unmap();
+		Map(m_highWater + m_highWater / 4);
+	}
+	m_used = 0;
+	m_overflowUsed = 0;
+}
+
+void FrameArena::Map(size_t capacity)
+{
+	m_hugePages = false;
+	m_memory = nullptr;
+
+#if defined(_WIN32)
+	//large pages need the lock pages in memory privilege, without it the first call fails
+	if (m_wantHugePages)
+	{
+		size_t largePage = GetLargePageMinimum();
+		if (largePage > 0)
+		{
+			m_mapped = RoundUp(capacity, largePage);
+			m_memory = static_cast<char*>(VirtualAlloc(nullptr, m_mapped, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+			m_hugePages = m_memory != nullptr;
+		}
+	}
+	if (!m_memory)
+	{
+		m_mapped = RoundUp(capacity, PAGE_SIZE);
+		m_memory = static_cast<char*>(VirtualAlloc(nullptr, m_mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+	}
+#else
+	//transparent huge pages, the kernel backs the mapping with them when it can
+	m_mapped = RoundUp(capacity, m_wantHugePages ? HUGE_PAGE_SIZE : PAGE_SIZE);
+	void* memory = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory != MAP_FAILED)
+	{
+		m_memory = static_cast<char*>(memory);
+#if defined(MADV_HUGEPAGE)
+		if (m_wantHugePages)
+			m_hugePages = madvise(memory, m_mapped, MADV_HUGEPAGE) == 0;
+#endif
+	}
+#endif
+
+	//a failed mapping leaves the arena empty, everything goes on the heap instead
+	m_capacity = m_memory ? m_mapped : 0;
+	if (!m_memory)
+		m_mapped = 0;
+}
+
+void FrameArena::Unmap()
+{
+	if (!m_memory)
+		return;
+#if defined(_WIN32)
+	VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+	munmap(m_memory, m_mapped);
+#endif
+	m_memory = nullptr;
+	m_capacity = 0;
+	m_mapped = 0;
+	m_hugePages = false;
+}
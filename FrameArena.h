@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace DirectX11_Game
+{
+	//Bump allocator for data that only lives for one frame. Every block starts
+	//on its own cache line and is padded out to the next one, so the SoA arrays
+	//handed out never share a line. Reset at the start of a frame throws
+	//everything away in O(1).
+	//
+	//The memory comes straight from the OS, optionally in huge pages, never from
+	//the general heap. When a frame asks for more than there is the extra goes
+	//on the heap for that frame only, and the next Reset grows the arena to the
+	//most any frame has used, so a steady frame never allocates.
+	class FrameArena
+	{
+	public:
+		static const size_t ALIGNMENT = 64;
+
+		// capacity	- bytes to start with, 0 waits for the first frame to say
+		// hugePages	- 2MB pages when the OS allows it, normal pages otherwise
+		FrameArena(size_t capacity = 0, bool hugePages = false);
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		//uninitialised, valid until the next Reset
+		template<class T>
+		T* Allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "nothing in the arena is ever destroyed");
+			static_assert(alignof(T) <= ALIGNMENT, "blocks are only aligned to a cache line");
+			return static_cast<T*>(AllocateBytes(sizeof(T) * count));
+		}
+		void* AllocateBytes(size_t bytes);
+
+		void Reset();
+
+		size_t GetUsed() const { return m_used; }
+		size_t GetCapacity() const { return m_capacity; }
+		//the most any frame has asked for, including what went on the heap
+		size_t GetHighWater() const { return m_highWater; }
+		bool HasHugePages() const { return m_hugePages; }
+
+	private:
+		void Map(size_t capacity);
+		void Unmap();
+
+		bool m_wantHugePages;
+		bool m_hugePages;
+		char* m_memory;
+		size_t m_capacity;
+		//the size of the mapping, the capacity rounded up to whole pages
+		size_t m_mapped;
+		size_t m_used;
+		size_t m_overflowUsed;
+		size_t m_highWater;
+		std::vector<void*> m_overflow;
+	};
+}
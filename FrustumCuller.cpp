@@ -0,0 +1,194 @@
+﻿#include "FrustumCuller.h"
+#include "Profiler.h"
+
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+//the cube mesh spans -0.5 to 0.5 on every axis
+const float FrustumCuller::CUBE_RADIUS = 0.8660254f;
+
+FrustumCuller::FrustumCuller() :
+	m_planes(),
+	m_stats()
+{
+	//until a camera is set every plane passes everything
+	for (Plane& plane : m_planes)
+		plane = { 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+void FrustumCuller::SetViewProjection(const ViewProjectionConstantBuffer& constants)
+{
+	//the shader does pos * view * projection, undo the transpose for the upload first
+	Float4x4 clip = MatrixTranspose(constants.view) * MatrixTranspose(constants.projection);
+
+	//row vectors, so clip space x is the dot product with the first column and so on
+	Plane column[4];
+	for (int j = 0; j < 4; j++)
+		column[j] = { clip.m[0][j], clip.m[1][j], clip.m[2][j], clip.m[3][j] };
+
+	auto combine = [](const Plane& w, const Plane& axis, float sign) -> Plane
+	{
+		return { w.a + sign * axis.a, w.b + sign * axis.b, w.c + sign * axis.c, w.d + sign * axis.d };
+	};
+
+	//-w <= x <= w, -w <= y <= w and 0 <= z <= w
+	m_planes[0] = combine(column[3], column[0], 1.0f);
+	m_planes[1] = combine(column[3], column[0], -1.0f);
+	m_planes[2] = combine(column[3], column[1], 1.0f);
+	m_planes[3] = combine(column[3], column[1], -1.0f);
+	m_planes[4] = column[2];
+	m_planes[5] = combine(column[3], column[2], -1.0f);
+
+	//normalized so the distances can be compared against a radius
+	for (Plane& plane : m_planes)
+	{
+		float length = sqrtf(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+		if (length > 0.0f)
+		{
+			plane.a /= length;
+			plane.b /= length;
+			plane.c /= length;
+			plane.d /= length;
+		}
+	}
+}
+
+FrustumCuller::Containment FrustumCuller::TestBox(const float* minimum, const float* maximum) const
+{
+	Containment result = INSIDE;
+	for (const Plane& plane : m_planes)
+	{
+		//the corner furthest along the plane normal, and the one furthest against it
+		float farX = plane.a >= 0.0f ? maximum[0] : minimum[0];
+		float farY = plane.b >= 0.0f ? maximum[1] : minimum[1];
+		float farZ = plane.c >= 0.0f ? maximum[2] : minimum[2];
+		float nearX = plane.a >= 0.0f ? minimum[0] : maximum[0];
+		float nearY = plane.b >= 0.0f ? minimum[1] : maximum[1];
+		float nearZ = plane.c >= 0.0f ? minimum[2] : maximum[2];
+
+		if (plane.a * farX + plane.b * farY + plane.c * farZ + plane.d < 0.0f)
+			return OUTSIDE;
+		if (plane.a * nearX + plane.b * nearY + plane.c * nearZ + plane.d < 0.0f)
+			result = PARTIAL;
+	}
+	return result;
+}
+
+bool FrustumCuller::TestSphere(float x, float y, float z, float radius) const
+{
+	for (const Plane& plane : m_planes)
+	{
+		if (plane.a * x + plane.b * y + plane.c * z + plane.d < -radius)
+			return false;
+	}
+	return true;
+}
+
+void FrustumCuller::Cull(const TransformBatch::Inputs& transforms, int columns, int cellCount)
+{
+	Clear();
+	CullChunk(transforms, columns, cellCount, 0);
+}
+
+void FrustumCuller::Clear()
+{
+	m_stats = Stats();
+	m_visible.clear();
+}
+
+//firstCell has to be the start of a row, every index in the chunk is offset by it
+void FrustumCuller::CullChunk(const TransformBatch::Inputs& transforms, int columns, int cellCount, int firstCell)
+{
+	PROFILE_ZONE("FrustumCuller::Cull");
+	if (cellCount <= 0 || columns <= 0)
+		return;
+	size_t visibleBefore = m_visible.size();
+	//room for every cell, so however many come into view the list never grows mid frame
+	m_visible.reserve(visibleBefore + cellCount);
+
+	m_centerX.resize(cellCount);
+	m_centerY.resize(cellCount);
+	m_centerZ.resize(cellCount);
+	TransformBatch::BuildCenters(transforms, cellCount, m_centerX.data(), m_centerY.data(), m_centerZ.data());
+
+	int rows = (cellCount + columns - 1) / columns;
+	int blockColumns = (columns + BLOCK_SIDE - 1) / BLOCK_SIDE;
+	int blockRows = (rows + BLOCK_SIDE - 1) / BLOCK_SIDE;
+	m_blocks.resize(static_cast<size_t>(blockColumns) * blockRows);
+	for (Block& block : m_blocks)
+	{
+		block.minimum[0] = block.minimum[1] = block.minimum[2] = FLT_MAX;
+		block.maximum[0] = block.maximum[1] = block.maximum[2] = -FLT_MAX;
+	}
+
+	//grow each block's box a row at a time so the centers are read in order
+	for (int i = 0; i < cellCount; i++)
+	{
+		int column = i % columns;
+		int row = i / columns;
+		Block& block = m_blocks[(row / BLOCK_SIDE) * blockColumns + column / BLOCK_SIDE];
+
+		float radius = CUBE_RADIUS * (transforms.scale ? transforms.scale[i] : transforms.uniformScale);
+		float center[3] = { m_centerX[i], m_centerY[i], m_centerZ[i] };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (center[axis] - radius < block.minimum[axis])
+				block.minimum[axis] = center[axis] - radius;
+			if (center[axis] + radius > block.maximum[axis])
+				block.maximum[axis] = center[axis] + radius;
+		}
+	}
+
+	for (Block& block : m_blocks)
+	{
+		block.containment = TestBox(block.minimum, block.maximum);
+		if (block.containment == INSIDE)
+			m_stats.blocksInside++;
+		else if (block.containment == PARTIAL)
+			m_stats.blocksPartial++;
+		else
+			m_stats.blocksOutside++;
+	}
+
+	//walk the cells in index order so the visible list stays sorted, whole runs
+	//of a block's row are taken or skipped at once
+	for (int row = 0; row < rows; row++)
+	{
+		int rowStart = row * columns;
+		int rowEnd = rowStart + columns;
+		if (rowEnd > cellCount)
+			rowEnd = cellCount;
+
+		const Block* blockRow = &m_blocks[(row / BLOCK_SIDE) * blockColumns];
+		for (int runStart = rowStart; runStart < rowEnd; runStart += BLOCK_SIDE)
+		{
+			int runEnd = runStart + BLOCK_SIDE;
+			if (runEnd > rowEnd)
+				runEnd = rowEnd;
+
+			Containment containment = blockRow[(runStart - rowStart) / BLOCK_SIDE].containment;
+			if (containment == OUTSIDE)
+				continue;
+
+			for (int i = runStart; i < runEnd; i++)
+			{
+				if (containment == INSIDE)
+				{
+					m_visible.push_back(firstCell + i);
+					continue;
+				}
+
+				float radius = CUBE_RADIUS * (transforms.scale ? transforms.scale[i] : transforms.uniformScale);
+				if (TestSphere(m_centerX[i], m_centerY[i], m_centerZ[i], radius))
+					m_visible.push_back(firstCell + i);
+			}
+		}
+	}
+
+	int visible = static_cast<int>(m_visible.size() - visibleBefore);
+	m_stats.visibleCells += visible;
+	m_stats.culledCells += cellCount - visible;
+}
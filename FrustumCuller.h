@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+#include "ShaderConstants.h"
+#include "TransformBatch.h"
+
+namespace DirectX11_Game
+{
+	//Works out which cubes of the grid can be seen from the camera. The grid is
+	//split into square blocks of cells, a block's box is tested against the
+	//frustum first and only blocks that straddle a plane test their cells one by one.
+	class FrustumCuller
+	{
+	public:
+		//cells along each side of a block
+		static const int BLOCK_SIDE = 16;
+
+		//bounding sphere of the unit cube mesh, multiplied by each cell's scale
+		static const float CUBE_RADIUS;
+
+		struct Stats
+		{
+			int visibleCells;
+			int culledCells;
+			int blocksInside;
+			int blocksPartial;
+			int blocksOutside;
+		};
+
+		FrustumCuller();
+
+		//takes the constants as they are uploaded, transposed
+		void SetViewProjection(const ViewProjectionConstantBuffer& constants);
+
+		//fills the visible list with the index of every cell that can be seen, in order
+		void Cull(const TransformBatch::Inputs& transforms, int columns, int cellCount);
+
+		//the same for a grid stored in chunks of whole rows, Clear and then cull each
+		//chunk in order. The visible list and stats cover every chunk so far.
+		void Clear();
+		void CullChunk(const TransformBatch::Inputs& transforms, int columns, int cellCount, int firstCell);
+
+		const std::vector<int>& GetVisible() const { return m_visible; }
+		const Stats& GetStats() const { return m_stats; }
+
+	private:
+		enum Containment
+		{
+			OUTSIDE,
+			PARTIAL,
+			INSIDE
+		};
+
+		//a*x + b*y + c*z + d >= 0 on the inside
+		struct Plane
+		{
+			float a;
+			float b;
+			float c;
+			float d;
+		};
+
+		//bounds of every cell's sphere in one block
+		struct Block
+		{
+			float minimum[3];
+			float maximum[3];
+			Containment containment;
+		};
+
+		Containment TestBox(const float* minimum, const float* maximum) const;
+		bool TestSphere(float x, float y, float z, float radius) const;
+
+		Plane m_planes[6];
+
+		std::vector<float> m_centerX;
+		std::vector<float> m_centerY;
+		std::vector<float> m_centerZ;
+		std::vector<Block> m_blocks;
+		std::vector<int> m_visible;
+
+		Stats m_stats;
+	};
+}
@@ -4,6 +4,8 @@
 
 #include "pch.h"
 #include "GameRenderer.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
 
 #include "..\Common\DirectXHelper.h"
 
@@ -12,28 +14,90 @@ using namespace DirectX11_Game;
 using namespace DirectX;
 using namespace Windows::Foundation;
 
+namespace
+{
+	//Bytecode straight out of the asset archive when it has the shader, otherwise
+	//read from the loose .cso file, which owned keeps alive.
+	struct ShaderBytes
+	{
+		const void* data;
+		size_t size;
+		std::shared_ptr<std::vector<byte>> owned;
+	};
+
+	Concurrency::task<ShaderBytes> LoadShaderAsync(const AssetArchive* assets, const wchar_t* fileName, const char* assetName)
+	{
+		AssetArchive::BlobView view;
+		if (assets && assets->GetShader(assetName, view))
+			return Concurrency::task_from_result(ShaderBytes{ view.data, view.size, nullptr });
+
+		return DX::ReadDataAsync(fileName).then([](const std::vector<byte>& fileData) {
+			auto owned = std::make_shared<std::vector<byte>>(fileData);
+			return ShaderBytes{ owned->data(), owned->size(), owned };
+			});
+	}
+}
+
 // Loads vertex and pixel shaders from files and instantiates the cube geometry.
-GameRenderer::GameRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, float xOff, float yOff) :
+GameRenderer::GameRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, float xOff, float yOff,
+	const std::shared_ptr<AssetArchive>& assets) :
 	m_loadingComplete(false),
 	m_degreesPerSecond(0),
 	m_indexCount(0),
+	m_indexFormat(IndexFormat::Index16),
 	m_tracking(false),
 	m_deviceResources(deviceResources),
-	m_additionalScaling(0.1),
-	m_waveIncremental(0),
-	//m_eye(new XMVECTORF32({ 0.0f, 5.7f, 11.5f, 0.0f })),
-	m_eye(new XMVECTORF32({ 0.0f, 5.7f, 11.5f, 0.0f })),
-	//the cube instances
-	m_modAmount(static_cast<int>(sqrtf((float)m_dataBufferSize))),
-	m_halfModAmount(m_modAmount >> 1),
-	m_dataBuffers(new ModelViewProjectionConstantBuffer[m_dataBufferSize]),
-	m_mandlebrotXScale(0.45f / (m_modAmount >> 2)),
-	m_mandlebrotYScale(0.25f / (m_modAmount >> 2))
+	m_assets(assets),
+	m_frameConstantsDirty(true),
+	//the grid can be resized while running, the chunks follow the simulation's frames
+	m_simulation(DEFAULT_GRID_SIDE, DEFAULT_GRID_SIDE),
+	m_chunkColumns(0),
+	m_chunkRows(0),
+	m_rendersSinceRebuild(0),
+	m_wavePaused(false),
+	m_liveDrawCalls(0),
+	m_bakedDrawCalls(0),
+	m_bakeMilliseconds(0),
+	m_gridMemoryBytes(0),
+	m_instancedRendering(true),
+	m_compactInstances(true),
+	m_residentInstances(true),
+	m_threadedSimulation(true),
+	m_interpolateFrames(true),
+	m_lastSequence(0),
+	m_drawnInputCount(0),
+	m_pickPending(false),
+	m_pickX(0),
+	m_pickY(0),
+	m_pickedCell(-1),
+	m_pickedPoint(),
+	m_pickMilliseconds(0),
+	m_dirtyCells(0),
+	m_visibleCells(0),
+	m_culledCells(0),
+	m_renderBackend(new D3D11RenderBackend(deviceResources))
 {
+	//everything the simulation is given from the first step on, so the session can be replayed headless
+	m_simulation.SetJournal(&m_journal);
+
+	//spread the grid update over the other cores, leaving one for rendering
+	unsigned int cores = std::thread::hardware_concurrency();
+	int reserved = m_threadedSimulation ? 2 : 1;
+	m_simulation.SetWorkerCount(cores > static_cast<unsigned int>(reserved) ? static_cast<int>(cores) - reserved : 0);
+	m_simulation.SetInterpolation(m_interpolateFrames);
+	m_simulation.SetPicking(true);
+
+	//every bind from the grid goes through here so repeats can be dropped
+	m_stateTracker = std::unique_ptr<StateTrackingBackend>(new StateTrackingBackend(*m_renderBackend));
+
 	CreateDeviceDependentResources(xOff, yOff);
 
 	// Initialize view for objects
 	CreateWindowSizeDependentResources();
+
+	//steps at the same 60hz the game timer used, Render takes whatever it has finished last
+	if (m_threadedSimulation)
+		m_simulation.Start();
 }
 
 // Initializes view parameters when the window size changes.
@@ -42,114 +106,282 @@ void GameRenderer::CreateWindowSizeDependentResources()
 	InitializePerspective();
 }
 
+//View and projection are shared by every cube, so they are kept in their own
+//constant buffer and only rebuilt when the output size, orientation or eye change.
 void GameRenderer::InitializePerspective() 
 {
-	//fixed size of 2
-	for (int i = 0; i < m_dataBufferSize; i++)
+	Size outputSize = m_deviceResources->GetOutputSize();
+	m_camera.SetOutputSize(outputSize.Width, outputSize.Height);
+
+	// This post-multiplication step is required for any draw calls that are made to the swap chain render target. For draw calls to other targets,
+	// this transform should not be applied.
+	XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
+	SimMath::Float4x4 orientationMatrix;
+	memcpy(&orientationMatrix, &orientation, sizeof(orientationMatrix));
+	m_camera.SetOrientation(orientationMatrix);
+
+	if (m_camera.Refresh())
+		m_frameConstantsDirty = true;
+}
+
+// Called once per frame, rotates the cube and calculates the model and view matrices.
+void GameRenderer::Update(float radians)
+{
+	PROFILE_ZONE("GameRenderer::Update");
+	if (!m_tracking)
+	{	
+		m_radians = radians;
+
+		//the grid math lives in GridSimulation, on its own thread it keeps its own
+		//fixed step and Render picks up the results, otherwise it steps here
+		if (!m_threadedSimulation)
+			m_simulation.Step();
+	}
+}
+
+//the simulation picks it up on its next step, the chunks are rebuilt when a frame at the new size arrives
+void GameRenderer::SetGridSize(int columns, int rows)
+{
+	columns = std::max(MIN_GRID_SIDE, std::min(columns, MAX_GRID_SIDE));
+	rows = std::max(MIN_GRID_SIDE, std::min(rows, MAX_GRID_SIDE));
+	m_simulation.Resize(columns, rows);
+}
+
+int GameRenderer::GetGridColumns() const
+{
+	return m_simulation.GetColumnCount();
+}
+
+int GameRenderer::GetGridRows() const
+{
+	return m_simulation.GetRowCount();
+}
+
+//every input sent to the simulation so far, shown on screen once m_drawnInputCount catches up
+int GameRenderer::GetQueuedInputCount() const
+{
+	return m_simulation.GetQueuedInputCount();
+}
+
+//One render chunk with its own matrices, batch and instance buffer for each of
+//the simulation's chunks, so a grid of millions of cells never needs one giant
+//allocation on either side.
+void GameRenderer::RebuildChunks(const SimulationFrame& frame)
+{
+	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+
+	m_chunks.clear();
+	m_chunks.resize(frame.GetChunkCount());
+	m_gridMemoryBytes = 0;
+	int rangeLimit = GridSimulation::GetDirtyRangeLimit(frame.rows);
+	m_changedRanges.reserve(rangeLimit);
+	for (int i = 0; i < frame.GetChunkCount(); i++)
 	{
-		
-		Size outputSize = m_deviceResources->GetOutputSize();
-		float aspectRatio = outputSize.Width / outputSize.Height;
-		float fovAngleY = 70.0f * XM_PI / 180.0f;
+		RenderChunk& chunk = m_chunks[i];
+		chunk.firstCell = frame.chunks[i].firstCell;
+		chunk.cellCount = frame.chunks[i].GetCellCount();
+		chunk.visibleBegin = 0;
+		chunk.visibleEnd = 0;
+		if (!m_instancedRendering || !m_compactInstances)
+			chunk.models.resize(chunk.cellCount);
+		if (m_instancedRendering)
+			chunk.batch.Reserve(chunk.cellCount, m_compactInstances, rangeLimit);
+
+		// One entry per cube, sized for the full matrices so the compact instances fit
+		// in the same buffer. Resident instances are updated a range at a time so they
+		// need a default usage buffer, otherwise InstanceBatch rewrites it every frame.
+		CD3D11_BUFFER_DESC instanceBufferDesc(
+			sizeof(InstanceData) * chunk.cellCount,
+			D3D11_BIND_VERTEX_BUFFER,
+			m_residentInstances ? D3D11_USAGE_DEFAULT : D3D11_USAGE_DYNAMIC,
+			m_residentInstances ? 0 : D3D11_CPU_ACCESS_WRITE
+		);
+		DX::ThrowIfFailed(
+			device->CreateBuffer(
+				&instanceBufferDesc,
+				nullptr,
+				&chunk.instanceBuffer
+			)
+		);
 
-		// This is a simple example of change that can be made when the app is in portrait or snapped view.
-		if (aspectRatio < 1.0f)
-		{
-			fovAngleY *= 2.0f;
-		}
+		m_gridMemoryBytes += chunk.models.capacity() * sizeof(ModelConstantBuffer) + sizeof(InstanceData) * chunk.cellCount;
+	}
 
-		// Note that the OrientationTransform3D matrix is post-multiplied here in order to correctly orient the scene to match the display orientation.
-		// This post-multiplication step is required for any draw calls that are made to the swap chain render target. For draw calls to other targets,
-		// this transform should not be applied.
+	m_chunkColumns = frame.columns;
+	m_chunkRows = frame.rows;
+	m_rendersSinceRebuild = 0;
+	//made for the old size, and the live draw count has to be measured again
+	m_bake.Clear();
+	m_bakeBuffers.clear();
+	m_liveDrawCalls = 0;
+	//the new buffers start out empty, so every cell has to go up again
+	m_lastSequence = -1;
+}
 
-		// This sample makes use of a right-handed coordinate system using row-major matrices.
-		XMMATRIX perspectiveMatrix = XMMatrixPerspectiveFovRH(fovAngleY, aspectRatio, 0.01f, 100.0f);
-		XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
-		XMMATRIX orientationMatrix = XMLoadFloat4x4(&orientation);
+//Bakes the grid once it has been still for a while, if drawing the bake takes
+//fewer calls than drawing it live did. Runs before Render's no allocation
+//scope, a bake allocates everything it makes.
+void GameRenderer::UpdateBake(const SimulationFrame& frame)
+{
+	bool still = m_bake.Track(frame.sequence, frame.lastChangedSequence);
+	if (!m_bake.IsBaked())
+		m_bakeBuffers.clear();
+	if (!still || m_bake.IsBaked() || !m_bake.IsWorthBaking(frame.GetCellCount(), m_liveDrawCalls))
+		return;
+
+	PROFILE_ZONE("GameRenderer::UpdateBake");
+	m_bake.Begin();
+	for (int i = 0; i < frame.GetChunkCount(); i++)
+		m_bake.Add(frame.GetInputs(i), frame.chunks[i].GetCellCount());
+	m_bake.End();
+
+	//never changes until it is thrown away, so the device can keep it wherever suits
+	ID3D11Device* device = m_deviceResources->GetD3DDevice();
+	m_bakeBuffers.resize(m_bake.GetChunkCount() * 2);
+	for (int i = 0; i < m_bake.GetChunkCount(); i++)
+	{
+		StaticGridBake::Chunk& chunk = m_bake.GetChunk(i);
 
-		XMStoreFloat4x4(
-			&m_dataBuffers[i].projection,
-			XMMatrixTranspose(perspectiveMatrix * orientationMatrix));
+		CD3D11_BUFFER_DESC vertexDesc(static_cast<UINT>(chunk.vertices.size() * sizeof(MeshVertex)), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		D3D11_SUBRESOURCE_DATA vertexData = { chunk.vertices.data(), 0, 0 };
+		DX::ThrowIfFailed(device->CreateBuffer(&vertexDesc, &vertexData, &m_bakeBuffers[i * 2]));
 
-		// Eye is at (0,0.7,1.5), looking at point (0,-0.1,0) with the up-vector along the y-axis.
-		//static const XMVECTORF32 eye = { 0.0f, 5.7f, 11.5f, 0.0f };
-		static const XMVECTORF32 at = { 0.0f, -0.1f, 0.0f, 0.0f };
-		static const XMVECTORF32 up = { 0.0f, 1.0f, 0.0f, 0.0f };
+		CD3D11_BUFFER_DESC indexDesc(static_cast<UINT>(chunk.indices.size() * sizeof(uint16_t)), D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_IMMUTABLE);
+		D3D11_SUBRESOURCE_DATA indexData = { chunk.indices.data(), 0, 0 };
+		DX::ThrowIfFailed(device->CreateBuffer(&indexDesc, &indexData, &m_bakeBuffers[i * 2 + 1]));
 
-		XMStoreFloat4x4(&m_dataBuffers[i].view, XMMatrixTranspose(XMMatrixLookAtRH(m_eye->v, at, up)));
+		chunk.vertexBuffer = m_bakeBuffers[i * 2].Get();
+		chunk.indexBuffer = m_bakeBuffers[i * 2 + 1].Get();
 	}
+	m_bake.ReleaseGeometry();
+	m_bakeMilliseconds = m_bake.GetBakeMilliseconds();
 }
 
-// Called once per frame, rotates the cube and calculates the model and view matrices.
-void GameRenderer::Update(float radians)
+//Hit tests the last pointer press against the frame's own step rather than the
+//blend that is drawn, at most a step away. The simulation thread built the
+//frame's picker with the step, so nothing is built here.
+void GameRenderer::ResolvePick(const SimulationFrame& frame)
 {
-	if (!m_tracking)
-	{	
-		m_radians = radians;
-		
-		int j = 0;
-		for (int i = 0; i < m_dataBufferSize; i++)
-		{
-			//increment row, locks to grid
-			if (i % m_modAmount == 0 && i != 0)
-				j++;
+	PROFILE_ZONE("GameRenderer::ResolvePick");
+	auto start = std::chrono::steady_clock::now();
+	m_pickPending = false;
+
+	//the pointer comes in dips, the camera works in pixels
+	Size logicalSize = m_deviceResources->GetLogicalSize();
+	Size outputSize = m_deviceResources->GetOutputSize();
+	float x = m_pickX * outputSize.Width / logicalSize.Width;
+	float y = m_pickY * outputSize.Height / logicalSize.Height;
+	PickRay ray = GridPicker::Unproject(m_camera.GetConstants(), x, y, outputSize.Width, outputSize.Height);
+
+	PickHit hit;
+	if (frame.picker.Pick(ray, hit))
+	{
+		m_pickedCell = hit.cell;
+		m_pickedPoint = hit.point;
+		SetMouseClickLocation(hit.point.x, hit.point.z);
+	}
+	else
+		m_pickedCell = -1;
+	m_pickMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-			int col = (i % m_modAmount) - m_halfModAmount;
-			int row = j - m_halfModAmount;
+//Works out which cells changed since the last frame that was drawn.
+void GameRenderer::CollectChangedRanges(const SimulationFrame& frame)
+{
+	int cellCount = frame.GetCellCount();
+
+	m_changedRanges.clear();
+	if (m_interpolateFrames)
+	{
+		//somewhere between the last two steps, so every cell moves every render
+		m_changedRanges.push_back({ 0, cellCount });
+	}
+	else if (frame.sequence == m_lastSequence + 1)
+	{
+		m_changedRanges = frame.dirtyRanges;
+	}
+	else if (frame.sequence != m_lastSequence)
+	{
+		//the steps in between were never seen, so neither were their changes
+		m_changedRanges.push_back({ 0, cellCount });
+	}
+	m_lastSequence = frame.sequence;
+	m_dirtyCells = frame.dirtyCellCount;
+}
 
-			//threadPool.push_back(std::thread(ExecutePerRow(radians, &m_dataBuffers[i], col, row, i)));
-			//m_threadPool->AddTask(ExecutePerRow);
-			ExecutePerRow(col, row, i);
+//Takes one chunk's transforms from the newest simulation frame and brings its
+//matrices and resident instances up to date with the cells that changed.
+TransformBatch::Inputs GameRenderer::PrepareTransforms(const SimulationFrame& frame, int chunkIndex, float alpha)
+{
+	RenderChunk& chunk = m_chunks[chunkIndex];
+	TransformBatch::Inputs transforms = m_interpolateFrames ?
+		m_interpolator.Blend(frame, chunkIndex, alpha) : frame.GetInputs(chunkIndex);
+
+	//the compact stream is expanded in the vertex shader, the other paths need the matrices
+	static_assert(sizeof(ModelConstantBuffer) == sizeof(SimMath::Float4x4), "the per cube constants are just the model matrix");
+	SimMath::Float4x4* models = reinterpret_cast<SimMath::Float4x4*>(chunk.models.data());
+	if (!m_instancedRendering || !m_compactInstances)
+	{
+		//the ranges are the whole grid's, only the part inside this chunk is built
+		for (const CellRange& range : m_changedRanges)
+		{
+			int begin = std::max(range.begin - chunk.firstCell, 0);
+			int end = std::min(range.end - chunk.firstCell, chunk.cellCount);
+			if (begin >= end)
+				continue;
+
+			TransformBatch::Inputs run = transforms;
+			run.x += begin;
+			run.y += begin;
+			run.z += begin;
+			run.yaw += begin;
+			TransformBatch::Build(run, end - begin, &models[begin]);
 		}
+	}
 
-		m_waveIncremental += 1;
-		if (m_waveIncremental > m_modAmount)
-			m_waveIncremental = -m_halfModAmount;
+	//Nothing submits the resident instances under a bake, so nothing would take
+	//their uploads either. They are left to go stale and sent whole once the bake goes.
+	if (m_instancedRendering && m_residentInstances && m_bake.IsBaked())
+		chunk.batch.Invalidate();
+	//the resident instances take just the cells that changed
+	else if (m_instancedRendering && m_residentInstances)
+	{
+		if (m_compactInstances)
+			chunk.batch.UpdateResidentCompact(transforms, chunk.cellCount, m_changedRanges, chunk.firstCell);
+		else
+			chunk.batch.UpdateResident(models, chunk.cellCount, m_changedRanges, chunk.firstCell);
 	}
+	return transforms;
 }
 
 // Rotate the 3D cube model a set amount of radians.
-void GameRenderer::Rotate(float radians, ModelViewProjectionConstantBuffer* modelBuffer)
+void GameRenderer::Rotate(float radians, ModelConstantBuffer* modelBuffer)
 {
 	// Prepare to pass the updated model matrix to the shader
-	XMStoreFloat4x4(&modelBuffer->model, 
-		XMMatrixTranspose(XMMatrixRotationY(radians)));
+	modelBuffer->model = SimMath::MatrixTranspose(SimMath::MatrixRotationY(radians));
 }
 
 // Rotate the 3D cube model a set amount of radians.
-void GameRenderer::Scale(float scaleAmt, ModelViewProjectionConstantBuffer* modelBuffer)
+void GameRenderer::Scale(float scaleAmt, ModelConstantBuffer* modelBuffer)
 {
 	// Prepare to pass the updated model matrix to the shader
-	XMStoreFloat4x4(&modelBuffer->model, 
-		XMMatrixTranspose(XMMatrixScaling(scaleAmt, scaleAmt, scaleAmt)));
+	modelBuffer->model = SimMath::MatrixTranspose(SimMath::MatrixScaling(scaleAmt, scaleAmt, scaleAmt));
 }
 
-void GameRenderer::ScaleRotate(float radians, float scaleAmt, ModelViewProjectionConstantBuffer* modelBuffer)
+void GameRenderer::ScaleRotate(float radians, float scaleAmt, ModelConstantBuffer* modelBuffer)
 {
-	XMStoreFloat4x4(&modelBuffer->model, 
-		XMMatrixTranspose(
-			XMMatrixScaling(scaleAmt, scaleAmt, scaleAmt) * 
-			XMMatrixRotationY(radians)));
+	modelBuffer->model = SimMath::MatrixTranspose(
+		SimMath::MatrixScaling(scaleAmt, scaleAmt, scaleAmt) *
+		SimMath::MatrixRotationY(radians));
 }
 
-void GameRenderer::Translate(XMFLOAT3 axis, ModelViewProjectionConstantBuffer* modelBuffer)
+void GameRenderer::Translate(XMFLOAT3 axis, ModelConstantBuffer* modelBuffer)
 {
-	XMStoreFloat4x4(&modelBuffer->model, 
-		XMMatrixTranspose(XMMatrixTranslation(axis.x, axis.y, axis.z)));
-}
-
-void GameRenderer::TranslateScaleRotate(float radians, float scaleAmt, XMFLOAT3 axis, ModelViewProjectionConstantBuffer* modelBuffer)
-{
-	
-	XMStoreFloat4x4(&modelBuffer->model, 
-		XMMatrixTranspose(
-			XMMatrixTranslation(axis.x, axis.y, axis.z) * 
-			XMMatrixRotationY(radians) * 
-			XMMatrixScaling(scaleAmt, scaleAmt, scaleAmt)));
+	modelBuffer->model = SimMath::MatrixTranspose(SimMath::MatrixTranslation(axis.x, axis.y, axis.z));
 }
 
 // When tracking, the 3D cube can be rotated around its Y axis by tracking pointer position relative to the output screen width.
-void GameRenderer::TrackingUpdate(float positionX, ModelViewProjectionConstantBuffer* modelBuffer)
+void GameRenderer::TrackingUpdate(float positionX, ModelConstantBuffer* modelBuffer)
 {
 	if (m_tracking)
 	{
@@ -161,65 +393,151 @@ void GameRenderer::TrackingUpdate(float positionX, ModelViewProjectionConstantBu
 // Renders one frame using the vertex and pixel shaders.
 void GameRenderer::Render()
 {
+	PROFILE_ZONE("GameRenderer::Render");
 	// Loading is asynchronous. Only draw geometry after it's loaded.
 	if (!m_loadingComplete)
 	{
 		return;
 	}
 
-	//LinkedData<ModelViewProjectionConstantBuffer> dataBufferLink;
+	//the sprite batch and text renderer share the context, so start from a clean slate
+	m_stateTracker->BeginFrame();
 
-	//https://docs.microsoft.com/en-us/windows/win32/direct3d11/d3d10-graphics-programming-guide-rasterizer-stage
-	//for each buffer stored in the data buffers draw the value stored
-	for (int i = 0; i < m_dataBufferSize; i++)
+	//the shared view and projection only go up when they changed
+	if (m_frameConstantsDirty)
 	{
-		DrawObject(m_dataBuffers[i]);
+		m_stateTracker->UpdateBuffer(m_frameConstantBuffer.Get(), &m_camera.GetConstants(), sizeof(ViewProjectionConstantBuffer));
+		m_culler.SetViewProjection(m_camera.GetConstants());
+		m_frameConstantsDirty = false;
 	}
 
-	//Draw resources instanced
-	//m_deviceResources->GetD3DDeviceContext()->DrawInstanced(m_indexCount, m_dataBufferSize, 0, 0);
+	//the newest step the simulation has finished, there is nothing to draw before the first
+	const SimulationFrame* frame = m_simulation.AcquireFrame();
+	if (!frame)
+		return;
+	m_drawnInputCount = frame->inputCount;
+	if (frame->columns != m_chunkColumns || frame->rows != m_chunkRows || m_chunks.empty())
+		RebuildChunks(*frame);
+	UpdateBake(*frame);
+	if (m_pickPending)
+		ResolvePick(*frame);
+
+	//once a frame at this size has been drawn every buffer and the arena are big enough
+	NoAllocationScope noAllocations("GameRenderer::Render", m_rendersSinceRebuild > 0);
+	m_rendersSinceRebuild++;
 
-}
+	CollectChangedRanges(*frame);
 
-void GameRenderer::DrawObject(ModelViewProjectionConstantBuffer& modelBuffer)
-{
-	//this is where multiple objects are drawn
-	auto context = m_deviceResources->GetD3DDeviceContext();
-	// Prepare the constant buffer to send it to the graphics device.
-	context->UpdateSubresource1(m_constantBuffer.Get(), 0, NULL, &modelBuffer, 0, 0, 0);
-	
-	auto result = context->GetType();
+	double sinceStep = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame->published).count();
+	float alpha = static_cast<float>(std::min(sinceStep / m_simulation.GetStepSeconds(), 1.0));
+
+	//the chunks are still culled under a bake, the resident instances catch up when it goes
+	bool drawBaked = m_bake.IsBaked();
+
+	m_interpolator.BeginFrame();
+	m_culler.Clear();
+	for (int i = 0; i < static_cast<int>(m_chunks.size()); i++)
+	{
+		RenderChunk& chunk = m_chunks[i];
+		TransformBatch::Inputs transforms = PrepareTransforms(*frame, i, alpha);
+
+		//only the cubes inside the view go any further
+		chunk.visibleBegin = static_cast<int>(m_culler.GetVisible().size());
+		m_culler.CullChunk(transforms, frame->columns, chunk.cellCount, chunk.firstCell);
+		chunk.visibleEnd = static_cast<int>(m_culler.GetVisible().size());
+
+		//one upload and one draw for each chunk
+		if (m_instancedRendering && !drawBaked)
+			DrawObjectInstanced(chunk, transforms);
+	}
+	m_visibleCells = m_culler.GetStats().visibleCells;
+	m_culledCells = m_culler.GetStats().culledCells;
+
+	//a few large draws of the whole grid, culling doesn't reach into the bake
+	if (drawBaked)
+	{
+		m_bake.Submit(*m_stateTracker, GetDrawBindings(false));
+		m_bakedDrawCalls = m_bake.GetChunkCount();
+		return;
+	}
+	m_bakedDrawCalls = 0;
 
-	// Each vertex is one instance of the VertexPositionColor struct.
-	UINT stride = sizeof(VertexPositionColor);
-	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, m_vertexBuffer.GetAddressOf(), &stride, &offset);
+	if (m_instancedRendering)
+	{
+		m_liveDrawCalls = static_cast<int>(m_stateTracker->GetFrameCounters().draws);
+		return;
+	}
 
-	// Each index is one 16-bit unsigned integer (short).
-	//Input assembly -  You need to attach each vertex and index buffer for each object in the scene
-	context->IASetIndexBuffer(m_indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	context->IASetInputLayout(m_inputLayout.Get());
+	//https://docs.microsoft.com/en-us/windows/win32/direct3d11/d3d10-graphics-programming-guide-rasterizer-stage
+	//for each visible buffer stored in the data buffers draw the value stored
+	const std::vector<int>& visible = m_culler.GetVisible();
+	for (RenderChunk& chunk : m_chunks)
+	{
+		for (int i = chunk.visibleBegin; i < chunk.visibleEnd; i++)
+			DrawObject(chunk.models[visible[i] - chunk.firstCell]);
+	}
+	m_liveDrawCalls = static_cast<int>(m_stateTracker->GetFrameCounters().draws);
+}
 
-	// Attach our vertex shader.
-	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+InstanceDrawBindings GameRenderer::GetDrawBindings(bool instanced)
+{
+	InstanceDrawBindings bindings;
+
+	// Each vertex is one instance of the VertexPositionColor struct, the index size comes from the mesh.
+	bindings.vertexBuffer = m_vertexBuffer.Get();
+	bindings.vertexStride = sizeof(VertexPositionColor);
+	bindings.indexBuffer = m_indexBuffer.Get();
+	bindings.indexFormat = m_indexFormat;
+	bindings.indexCount = m_indexCount;
+	bindings.inputLayout = m_inputLayout.Get();
+	bindings.vertexShader = m_vertexShader.Get();
+	if (instanced)
+	{
+		bindings.inputLayout = m_compactInstances ? m_compactInputLayout.Get() : m_instancedInputLayout.Get();
+		bindings.vertexShader = m_compactInstances ? m_compactVertexShader.Get() : m_instancedVertexShader.Get();
+	}
+	bindings.pixelShader = m_pixelShader.Get();
 
-	// Send the constant buffer to the graphics device.
-	context->VSSetConstantBuffers1(0, 1, m_constantBuffer.GetAddressOf(), nullptr, nullptr);
+	bindings.frameConstantBuffer = m_frameConstantBuffer.Get();
+	bindings.objectConstantBuffer = m_constantBuffer.Get();
+	bindings.objectConstantsSize = sizeof(ModelConstantBuffer);
 
-	// Attach our pixel shader.
-	context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+	//each chunk has its own, see DrawObjectInstanced
+	bindings.instanceBuffer = nullptr;
+	bindings.instanceCapacity = 0;
+	return bindings;
+}
 
-	// Draw the objects.
-	context->DrawIndexed(m_indexCount, 0, 0);
+void GameRenderer::DrawObject(ModelConstantBuffer& modelBuffer)
+{
+	//this is where multiple objects are drawn, the state tracker drops the binds
+	//that are the same as the last cube's so only the upload and draw go out
+	InstanceBatch::SubmitSingle(*m_stateTracker, GetDrawBindings(false), &modelBuffer);
 }
-void GameRenderer::DrawObjectInstanced(ModelViewProjectionConstantBuffer* modelBuffer)
+
+void GameRenderer::DrawObjectInstanced(RenderChunk& chunk, const TransformBatch::Inputs& transforms)
 {
 	//https://gamedev.stackexchange.com/questions/170192/instancing-with-directx11
-	//this is where multiple objects are drawn
-	auto context = m_deviceResources->GetD3DDeviceContext();
+	const std::vector<int>& visible = m_culler.GetVisible();
+	InstanceDrawBindings bindings = GetDrawBindings(true);
+	bindings.instanceBuffer = chunk.instanceBuffer.Get();
+	bindings.instanceCapacity = chunk.cellCount;
 
-	context->DrawInstanced(8, m_indexCount, 0, 1);
+	//already uploaded as the cells changed, only the visible runs are drawn
+	if (m_residentInstances)
+	{
+		chunk.batch.SubmitResident(*m_stateTracker, bindings, &visible, chunk.firstCell);
+		return;
+	}
+
+	const int* chunkVisible = visible.data() + chunk.visibleBegin;
+	int visibleCount = chunk.visibleEnd - chunk.visibleBegin;
+	if (m_compactInstances)
+		chunk.batch.PackCompact(transforms, chunkVisible, visibleCount, chunk.firstCell);
+	else
+		chunk.batch.Pack(reinterpret_cast<const SimMath::Float4x4*>(chunk.models.data()), chunkVisible, visibleCount, chunk.firstCell);
+
+	chunk.batch.Submit(*m_stateTracker, bindings);
 }
 
 //Shapes
@@ -228,16 +546,19 @@ void GameRenderer::DrawObjectInstanced(ModelViewProjectionConstantBuffer* modelB
 //Initialize the shaders and shapes to be used later
 void GameRenderer::CreateDeviceDependentResources(float xOff, float yOff)
 {
-	// Load shaders asynchronously.
-	auto loadVSTask = DX::ReadDataAsync(L"SampleVertexShader.cso");
-	auto loadPSTask = DX::ReadDataAsync(L"SamplePixelShader.cso");
+	// Load shaders asynchronously, from the archive when there is one.
+	const AssetArchive* assets = m_assets.get();
+	auto loadVSTask = LoadShaderAsync(assets, L"GridVertexShader.cso", "GridVertexShader");
+	auto loadPSTask = LoadShaderAsync(assets, L"SamplePixelShader.cso", "SamplePixelShader");
+	auto loadInstancedVSTask = LoadShaderAsync(assets, L"InstancedVertexShader.cso", "InstancedVertexShader");
+	auto loadCompactVSTask = LoadShaderAsync(assets, L"CompactInstancedVertexShader.cso", "CompactInstancedVertexShader");
 
 	// After the vertex shader file is loaded, create the shader and input layout.
-	auto createVSTask = loadVSTask.then([this](const std::vector<byte>& fileData) {
+	auto createVSTask = loadVSTask.then([this](const ShaderBytes& shader) {
 		DX::ThrowIfFailed(
 			m_deviceResources->GetD3DDevice()->CreateVertexShader(
-				&fileData[0],
-				fileData.size(),
+				shader.data,
+				shader.size,
 				nullptr,
 				&m_vertexShader
 			)
@@ -253,25 +574,26 @@ void GameRenderer::CreateDeviceDependentResources(float xOff, float yOff)
 			m_deviceResources->GetD3DDevice()->CreateInputLayout(
 				vertexDesc,
 				ARRAYSIZE(vertexDesc),
-				&fileData[0],
-				fileData.size(),
+				shader.data,
+				shader.size,
 				&m_inputLayout
 			)
 		);
 		});
 
 	// After the pixel shader file is loaded, create the shader and constant buffer.
-	auto createPSTask = loadPSTask.then([this](const std::vector<byte>& fileData) {
+	auto createPSTask = loadPSTask.then([this](const ShaderBytes& shader) {
 		DX::ThrowIfFailed(
 			m_deviceResources->GetD3DDevice()->CreatePixelShader(
-				&fileData[0],
-				fileData.size(),
+				shader.data,
+				shader.size,
 				nullptr,
 				&m_pixelShader
 			)
 		);
 
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+		// Per cube model matrix, only used when not drawing instanced.
+		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
 		DX::ThrowIfFailed(
 			m_deviceResources->GetD3DDevice()->CreateBuffer(
 				&constantBufferDesc,
@@ -279,10 +601,85 @@ void GameRenderer::CreateDeviceDependentResources(float xOff, float yOff)
 				&m_constantBuffer
 			)
 		);
+
+		// View and projection shared by every cube.
+		CD3D11_BUFFER_DESC frameConstantBufferDesc(sizeof(ViewProjectionConstantBuffer), D3D11_BIND_CONSTANT_BUFFER);
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateBuffer(
+				&frameConstantBufferDesc,
+				nullptr,
+				&m_frameConstantBuffer
+			)
+		);
+		m_frameConstantsDirty = true;
+		});
+
+	// The instanced vertex shader reads the model matrix from a second, per-instance vertex stream.
+	auto createInstancedVSTask = loadInstancedVSTask.then([this](const ShaderBytes& shader) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateVertexShader(
+				shader.data,
+				shader.size,
+				nullptr,
+				&m_instancedVertexShader
+			)
+		);
+
+		static const D3D11_INPUT_ELEMENT_DESC instancedVertexDesc[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "INSTANCEMODEL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCEMODEL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCEMODEL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCEMODEL", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateInputLayout(
+				instancedVertexDesc,
+				ARRAYSIZE(instancedVertexDesc),
+				shader.data,
+				shader.size,
+				&m_instancedInputLayout
+			)
+		);
+
+		//the instance buffers are per chunk and made by RebuildChunks once the grid size is known
+		});
+
+	// The compact vertex shader builds the model matrix from position, yaw and scale.
+	auto createCompactVSTask = loadCompactVSTask.then([this](const ShaderBytes& shader) {
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateVertexShader(
+				shader.data,
+				shader.size,
+				nullptr,
+				&m_compactVertexShader
+			)
+		);
+
+		static const D3D11_INPUT_ELEMENT_DESC compactVertexDesc[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "INSTANCEPLACEMENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCESCALE", 0, DXGI_FORMAT_R32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateInputLayout(
+				compactVertexDesc,
+				ARRAYSIZE(compactVertexDesc),
+				shader.data,
+				shader.size,
+				&m_compactInputLayout
+			)
+		);
 		});
 
 	// Once both shaders are loaded, create the mesh.
-	auto createCubeTask = (createPSTask && createVSTask).then(
+	auto createCubeTask = (createPSTask && createVSTask && createInstancedVSTask && createCompactVSTask).then(
 		[this]()
 		{
 			CreateCube();
@@ -301,62 +698,21 @@ HRESULT GameRenderer::CreateCube()
 	// Use the Direct3D device to load resources into graphics memory.
 	ID3D11Device* device = m_deviceResources->GetD3DDevice();
 
-	// Cube Geometry.
-	VertexPositionColor CubeVertices[] = {
-			{DirectX::XMFLOAT3(-0.5f,-0.5f,-0.5f), DirectX::XMFLOAT3(0,   0,   0),},
-			{DirectX::XMFLOAT3(-0.5f,-0.5f, 0.5f), DirectX::XMFLOAT3(0,   0,   1),},
-			{DirectX::XMFLOAT3(-0.5f, 0.5f,-0.5f), DirectX::XMFLOAT3(0,   1,   0),},
-			{DirectX::XMFLOAT3(-0.5f, 0.5f, 0.5f), DirectX::XMFLOAT3(0,   1,   1),},
-			{DirectX::XMFLOAT3(0.5f,-0.5f,-0.5f), DirectX::XMFLOAT3(1,   0,   0),},
-			{DirectX::XMFLOAT3(0.5f,-0.5f, 0.5f), DirectX::XMFLOAT3(1,   0,   1),},
-			{DirectX::XMFLOAT3(0.5f, 0.5f,-0.5f), DirectX::XMFLOAT3(1,   1,   0),},
-			{DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f), DirectX::XMFLOAT3(1,   1,   1),}
-	};
-
-
-	/*VertexPositionColor CubeVertices[] = {
-			{DirectX::XMFLOAT3(-0.5f,-0.5f,-0.5f), DirectX::XMFLOAT3(0,   0,   0),},
-			{DirectX::XMFLOAT3(-0.5f,-0.5f, 0.5f), DirectX::XMFLOAT3(0,   0,   0.5),},
-			{DirectX::XMFLOAT3(-0.5f, 0.5f,-0.5f), DirectX::XMFLOAT3(0,   0.5,   0),},
-			{DirectX::XMFLOAT3(-0.5f, 0.5f, 0.5f), DirectX::XMFLOAT3(0,   0.5,   0.5),},
-			{DirectX::XMFLOAT3(0.5f,-0.5f,-0.5f), DirectX::XMFLOAT3(0.5,   0,   0),},
-			{DirectX::XMFLOAT3(0.5f,-0.5f, 0.5f), DirectX::XMFLOAT3(0.5,   0,   0.5),},
-			{DirectX::XMFLOAT3(0.5f, 0.5f,-0.5f), DirectX::XMFLOAT3(0.5,   0.5,   0),},
-			{DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f), DirectX::XMFLOAT3(0.5,   0.5,   0.5),}
-	};*/
-
-	/*	Cube
-	VertexPositionColor ver1 = { XMFLOAT3(xOff + -0.5f, yOff + -0.5f, -0.5f),	XMFLOAT3(0.0f, 0.0f, 0.0f) };
-	VertexPositionColor ver2 = { XMFLOAT3(xOff + -0.5f, yOff + -0.5f,  0.5f),	XMFLOAT3(0.0f, 0.0f, 1.0f) };
-	VertexPositionColor ver3 = { XMFLOAT3(xOff + -0.5f, yOff + 0.5f, -0.5f),	XMFLOAT3(0.0f, 1.0f, 0.0f) };
-	VertexPositionColor ver4 = { XMFLOAT3(xOff + -0.5f, yOff + 0.5f,  0.5f),	XMFLOAT3(0.0f, 1.0f, 1.0f) };
-	VertexPositionColor ver5 = { XMFLOAT3(xOff + 0.5f,	yOff + -0.5f, -0.5f),	XMFLOAT3(1.0f, 0.0f, 0.0f) };
-	VertexPositionColor ver6 = { XMFLOAT3(xOff + 0.5f,	yOff + -0.5f, 0.5f),	XMFLOAT3(1.0f, 0.0f, 1.0f) };
-	VertexPositionColor ver7 = { XMFLOAT3(xOff + 0.5f,	yOff + 0.5f, -0.5f),	XMFLOAT3(1.0f, 1.0f, 0.0f) };
-	VertexPositionColor ver8 = { XMFLOAT3(xOff + 0.5f,	yOff + 0.5f, 0.5f),		XMFLOAT3(1.0f, 1.0f, 1.0f) };
-	*/
-
-	/* Half Triangle?
-	VertexPositionColor ver1 = { XMFLOAT3(xOff + -0.5f, yOff + 0.5f, -0.5f),	XMFLOAT3(0.0f, 1.0f, 0.0f) };
-	VertexPositionColor ver2 = { XMFLOAT3(xOff + -0.5f, yOff + -0.5f,  0.5f),	XMFLOAT3(0.0f, 0.0f, 1.0f) };
-	VertexPositionColor ver3 = { XMFLOAT3(xOff + -0.5f, yOff + 0.5f, -0.5f),	XMFLOAT3(0.0f, 1.0f, 0.0f) };
-	VertexPositionColor ver4 = { XMFLOAT3(xOff + -0.5f, yOff + 0.5f,  0.5f),	XMFLOAT3(0.0f, 1.0f, 1.0f) };
-	VertexPositionColor ver5 = { XMFLOAT3(xOff + 0.5f,	yOff + 0.5f, -0.5f),	XMFLOAT3(1.0f, 1.0f, 0.0f) };
-	VertexPositionColor ver6 = { XMFLOAT3(xOff + 0.5f,	yOff + -0.5f, 0.5f),	XMFLOAT3(1.0f, 0.0f, 1.0f) };
-	VertexPositionColor ver7 = { XMFLOAT3(xOff + 0.5f,	yOff + 0.5f, -0.5f),	XMFLOAT3(1.0f, 1.0f, 0.0f) };
-	VertexPositionColor ver8 = { XMFLOAT3(xOff + 0.5f,	yOff + 0.5f, 0.5f),		XMFLOAT3(1.0f, 1.0f, 1.0f) };
-	*/
+	//the same eight corners and colours as always, in vertex cache order
+	static_assert(sizeof(MeshVertex) == sizeof(VertexPositionColor), "mesh vertices go straight into the vertex buffer");
+	Mesh cube = MeshBuilder::Cube();
+	m_bake.SetMesh(cube);
 
 	// Create vertex buffer:
 
 	CD3D11_BUFFER_DESC vDesc(
-		sizeof(CubeVertices),
+		static_cast<UINT>(cube.vertices.size() * sizeof(MeshVertex)),
 		D3D11_BIND_VERTEX_BUFFER
 	);
 
 	D3D11_SUBRESOURCE_DATA vData;
 	ZeroMemory(&vData, sizeof(D3D11_SUBRESOURCE_DATA));
-	vData.pSysMem = CubeVertices;
+	vData.pSysMem = cube.vertices.data();
 	vData.SysMemPitch = 0;
 	vData.SysMemSlicePitch = 0;
 
@@ -366,38 +722,21 @@ HRESULT GameRenderer::CreateCube()
 		&m_vertexBuffer
 	);
 
-	// Create index buffer:
-	unsigned short CubeIndices[] =
-	{
-		0,2,1, // -x
-		1,2,3,
-
-		4,5,6, // +x
-		5,7,6,
-
-		0,1,5, // -y
-		0,5,4,
-
-		2,6,7, // +y
-		2,7,3,
-
-		0,4,6, // -z
-		0,6,2,
-
-		1,3,7, // +z
-		1,7,5,
-	};
+	// Create index buffer, 16 bit unless the mesh has too many vertices for it:
+	std::vector<unsigned char> indices(static_cast<size_t>(cube.GetIndexCount()) * cube.GetIndexSize());
+	cube.CopyIndices(indices.data());
 
-	m_indexCount = ARRAYSIZE(CubeIndices);
+	m_indexCount = cube.GetIndexCount();
+	m_indexFormat = cube.GetIndexSize() == 2 ? IndexFormat::Index16 : IndexFormat::Index32;
 
 	CD3D11_BUFFER_DESC iDesc(
-		sizeof(CubeIndices),
+		static_cast<UINT>(indices.size()),
 		D3D11_BIND_INDEX_BUFFER
 	);
 
 	D3D11_SUBRESOURCE_DATA iData;
 	ZeroMemory(&iData, sizeof(D3D11_SUBRESOURCE_DATA));
-	iData.pSysMem = CubeIndices;
+	iData.pSysMem = indices.data();
 	iData.SysMemPitch = 0;
 	iData.SysMemSlicePitch = 0;
 
@@ -415,109 +754,65 @@ void GameRenderer::ReleaseDeviceDependentResources()
 	m_loadingComplete = false;
 	m_vertexShader.Reset();
 	m_inputLayout.Reset();
+	m_instancedVertexShader.Reset();
+	m_instancedInputLayout.Reset();
+	m_compactVertexShader.Reset();
+	m_compactInputLayout.Reset();
+	//the instance buffers go with the chunks, the next Render rebuilds them
+	m_chunks.clear();
+	m_gridMemoryBytes = 0;
+	m_lastSequence = -1;
+	m_bake.Clear();
+	m_bakeBuffers.clear();
 	m_pixelShader.Reset();
 	m_constantBuffer.Reset();
+	m_frameConstantBuffer.Reset();
 	m_vertexBuffer.Reset();
 	m_indexBuffer.Reset();
 }
 
-void GameRenderer::ExecutePerRow(int& column, int& row, int& index)
+void GameRenderer::ModifyCameraPosition(float amount, int direction)
 {
-	
-	//once the shape gets to as large as it will be, reduce it back to original
-	//scaling
-	//double rotation = fmod(totalRotation, 2) / 2;
-	//if (rotation > 1)
-	//	rotation = 1 - rotation;
-
-	//set the value to the gridded location, offset so it is centered on screen
-	float x = static_cast<float>(column);
-	float z = static_cast<float>(row);
-
-	//	Manipulate the Grid onClick
-	//translation modifiers, creates gridded formation
-	XMFLOAT3 axisLocation = XMFLOAT3({ static_cast<float>(column), 0, static_cast<float>(row) });
-	XMFLOAT3 axisMods = XMFLOAT3({ x + m_cameraOffset.x, 0 + m_cameraOffset.y, z + m_cameraOffset.z });
-	
-	axisMods = GetManipulatedValues(&axisMods, index);
-
-	//	Create the Wave
-	//10 is the upper limit to how far back the wave travels
-	for (int j = 0; j < 10; j++)
-	{
-		//maximum wave size is 10, step of 0.2
-		//waveNum
-		//x
-		//y
-		float diff = 2 - (j * 0.2f);
-		if (z + j == m_waveIncremental)
-			axisMods.y += diff / 2;
-		else if (z - j == m_waveIncremental)
-			axisMods.y += diff / 4;
-
-		if (x + j == m_waveIncremental)
-			axisMods.y += diff;
-		else if (x - j == m_waveIncremental)
-			axisMods.y += diff / 2;
-
-		//difficulty implementing, please debug
-		//GetWaveValue(j, x, z, 0.2f);
-	}
-
-
-	//if (m_manipulationType == 6) 
-	//	axisMods.x -= GetManipulatedValue(&axisLocation);
-	//float xRot = (m_modAmount / axisMods.x) * 360;
-	//float zRot = (m_modAmount / axisMods.z) * 360;
-	TranslateScaleRotate(m_radians + GetManipulatedRotation(&axisMods), m_additionalScaling, axisMods, &m_dataBuffers[index]);
+	m_xOffset += static_cast<int>(amount);
+	m_simulation.ModifyCameraPosition(amount, direction);
 }
 
+void GameRenderer::UpdatePerspective(float amount)
+{
+	//m_eye->f[1] += amount * 10;
+	//m_eye->f[2] += amount * 10;
+	m_simulation.UpdatePerspective(amount);
+}
 
-// waveNum	- amount of waves that can be created
-// x			- index of x
-// z			- index of z
-// waveSize	- actual size of a wave
-float GameRenderer::GetWaveValue(int waveNum, int x, int z, float waveIncrement)
+void GameRenderer::SetPlaneManipulation(int manipulationType)
 {
-	float smallestWaveSize = 2 - (waveNum * waveIncrement);
-	float waveSize = smallestWaveSize;
-	if (x - waveNum == m_waveIncremental)
-		waveSize += smallestWaveSize * 2; //+ diff * 2
-			
-	if (z + waveNum == m_waveIncremental)
-		waveSize += smallestWaveSize * 2; //+ diff * 2
-	else if (z - waveNum == m_waveIncremental)
-		waveSize += smallestWaveSize * 4; // diff
-	return waveSize;
+	m_simulation.SetPlaneManipulation(manipulationType);
 }
 
-void GameRenderer::ModifyCameraPosition(float amount, int direction)
+//resolved on the next Render, against whatever frame it draws
+void GameRenderer::PickAt(float pointerX, float pointerY)
 {
-	m_xOffset += static_cast<int>(amount);
-	switch (direction)
-	{
-	case 0:
-		m_cameraOffset.x += amount;
-		break;
-	case 1:
-		m_cameraOffset.y += amount;
-		break;
-	case 2:
-		m_cameraOffset.z += amount;
-		break;
-	}
+	m_pickPending = true;
+	m_pickX = pointerX;
+	m_pickY = pointerY;
 }
 
-void GameRenderer::UpdatePerspective(float amount)
+//with the rotation stopped as well the grid stops changing, and gets baked after a moment
+void GameRenderer::ToggleWavePaused()
 {
-	m_additionalScaling += amount;
-	//m_eye->f[1] += amount * 10;
-	//m_eye->f[2] += amount * 10;
+	m_wavePaused = !m_wavePaused;
+	m_simulation.SetWavePaused(m_wavePaused);
+}
 
-	if (m_additionalScaling <= 0) 
-	{
-		m_additionalScaling = 0.02;
-	}
+//the session so far as a journal for JournalReplay, the thread pauses while the grid is checksummed
+std::vector<uint8_t> GameRenderer::FinishJournal()
+{
+	if (m_threadedSimulation)
+		m_simulation.Stop();
+	std::vector<uint8_t> journal = m_simulation.FinishJournal();
+	if (m_threadedSimulation)
+		m_simulation.Start();
+	return journal;
 }
 
 //Adjust the rotations by set amount, modtype(0=positive, 1=negative)
@@ -526,6 +821,7 @@ void GameRenderer::ModifyDegreesPerSecond(float amount, int modType)
 	if (amount == 0) 
 	{
 		m_degreesPerSecond = amount;
+		m_simulation.SetDegreesPerSecond(m_degreesPerSecond);
 		return;
 	}
 
@@ -545,205 +841,5 @@ void GameRenderer::ModifyDegreesPerSecond(float amount, int modType)
 		m_degreesPerSecond -= amount;
 		break;
 	}
-}
-
-
-float GameRenderer::GetManipulatedValue(XMFLOAT3* axisValues) 
-{
-	float valX = (m_modAmount - axisValues->x);
-	float valZ = (m_modAmount - axisValues->z);
-	//https://stackoverflow.com/questions/969798/plotting-a-point-on-the-edge-of-a-sphere
-	float decimalPercentX = static_cast<float>(m_modAmount) / valX;
-	float decimalPercentZ = static_cast<float>(m_modAmount) / valZ;
-	float wholePercent = decimalPercentX * 100;
-	
-	//float valZ = (m_halfModAmount - axisValues->z) / 2.f;
-	switch (m_manipulationType) 
-	{
-	case 1:
-		return cosf(valX);
-	case 2:
-		return cosf(valZ);
-		//return sinf(valZ);
-	case 3:
-		return cosf(valZ) + cosf(valX);
-	case 4:
-		//return cosf(valZ * valX); //every 5th we see more stability
-		//return cosf((valZ / valX) * m_modAmount); //we see it go progressively smaller the larger X is 
-		return cosf((valX / valZ) * m_modAmount) + cosf((valZ / valX) * m_modAmount);
-	case 5:
-		return wholePercent;
-	case 6:
-		//return fabsf(cosf(wholePercent));
-		//currentX + circleCenter * cos(angle)
-		
-		//return(cosf(XMConvertToRadians(decimalPercentX * 360)) * sinf(XMConvertToRadians(decimalPercentZ * 360)));
-		return XMConvertToRadians(decimalPercentX * 180) + XMConvertToRadians(decimalPercentZ * 180);
-	case 0:
-	default:
-		return 0.f;
-	}
-}
-
-float GameRenderer::GetManipulatedValue(float* axis)
-{
-	float val = (m_modAmount - *axis);
-	//https://stackoverflow.com/questions/969798/plotting-a-point-on-the-edge-of-a-sphere
-	float decimalPercent = static_cast<float>(m_modAmount) / val;
-	float wholePercent = decimalPercent * 100;
-	float radians = XMConvertToRadians(decimalPercent * 360);
-	//float valZ = (m_halfModAmount - axisValues->z) / 2.f;
-	switch (m_manipulationType)
-	{
-	case 1:
-		return cosf(val);
-	case 2:
-		return cosf(val);
-		//return sinf(valZ);
-	case 3:
-		return cosf(val) + sinf(val);
-	case 4:
-		//return cosf(valZ * valX); //every 5th we see more stability
-		//return cosf((valZ / valX) * m_modAmount); //we see it go progressively smaller the larger X is 
-		return m_halfModAmount * cosf(val * m_modAmount) + sinf(val * m_modAmount);
-	case 5:
-		return wholePercent;
-	case 6:
-		//return fabsf(cosf(wholePercent));
-		//currentX + circleCenter * cos(angle)
-
-		return m_halfModAmount * (cosf(radians) * sinf(radians));
-	case 0:
-	default:
-		return 0.f;
-	}
-}
-
-XMFLOAT3 GameRenderer::GetManipulatedValues(XMFLOAT3* axisValues, int arrayIndexValue)
-{
-	XMFLOAT3 newAxisValues = *axisValues;
-	
-	float valX = m_modAmount - axisValues->x;
-	float valZ = m_modAmount - axisValues->z;
-	//https://stackoverflow.com/questions/969798/plotting-a-point-on-the-edge-of-a-sphere
-	float decimalPercentX = static_cast<float>(m_modAmount) / valX;
-	float decimalPercentZ = static_cast<float>(m_modAmount) / valZ;
-	float wholePercent = decimalPercentX * 100;
-	
-	float xRadians = XMConvertToRadians(decimalPercentX * 360); //-50
-	float zRadians = XMConvertToRadians(decimalPercentZ * 360);
-	
-	//float valZ = (m_halfModAmount - axisValues->z) / 2.f;
-	switch (m_manipulationType)
-	{
-	case 1:
-		newAxisValues.y -= cosf(valX);
-		break;
-	case 2:
-		newAxisValues.y -= cosf(valZ);
-		break;
-		//return sinf(valZ);
-	case 3:
-		newAxisValues.y -= cosf(valZ) + cosf(valX);
-		break;
-	case 4: //mandlebrot
-		
-		//alternative		if (m_storedMandlebrot.find(XMFLOAT2(valX, valZ)) == m_storedMandlebrot.end())
-		//if (m_storedMandlebrot.count(arrayIndexValue) == 0)
-		//{
-		//	//insert the mandlebrot value
-		//	m_storedMandlebrot.insert(
-		//		std::make_pair(
-		//			arrayIndexValue, 
-		//			static_cast<float>(GetMandlebrotOffset(valX, valZ))));
-		//} 		
-		//newAxisValues.y = m_storedMandlebrot.at(arrayIndexValue);
-		newAxisValues.y = GetMandlebrotOffset(valX + (m_cameraOffset.y / 2), valZ + (m_cameraOffset.y / 2));
-
-		break;
-	case 5: //gravity well
-		//distance from the center
-		
-		//potentialInFeet = valX - m_halfModAmount
-		//radialDistanceFromCenter = valZ - m_halfModAmount
-		
-		newAxisValues.x = valX - m_halfModAmount;
-		newAxisValues.y = valZ - m_halfModAmount;
-		newAxisValues.z += (32.2 * 10) / m_halfModAmount; //velocity
-		//newAxisValues.y = tanf((valX * m_halfModAmount + valZ * m_halfModAmount) / (sqrtf((valX * 2) + (valZ * 2)) * sqrtf(m_modAmount + m_modAmount))); //velocity
-		break;
-	case 6: //sphere
-		//return fabsf(cosf(wholePercent));
-		//currentX + circleCenter * cos(angle)
-		//xRadians = XMConvertToRadians(decimalPercentX * 360);
-		//zRadians = XMConvertToRadians(decimalPercentZ * 360);
-
-		newAxisValues.z = m_halfModAmount * cosf(xRadians) * sinf(xRadians);
-		newAxisValues.x = m_halfModAmount * cosf(xRadians) * sinf(zRadians);
-		newAxisValues.y = m_halfModAmount * cosf(zRadians);
-		//newAxisValues.z = m_halfModAmount	* (cosf(zRadians)); // * sinf(zRadians));
-		break; 
-	case 0:
-	default:
-		//newAxisValues.y -= cosf(XMConvertToRadians(decimalPercentX * 360));
-		break;
-	}
-	return newAxisValues;
-}
-float GameRenderer::GetManipulatedRotation(XMFLOAT3* axisValues)
-{
-	float xPercentOfWhole = m_modAmount / axisValues->x;
-	float yPercentOfWhole = m_modAmount / axisValues->y;
-	float zPercentOfWhole = m_modAmount / axisValues->z;
-	
-	switch (m_manipulationType) 
-	{
-	case 4:
-		//return XMConvertToRadians((xPercentOfWhole * 179) + (zPercentOfWhole * 179) + 2);
-		return 0.f;
-	case 5:
-		return XMConvertToRadians((xPercentOfWhole * 90) + (zPercentOfWhole * 90) + 1);
-	case 6:
-		return XMConvertToRadians(zPercentOfWhole * 360);
-	}
-	return 0.f;
-
-}
-
-int GameRenderer::GetMandlebrotOffset(int x, int y)
-{
-	//https://www.geeksforgeeks.org/fractals-in-cc/
-	//percent of whole
-	/*  left = -1.75; top = -0.25;
-		xside = 0.25; yside = 0.45; */
-	float cx = x * m_mandlebrotXScale + -1.75f;// *(0.25f / 2) + -1.75f;  // c_real           //cx = x * xscale + left;
-	float cy = y * m_mandlebrotYScale + -0.25f;// *(0.25f / 2) + -0.25f;  // c_imaginary      //cy = y * yscale + top;
-
-	float zx = 0;  // z_real 
-	float zy = 0;  // z_imaginary 
-
-	int count = -2;
-
-	// Calculate whether c(c_real + c_imaginary) belongs 
-	// to the Mandelbrot set or not and draw a pixel 
-	// at coordinates (x, y) accordingly 
-	// If you reach the Maximum number of iterations 
-	// and If the distance from the origin is 
-	// greater than 2 exit the loop 
-	for (int i = 0; i < m_halfModAmount; i++)
-	{
-		if (zx * zx + zy * zy >= 4)
-			break;
-
-		// Calculate Mandelbrot function 
-		// z = z*z + c where z is a complex number 
-		float tempx = zx * zx - zy * zy + cx; // tempx = z_real*_real - z_imaginary*z_imaginary + c_real
-
-		zy = 2 * zx * zy + cy; // 2*z_real*z_imaginary + c_imaginary 
-
-		zx = tempx;     // Updating z_real = tempx 
-		count = i;
-	}
-
-	return count;
+	m_simulation.SetDegreesPerSecond(m_degreesPerSecond);
 }
@@ -0,0 +1,369 @@
+﻿//Benchmark for the grid update, runs every manipulation mode at every grid size
+//and reports ns per cell, cells per second and heap allocations per frame.
+//
+//	GridBench [--sizes 32,64,...] [--modes 0,1,...] [--frames count] [--degrees perSecond]
+//		[--workers count] [--repeats count] [--json path] [--compare baseline.json] [--tolerance percent]
+//
+//Sizes default to 32 up to 1024 in powers of two and modes to every mode. Each
+//run has one warm up frame that is not counted, then at least MIN_FRAMES and
+//enough frames to update about FRAME_CELL_BUDGET cells unless --frames is
+//given. The per cell time is taken from the fastest frame, as a busy machine
+//only makes frames slower and the median moved by more than the tolerance
+//between two runs of the same build. The whole sweep is done --repeats times
+//over, 5 by default, and each run keeps its fastest pass, so a stretch where
+//the machine is slow lands on one pass of a run rather than all of it.
+//
+//--json writes the results, one run per line. --compare reads a file written by
+//--json and fails when a run is more than --tolerance percent slower than it was
+//(10 by default) or allocates more per frame. The runs that come out slower are
+//swept again, up to RECHECK_SWEEPS more times, and are only reported when they
+//are still slower after all of those. Checksums are only compared when
+//both runs did the same number of frames.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "GridSimulation.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const long long FRAME_CELL_BUDGET = 1 << 22;
+	const int MIN_FRAMES = 10;
+	const int RECHECK_SWEEPS = 3;
+	const int MAX_FRAMES = 200;
+
+	struct Result
+	{
+		int mode;
+		int grid;
+		int cells;
+		int frames;
+		double nsPerCell;
+		double cellsPerSecond;
+		double allocationsPerFrame;
+		unsigned long long checksum;
+	};
+
+	const uint64_t CHECKSUM_START = 14695981039346656037ull;
+
+	//folds every matrix into a single value, the same as GridSimulationDriver
+	uint64_t Checksum(const SimMath::Float4x4* models, int count, uint64_t hash = CHECKSUM_START)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(models);
+		size_t size = sizeof(SimMath::Float4x4) * count;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::vector<int> ParseList(const char* text)
+	{
+		std::vector<int> values;
+		for (const char* c = text; *c; )
+		{
+			values.push_back(atoi(c));
+			const char* comma = strchr(c, ',');
+			if (!comma)
+				break;
+			c = comma + 1;
+		}
+		return values;
+	}
+
+	Result Run(int mode, int grid, int frames, float degreesPerSecond, int workers)
+	{
+		GridSimulation simulation(grid, grid);
+		simulation.SetPlaneManipulation(mode);
+		simulation.SetWorkerCount(workers);
+
+		if (frames <= 0)
+			frames = static_cast<int>(std::min<long long>(std::max<long long>(FRAME_CELL_BUDGET / simulation.GetCellCount(), MIN_FRAMES), MAX_FRAMES));
+
+		//same fixed 60hz step the game timer uses
+		const double elapsedSeconds = 1.0 / 60;
+		double totalSeconds = 0;
+		auto radiansAt = [&]()
+		{
+			totalSeconds += elapsedSeconds;
+			return static_cast<float>(fmod(totalSeconds * SimMath::ConvertToRadians(degreesPerSecond), SimMath::TWO_PI));
+		};
+
+		//sizes everything and fills the mandlebrot field
+		simulation.Update(radiansAt());
+
+		std::vector<double> frameNs(frames);
+		unsigned long long allocations = AllocationCounter::GetCount();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			float radians = radiansAt();
+			auto start = std::chrono::steady_clock::now();
+			simulation.Update(radians);
+			frameNs[frame] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		}
+		allocations = AllocationCounter::GetCount() - allocations;
+
+		//the machine only ever adds time to a frame, so the fastest one is the closest to the real cost
+		double fastestNs = *std::min_element(frameNs.begin(), frameNs.end());
+
+		Result result;
+		result.mode = mode;
+		result.grid = grid;
+		result.cells = simulation.GetCellCount();
+		result.frames = frames;
+		result.nsPerCell = fastestNs / result.cells;
+		result.cellsPerSecond = result.nsPerCell > 0 ? 1e9 / result.nsPerCell : 0;
+		result.allocationsPerFrame = static_cast<double>(allocations) / frames;
+		result.checksum = CHECKSUM_START;
+		for (int i = 0; i < simulation.GetChunkCount(); i++)
+		{
+			const GridSimulation::Chunk& chunk = simulation.GetChunk(i);
+			result.checksum = Checksum(chunk.models.data(), chunk.transforms.GetCellCount(), result.checksum);
+		}
+		return result;
+	}
+
+	//another pass of the same run, the fastest time and the most allocations stay
+	void KeepFastest(Result& best, const Result& result)
+	{
+		if (result.nsPerCell < best.nsPerCell)
+		{
+			best.nsPerCell = result.nsPerCell;
+			best.cellsPerSecond = result.cellsPerSecond;
+		}
+		best.allocationsPerFrame = std::max(best.allocationsPerFrame, result.allocationsPerFrame);
+	}
+
+	const Result* FindRun(const std::vector<Result>& results, int mode, int grid)
+	{
+		const Result* found = nullptr;
+		for (const Result& result : results)
+		{
+			if (result.mode == mode && result.grid == grid)
+				found = &result;
+		}
+		return found;
+	}
+
+	//percent slower than the baseline, negative when faster
+	double GetChange(const Result& result, const Result& previous)
+	{
+		return previous.nsPerCell > 0 ? (result.nsPerCell / previous.nsPerCell - 1) * 100 : 0;
+	}
+
+	std::string FormatJson(const Result& result)
+	{
+		char line[256];
+		snprintf(line, sizeof(line),
+			"{\"mode\": %d, \"grid\": %d, \"cells\": %d, \"frames\": %d, \"ns_per_cell\": %.4f, "
+			"\"cells_per_sec\": %.0f, \"allocs_per_frame\": %.3f, \"checksum\": \"%016llx\"}",
+			result.mode, result.grid, result.cells, result.frames, result.nsPerCell,
+			result.cellsPerSecond, result.allocationsPerFrame, result.checksum);
+		return line;
+	}
+
+	//only has to read back what FormatJson wrote, one run per line
+	bool LoadBaseline(const char* path, std::vector<Result>& results)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+
+		char line[512];
+		while (fgets(line, sizeof(line), file))
+		{
+			const char* start = strchr(line, '{');
+			if (!start || !strstr(line, "\"mode\""))
+				continue;
+
+			Result result;
+			if (sscanf(start, "{\"mode\": %d, \"grid\": %d, \"cells\": %d, \"frames\": %d, \"ns_per_cell\": %lf, "
+				"\"cells_per_sec\": %lf, \"allocs_per_frame\": %lf, \"checksum\": \"%llx\"}",
+				&result.mode, &result.grid, &result.cells, &result.frames, &result.nsPerCell,
+				&result.cellsPerSecond, &result.allocationsPerFrame, &result.checksum) == 8)
+				results.push_back(result);
+		}
+		fclose(file);
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> sizes = { 32, 64, 128, 256, 512, 1024 };
+	//every mode GridModes has
+	std::vector<int> modes;
+	for (int mode = 0; mode < GridModes::GetModeCount(); mode++)
+		modes.push_back(mode);
+	int frames = 0;
+	//turning every frame means every cell is rebuilt, 0 would only time the dirty cells
+	float degreesPerSecond = 45;
+	int workers = 0;
+	int repeats = 5;
+	const char* jsonPath = nullptr;
+	const char* comparePath = nullptr;
+	double tolerance = 10;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--sizes") == 0)
+			sizes = ParseList(argv[i + 1]);
+		else if (strcmp(argv[i], "--modes") == 0)
+			modes = ParseList(argv[i + 1]);
+		else if (strcmp(argv[i], "--frames") == 0)
+			frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--degrees") == 0)
+			degreesPerSecond = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--workers") == 0)
+			workers = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--repeats") == 0)
+			repeats = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--json") == 0)
+			jsonPath = argv[i + 1];
+		else if (strcmp(argv[i], "--compare") == 0)
+			comparePath = argv[i + 1];
+		else if (strcmp(argv[i], "--tolerance") == 0)
+			tolerance = atof(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	for (int size : sizes)
+	{
+		if (size < 4)
+		{
+			fprintf(stderr, "grid sizes must be at least 4\n");
+			return 1;
+		}
+	}
+	for (int mode : modes)
+	{
+		if (mode < 0 || mode >= GridModes::GetModeCount())
+		{
+			fprintf(stderr, "modes go from 0 to %d\n", GridModes::GetModeCount() - 1);
+			return 1;
+		}
+	}
+	if (repeats < 1)
+	{
+		fprintf(stderr, "repeats must be at least 1\n");
+		return 1;
+	}
+
+	std::vector<Result> baseline;
+	if (comparePath && !LoadBaseline(comparePath, baseline))
+	{
+		fprintf(stderr, "could not read %s\n", comparePath);
+		return 1;
+	}
+
+	printf("%-14s %6s %7s %10s %14s %12s %s\n", "mode", "grid", "frames", "ns/cell", "cells/sec", "allocs/frame",
+		comparePath ? "against baseline" : "");
+
+	//the sweep over and over, so every pass of a run is a few seconds from the next
+	std::vector<Result> results;
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		size_t index = 0;
+		for (int mode : modes)
+		{
+			for (int size : sizes)
+			{
+				Result result = Run(mode, size, frames, degreesPerSecond, workers);
+				if (repeat == 0)
+					results.push_back(result);
+				else
+					KeepFastest(results[index], result);
+				index++;
+			}
+		}
+	}
+
+	//only the slower runs again, as a sweep of their own so they land at other times as well
+	for (int sweep = 0; comparePath && sweep < RECHECK_SWEEPS; sweep++)
+	{
+		bool rechecked = false;
+		for (Result& result : results)
+		{
+			const Result* previous = FindRun(baseline, result.mode, result.grid);
+			if (!previous || GetChange(result, *previous) <= tolerance)
+				continue;
+			for (int repeat = 0; repeat < repeats; repeat++)
+				KeepFastest(result, Run(result.mode, result.grid, frames, degreesPerSecond, workers));
+			rechecked = true;
+		}
+		if (!rechecked)
+			break;
+	}
+
+	int regressions = 0;
+	for (const Result& result : results)
+	{
+		std::string verdict;
+		if (comparePath)
+		{
+			const Result* previous = FindRun(baseline, result.mode, result.grid);
+			char text[128];
+			if (!previous)
+				verdict = "no baseline";
+			else
+			{
+				double change = GetChange(result, *previous);
+				snprintf(text, sizeof(text), "%+.1f%%", change);
+				verdict = text;
+				if (change > tolerance)
+				{
+					verdict += " SLOWER";
+					regressions++;
+				}
+				if (result.allocationsPerFrame > previous->allocationsPerFrame)
+				{
+					verdict += " MORE ALLOCATIONS";
+					regressions++;
+				}
+				if (result.frames == previous->frames && result.checksum != previous->checksum)
+				{
+					verdict += " DIFFERENT OUTPUT";
+					regressions++;
+				}
+			}
+		}
+
+		printf("%-14s %6d %7d %10.3f %14.0f %12.2f %s\n", GridModes::GetName(result.mode), result.grid, result.frames, result.nsPerCell,
+			result.cellsPerSecond, result.allocationsPerFrame, verdict.c_str());
+	}
+
+	if (jsonPath)
+	{
+		FILE* file = fopen(jsonPath, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "could not write %s\n", jsonPath);
+			return 1;
+		}
+		fprintf(file, "{\"degrees\": %g, \"workers\": %d, \"results\": [\n", degreesPerSecond, workers);
+		for (size_t i = 0; i < results.size(); i++)
+			fprintf(file, "\t%s%s\n", FormatJson(results[i]).c_str(), i + 1 < results.size() ? "," : "");
+		fprintf(file, "]}\n");
+		fclose(file);
+	}
+
+	if (comparePath)
+		printf("%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+	return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+﻿#include "GridModes.h"
+
+#include <cmath>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+const int GridModes::FIXED_SIDES[] = { 64, 128, 256, 512, 1024 };
+
+namespace
+{
+	//the grid's size, a constant when COLUMNS and ROWS aren't 0
+	template <int COLUMNS, int ROWS>
+	struct GridShape
+	{
+		int columns;
+		int rows;
+
+		int Columns() const { return COLUMNS ? COLUMNS : columns; }
+		int Rows() const { return ROWS ? ROWS : rows; }
+		int HalfColumns() const { return Columns() >> 1; }
+		int HalfRows() const { return Rows() >> 1; }
+	};
+
+	//Each mode moves a cell from its place on the grid in Move and gives it a yaw
+	//on top of the rotation in Turn, from where it ended up with the wave added.
+	//The math is the same expressions in the same order as the per cell switches
+	//were, so every mode comes out bit for bit as it did.
+	struct FlatMode
+	{
+		static const bool USES_FIELD = false;
+
+		template <class Shape>
+		static void Move(const Shape&, const GridRun&, int, Float3&) {}
+
+		template <class Shape>
+		static float Turn(const Shape&, const Float3&) { return 0.f; }
+	};
+
+	struct CosineXMode : FlatMode
+	{
+		template <class Shape>
+		static void Move(const Shape& shape, const GridRun&, int, Float3& axis)
+		{
+			float valX = shape.Columns() - axis.x;
+			axis.y -= cosf(valX);
+		}
+	};
+
+	struct CosineZMode : FlatMode
+	{
+		template <class Shape>
+		static void Move(const Shape& shape, const GridRun&, int, Float3& axis)
+		{
+			float valZ = shape.Rows() - axis.z;
+			axis.y -= cosf(valZ);
+		}
+	};
+
+	struct CosineXZMode : FlatMode
+	{
+		template <class Shape>
+		static void Move(const Shape& shape, const GridRun&, int, Float3& axis)
+		{
+			float valX = shape.Columns() - axis.x;
+			float valZ = shape.Rows() - axis.z;
+			axis.y -= cosf(valZ) + cosf(valX);
+		}
+	};
+
+	struct MandlebrotMode : FlatMode
+	{
+		static const bool USES_FIELD = true;
+
+		template <class Shape>
+		static void Move(const Shape&, const GridRun& run, int column, Float3& axis)
+		{
+			axis.y = static_cast<float>(run.field->At(column, run.gridRow));
+		}
+	};
+
+	struct GravityWellMode
+	{
+		static const bool USES_FIELD = false;
+
+		template <class Shape>
+		static void Move(const Shape& shape, const GridRun&, int, Float3& axis)
+		{
+			float valX = shape.Columns() - axis.x;
+			float valZ = shape.Rows() - axis.z;
+			//distance from the center
+			axis.x = valX - shape.HalfColumns();
+			axis.y = valZ - shape.HalfRows();
+			axis.z += (32.2 * 10) / shape.HalfColumns(); //velocity
+		}
+
+		template <class Shape>
+		static float Turn(const Shape& shape, const Float3& axis)
+		{
+			float xPercentOfWhole = shape.Columns() / axis.x;
+			float zPercentOfWhole = shape.Rows() / axis.z;
+			return ConvertToRadians((xPercentOfWhole * 90) + (zPercentOfWhole * 90) + 1);
+		}
+	};
+
+	struct SphereMode
+	{
+		static const bool USES_FIELD = false;
+
+		template <class Shape>
+		static void Move(const Shape& shape, const GridRun&, int, Float3& axis)
+		{
+			float valX = shape.Columns() - axis.x;
+			float valZ = shape.Rows() - axis.z;
+			//https://stackoverflow.com/questions/969798/plotting-a-point-on-the-edge-of-a-sphere
+			float decimalPercentX = static_cast<float>(shape.Columns()) / valX;
+			float decimalPercentZ = static_cast<float>(shape.Rows()) / valZ;
+			float xRadians = ConvertToRadians(decimalPercentX * 360);
+			float zRadians = ConvertToRadians(decimalPercentZ * 360);
+
+			//currentX + circleCenter * cos(angle)
+			axis.z = shape.HalfColumns() * cosf(xRadians) * sinf(xRadians);
+			axis.x = shape.HalfColumns() * cosf(xRadians) * sinf(zRadians);
+			axis.y = shape.HalfColumns() * cosf(zRadians);
+		}
+
+		template <class Shape>
+		static float Turn(const Shape& shape, const Float3& axis)
+		{
+			float zPercentOfWhole = shape.Rows() / axis.z;
+			return ConvertToRadians(zPercentOfWhole * 360);
+		}
+	};
+
+	template <class Mode, int COLUMNS, int ROWS>
+	void UpdateRun(const GridRun& run)
+	{
+		GridShape<COLUMNS, ROWS> shape = { run.columns, run.rows };
+		//set the value to the gridded location, offset so it is centered on screen
+		float z = static_cast<float>(run.gridRow - shape.HalfRows());
+		const WaveOffset rowWave = run.rowWave;
+
+		for (int column = run.beginColumn; column < run.endColumn; column++)
+		{
+			float x = static_cast<float>(column - shape.HalfColumns());
+
+			//translation modifiers, creates gridded formation
+			Float3 axis = Float3({ x + run.cameraOffset.x, 0 + run.cameraOffset.y, z + run.cameraOffset.z });
+			Mode::Move(shape, run, column, axis);
+
+			//row first when both land on the same step, the order the loop used to add them in
+			const WaveOffset& columnWave = run.columnWave[column];
+			if (rowWave.step <= columnWave.step)
+			{
+				axis.y += rowWave.amount;
+				axis.y += columnWave.amount;
+			}
+			else
+			{
+				axis.y += columnWave.amount;
+				axis.y += rowWave.amount;
+			}
+
+			int local = column - run.beginColumn;
+			run.x[local] = axis.x;
+			run.y[local] = axis.y;
+			run.z[local] = axis.z;
+			run.yaw[local] = run.radians + Mode::Turn(shape, axis);
+		}
+	}
+
+	struct ModeEntry
+	{
+		const char* name;
+		bool usesField;
+		GridModes::RunFunction anySize;
+		GridModes::RunFunction fixedSides[GridModes::FIXED_SIDE_COUNT];
+	};
+
+	template <class Mode>
+	constexpr ModeEntry Register(const char* name)
+	{
+		//in the order of FIXED_SIDES
+		return { name, Mode::USES_FIELD, &UpdateRun<Mode, 0, 0>,
+			{ &UpdateRun<Mode, 64, 64>, &UpdateRun<Mode, 128, 128>, &UpdateRun<Mode, 256, 256>,
+			&UpdateRun<Mode, 512, 512>, &UpdateRun<Mode, 1024, 1024> } };
+	}
+
+	//the mode number is the place in the table
+	const ModeEntry MODES[] =
+	{
+		Register<FlatMode>("flat"),
+		Register<CosineXMode>("cos x"),
+		Register<CosineZMode>("cos z"),
+		Register<CosineXZMode>("cos x+z"),
+		Register<MandlebrotMode>("mandlebrot"),
+		Register<GravityWellMode>("gravity well"),
+		Register<SphereMode>("sphere"),
+	};
+	const int MODE_COUNT = sizeof(MODES) / sizeof(MODES[0]);
+
+	const ModeEntry& GetEntry(int mode)
+	{
+		return MODES[mode >= 0 && mode < MODE_COUNT ? mode : 0];
+	}
+}
+
+int GridModes::GetModeCount()
+{
+	return MODE_COUNT;
+}
+
+const char* GridModes::GetName(int mode)
+{
+	return GetEntry(mode).name;
+}
+
+bool GridModes::UsesField(int mode)
+{
+	return GetEntry(mode).usesField;
+}
+
+GridModes::RunFunction GridModes::Select(int mode, int columns, int rows)
+{
+	const ModeEntry& entry = GetEntry(mode);
+	if (columns == rows)
+	{
+		for (int i = 0; i < FIXED_SIDE_COUNT; i++)
+		{
+			if (FIXED_SIDES[i] == columns)
+				return entry.fixedSides[i];
+		}
+	}
+	return entry.anySize;
+}
+
+GridModes::RunFunction GridModes::SelectAnySize(int mode)
+{
+	return GetEntry(mode).anySize;
+}
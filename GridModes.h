@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MandelbrotFieldCache.h"
+#include "SimMath.h"
+
+namespace DirectX11_Game
+{
+	//What the travelling wave adds to one row or column this tick. Only one step
+	//of the wave can land on a given row or column, step is which one so the
+	//row and column amounts can be added in the same order as the original loop.
+	struct WaveOffset
+	{
+		float amount;
+		int step;
+	};
+
+	//Everything a mode reads to place a run of cells on one grid row, and where
+	//they go. The outputs point at the run's first cell.
+	struct GridRun
+	{
+		int columns;
+		int rows;
+		SimMath::Float3 cameraOffset;
+		float radians;
+		//refreshed for the whole grid before the runs, for the modes that use it
+		const MandelbrotFieldCache* field;
+
+		int gridRow;
+		int beginColumn;
+		int endColumn;
+		//the row's wave, and every column's
+		WaveOffset rowWave;
+		const WaveOffset* columnWave;
+
+		float* x;
+		float* y;
+		float* z;
+		float* yaw;
+	};
+
+	//The manipulation modes, each a kernel that places a whole run of cells with
+	//the mode's math inlined into the loop, so nothing is switched on or worked
+	//out for another mode per cell. A mode is picked once per update.
+	//
+	//Every mode is also built for a few square grid sides with the size fixed at
+	//compile time, and Select hands those out when the grid is one of them. A new
+	//mode is a struct in GridModes.cpp and a line in its table, the mode number
+	//being its place there. Numbers past the end are flat, the way the switch
+	//they replace fell through to its default.
+	class GridModes
+	{
+	public:
+		typedef void (*RunFunction)(const GridRun& run);
+
+		static const int FIXED_SIDES[];
+		static const int FIXED_SIDE_COUNT = 5;
+
+		static int GetModeCount();
+		static const char* GetName(int mode);
+		//reads the mandlebrot field, which has to be refreshed before its runs
+		static bool UsesField(int mode);
+
+		static RunFunction Select(int mode, int columns, int rows);
+		//the kernel that works for any size, for comparing the fixed ones against
+		static RunFunction SelectAnySize(int mode);
+	};
+}
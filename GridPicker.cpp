@@ -0,0 +1,558 @@
+﻿#include "GridPicker.h"
+#include "FrustumCuller.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+const float GridPicker::RESORT_GROWTH = 1.5f;
+
+namespace
+{
+	//how far a planar cell can be off its lattice point, for positions worked out in a different order
+	const float LATTICE_TOLERANCE = 1e-3f;
+	const float HALF_CUBE = 0.5f;
+
+	//enough for a tree over the largest grid, each level pushes at most BRANCHES - 1 more than it pops
+	const int MAX_STACK = 256;
+
+	//row vector times matrix, divided through by w
+	Float3 TransformCoord(float x, float y, float z, const Float4x4& m)
+	{
+		float out[4];
+		for (int c = 0; c < 4; c++)
+			out[c] = x * m.m[0][c] + y * m.m[1][c] + z * m.m[2][c] + m.m[3][c];
+		return Float3({ out[0] / out[3], out[1] / out[3], out[2] / out[3] });
+	}
+
+	//Takes a world space ray into the frame a cube was moved, turned and scaled
+	//out of, the inverse of Translation * RotationY * Scaling without the
+	//translation. Points along it keep the same parameter, so distances match.
+	void ToCellFrame(const PickRay& ray, float yaw, float scale, Float3& origin, Float3& direction)
+	{
+		float sine, cosine;
+		ScalarSinCos(&sine, &cosine, yaw);
+		float inverseScale = 1.0f / scale;
+
+		float ox = ray.origin.x * inverseScale, oz = ray.origin.z * inverseScale;
+		origin = Float3({ ox * cosine - oz * sine, ray.origin.y * inverseScale, ox * sine + oz * cosine });
+		float dx = ray.direction.x * inverseScale, dz = ray.direction.z * inverseScale;
+		direction = Float3({ dx * cosine - dz * sine, ray.direction.y * inverseScale, dx * sine + dz * cosine });
+	}
+
+	//where the ray is inside the box, clamped to start at 0, false when that is empty
+	bool SlabTest(const float* origin, const float* direction, const float* minimum, const float* maximum, float& enter, float& exit)
+	{
+		enter = 0;
+		exit = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (direction[axis] == 0)
+			{
+				if (origin[axis] < minimum[axis] || origin[axis] > maximum[axis])
+					return false;
+				continue;
+			}
+			float inverse = 1.0f / direction[axis];
+			//not near and far, windows.h defines those as nothing
+			float first = (minimum[axis] - origin[axis]) * inverse;
+			float last = (maximum[axis] - origin[axis]) * inverse;
+			if (first > last)
+				std::swap(first, last);
+			enter = std::max(enter, first);
+			exit = std::min(exit, last);
+			if (enter > exit)
+				return false;
+		}
+		return true;
+	}
+
+	//the unit cube at center in a cell's own frame
+	bool TestCube(const Float3& origin, const Float3& direction, float x, float y, float z, float& distance)
+	{
+		float minimum[3] = { x - HALF_CUBE, y - HALF_CUBE, z - HALF_CUBE };
+		float maximum[3] = { x + HALF_CUBE, y + HALF_CUBE, z + HALF_CUBE };
+		float exit;
+		return SlabTest(&origin.x, &direction.x, minimum, maximum, distance, exit);
+	}
+
+	//cells along each axis of the morton grid, fine enough to keep leaves tight
+	//and coarse enough to sort in three passes of a byte
+	const int MORTON_BITS = 8;
+	const uint32_t MORTON_SIDE = 1 << MORTON_BITS;
+	const int RADIX_BITS = 8;
+	const int RADIX_SIZE = 1 << RADIX_BITS;
+
+	//puts two zero bits above each of the low 10 bits, for interleaving three axes
+	uint64_t SpreadBits(uint32_t value)
+	{
+		uint64_t bits = value & 0x3ff;
+		bits = (bits | (bits << 16)) & 0x30000ff;
+		bits = (bits | (bits << 8)) & 0x300f00f;
+		bits = (bits | (bits << 4)) & 0x30c30c3;
+		bits = (bits | (bits << 2)) & 0x9249249;
+		return bits;
+	}
+
+	struct StackEntry
+	{
+		int level;
+		int node;
+		float distance;
+	};
+}
+
+GridPicker::GridPicker() :
+	m_columns(0),
+	m_rows(0),
+	m_cellsPerChunk(0),
+	m_method(Empty),
+	m_stats(),
+	m_buildStats(),
+	m_regular(false),
+	m_originX(0),
+	m_originZ(0),
+	m_yaw(0),
+	m_scale(1),
+	m_minimumY(0),
+	m_maximumY(0),
+	m_sortedExtent(0)
+{
+}
+
+PickRay GridPicker::Unproject(const ViewProjectionConstantBuffer& constants, float x, float y, float width, float height)
+{
+	//the constants are transposed for the shader, row vectors go through view then projection
+	Float4x4 viewProjection = MatrixTranspose(constants.view) * MatrixTranspose(constants.projection);
+	Float4x4 inverse = MatrixInverse(viewProjection);
+
+	float ndcX = 2.0f * x / width - 1.0f;
+	float ndcY = 1.0f - 2.0f * y / height;
+	Float3 nearPoint = TransformCoord(ndcX, ndcY, 0.0f, inverse);
+	Float3 farPoint = TransformCoord(ndcX, ndcY, 1.0f, inverse);
+
+	PickRay ray;
+	ray.origin = nearPoint;
+	ray.direction = Normalize(Subtract(farPoint, nearPoint));
+	return ray;
+}
+
+void GridPicker::Clear(int columns, int rows)
+{
+	m_columns = columns;
+	m_rows = rows;
+	m_cellsPerChunk = 0;
+	m_chunks.clear();
+	m_method = Empty;
+	m_regular = true;
+	m_minimumY = FLT_MAX;
+	m_maximumY = -FLT_MAX;
+}
+
+void GridPicker::AddChunk(const TransformBatch::Inputs& transforms, int cellCount, int firstCell)
+{
+	if (cellCount <= 0)
+		return;
+	if (m_chunks.empty())
+		m_cellsPerChunk = cellCount;
+	m_chunks.push_back({ transforms, firstCell });
+
+	if (!m_regular)
+		return;
+
+	//the walk needs one yaw and scale and every cell on its lattice point
+	PROFILE_ZONE("GridPicker::AddChunk");
+	if (firstCell == 0)
+	{
+		m_originX = transforms.x[0];
+		m_originZ = transforms.z[0];
+		m_yaw = transforms.yaw[0];
+		m_scale = transforms.scale ? transforms.scale[0] : transforms.uniformScale;
+	}
+	for (int i = 0; i < cellCount; i++)
+	{
+		int cell = firstCell + i;
+		float expectedX = m_originX + static_cast<float>(cell % m_columns);
+		float expectedZ = m_originZ + static_cast<float>(cell / m_columns);
+		float scale = transforms.scale ? transforms.scale[i] : transforms.uniformScale;
+		if (fabsf(transforms.x[i] - expectedX) > LATTICE_TOLERANCE || fabsf(transforms.z[i] - expectedZ) > LATTICE_TOLERANCE ||
+			transforms.yaw[i] != m_yaw || scale != m_scale)
+		{
+			m_regular = false;
+			return;
+		}
+		m_minimumY = std::min(m_minimumY, transforms.y[i]);
+		m_maximumY = std::max(m_maximumY, transforms.y[i]);
+	}
+}
+
+void GridPicker::Finish()
+{
+	if (m_chunks.empty())
+		m_method = Empty;
+	else if (m_regular && m_scale > 0)
+		m_method = GridWalk;
+	else
+	{
+		BuildHierarchy();
+		m_method = Hierarchy;
+	}
+}
+
+GridPicker::Cell GridPicker::GetCell(int cell) const
+{
+	const ChunkInputs& chunk = m_chunks[cell / m_cellsPerChunk];
+	int local = cell - chunk.firstCell;
+	const TransformBatch::Inputs& transforms = chunk.transforms;
+	Cell result;
+	result.x = transforms.x[local];
+	result.y = transforms.y[local];
+	result.z = transforms.z[local];
+	result.yaw = transforms.yaw[local];
+	result.scale = transforms.scale ? transforms.scale[local] : transforms.uniformScale;
+	return result;
+}
+
+bool GridPicker::TestCell(const PickRay& ray, int cell, float& distance) const
+{
+	Cell values = GetCell(cell);
+	if (values.scale == 0)
+		return false;
+	Float3 origin, direction;
+	ToCellFrame(ray, values.yaw, values.scale, origin, direction);
+	return TestCube(origin, direction, values.x, values.y, values.z, distance);
+}
+
+bool GridPicker::Pick(const PickRay& ray, PickHit& hit) const
+{
+	PROFILE_ZONE("GridPicker::Pick");
+	m_stats = Stats();
+
+	bool found = false;
+	if (m_method == GridWalk)
+		found = WalkGrid(ray, hit);
+	else if (m_method == Hierarchy)
+		found = SearchHierarchy(ray, hit);
+
+	if (found)
+	{
+		hit.point = Float3({ ray.origin.x + ray.direction.x * hit.distance, ray.origin.y + ray.direction.y * hit.distance,
+			ray.origin.z + ray.direction.z * hit.distance });
+	}
+	return found;
+}
+
+bool GridPicker::PickBruteForce(const PickRay& ray, PickHit& hit) const
+{
+	int cellCount = m_columns * m_rows;
+	hit.cell = -1;
+	hit.distance = FLT_MAX;
+	for (int cell = 0; cell < cellCount && !m_chunks.empty(); cell++)
+	{
+		float distance;
+		if (TestCell(ray, cell, distance) && distance < hit.distance)
+		{
+			hit.cell = cell;
+			hit.distance = distance;
+		}
+	}
+	if (hit.cell < 0)
+		return false;
+	hit.point = Float3({ ray.origin.x + ray.direction.x * hit.distance, ray.origin.y + ray.direction.y * hit.distance,
+		ray.origin.z + ray.direction.z * hit.distance });
+	return true;
+}
+
+//Amanatides and Woo through the lattice in the grid's own frame. The cubes
+//fill their cells edge to edge, so the first cell the ray enters that it hits
+//is the nearest.
+bool GridPicker::WalkGrid(const PickRay& ray, PickHit& hit) const
+{
+	Float3 origin, direction;
+	ToCellFrame(ray, m_yaw, m_scale, origin, direction);
+
+	//the whole grid's box, the heights from every cube
+	float left = m_originX - HALF_CUBE;
+	float back = m_originZ - HALF_CUBE;
+	float minimum[3] = { left, m_minimumY - HALF_CUBE, back };
+	float maximum[3] = { left + m_columns, m_maximumY + HALF_CUBE, back + m_rows };
+	float enter, exit;
+	if (!SlabTest(&origin.x, &direction.x, minimum, maximum, enter, exit))
+		return false;
+
+	float startX = origin.x + direction.x * enter - left;
+	float startZ = origin.z + direction.z * enter - back;
+	int column = std::max(0, std::min(static_cast<int>(floorf(startX)), m_columns - 1));
+	int row = std::max(0, std::min(static_cast<int>(floorf(startZ)), m_rows - 1));
+
+	int stepColumn = direction.x > 0 ? 1 : -1;
+	int stepRow = direction.z > 0 ? 1 : -1;
+	float deltaX = direction.x != 0 ? fabsf(1.0f / direction.x) : FLT_MAX;
+	float deltaZ = direction.z != 0 ? fabsf(1.0f / direction.z) : FLT_MAX;
+	float nextX = direction.x != 0 ? (left + column + (stepColumn > 0 ? 1 : 0) - origin.x) / direction.x : FLT_MAX;
+	float nextZ = direction.z != 0 ? (back + row + (stepRow > 0 ? 1 : 0) - origin.z) / direction.z : FLT_MAX;
+
+	float t = enter;
+	while (t <= exit && column >= 0 && column < m_columns && row >= 0 && row < m_rows)
+	{
+		int cell = row * m_columns + column;
+		Cell values = GetCell(cell);
+		m_stats.cellsTested++;
+		float distance;
+		if (TestCube(origin, direction, values.x, values.y, values.z, distance))
+		{
+			hit.cell = cell;
+			hit.distance = distance;
+			return true;
+		}
+
+		if (nextX < nextZ)
+		{
+			t = nextX;
+			nextX += deltaX;
+			column += stepColumn;
+		}
+		else
+		{
+			t = nextZ;
+			nextZ += deltaZ;
+			row += stepRow;
+		}
+	}
+	return false;
+}
+
+//A packed tree rather than one split top down: the cells are sorted along a
+//morton curve through their centers, every LEAF_SIZE in a row make a leaf and
+//every BRANCHES nodes in a row a parent. The cell's own yaw turns it about the
+//origin, so neighbours by row and column can end up far apart, but neighbours
+//along the curve are always close.
+//
+//Between steps the whole grid turns by the same angle and the wave only moves
+//cells up and down, so cells close along last step's curve are still close.
+//Building at the same size refits the boxes over the old order and only sorts
+//again when that leaves them RESORT_GROWTH looser than the last sort did.
+void GridPicker::BuildHierarchy()
+{
+	PROFILE_ZONE("GridPicker::BuildHierarchy");
+	int cellCount = m_columns * m_rows;
+
+	//every cell's bounding sphere in one place, the leaves read them in curve order
+	m_centerX.resize(m_cellsPerChunk);
+	m_centerY.resize(m_cellsPerChunk);
+	m_centerZ.resize(m_cellsPerChunk);
+	m_spheres.resize(cellCount);
+	float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const ChunkInputs& chunk : m_chunks)
+	{
+		int count = std::min(m_cellsPerChunk, cellCount - chunk.firstCell);
+		TransformBatch::BuildCenters(chunk.transforms, count, m_centerX.data(), m_centerY.data(), m_centerZ.data());
+		for (int i = 0; i < count; i++)
+		{
+			float scale = chunk.transforms.scale ? chunk.transforms.scale[i] : chunk.transforms.uniformScale;
+			Sphere& sphere = m_spheres[chunk.firstCell + i];
+			sphere.center[0] = m_centerX[i];
+			sphere.center[1] = m_centerY[i];
+			sphere.center[2] = m_centerZ[i];
+			sphere.radius = FrustumCuller::CUBE_RADIUS * fabsf(scale);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				low[axis] = std::min(low[axis], sphere.center[axis]);
+				high[axis] = std::max(high[axis], sphere.center[axis]);
+			}
+		}
+	}
+
+	m_buildStats.refitted = static_cast<int>(m_order.size()) == cellCount && m_sortedExtent > 0 &&
+		FitLeaves() <= m_sortedExtent * RESORT_GROWTH;
+	if (m_buildStats.refitted)
+		m_buildStats.refits++;
+	else
+	{
+		SortCells(low, high);
+		m_sortedExtent = FitLeaves();
+		m_buildStats.sorts++;
+	}
+	FitParents();
+}
+
+void GridPicker::SortCells(const float* low, const float* high)
+{
+	int cellCount = m_columns * m_rows;
+
+	//MORTON_BITS an axis in the high half, the cell in the low half
+	float toGrid[3];
+	for (int axis = 0; axis < 3; axis++)
+		toGrid[axis] = high[axis] > low[axis] ? (MORTON_SIDE - 1) / (high[axis] - low[axis]) : 0;
+	m_keys.resize(cellCount);
+	for (int cell = 0; cell < cellCount; cell++)
+	{
+		const Sphere& sphere = m_spheres[cell];
+		uint32_t x = static_cast<uint32_t>((sphere.center[0] - low[0]) * toGrid[0]);
+		uint32_t y = static_cast<uint32_t>((sphere.center[1] - low[1]) * toGrid[1]);
+		uint32_t z = static_cast<uint32_t>((sphere.center[2] - low[2]) * toGrid[2]);
+		uint64_t code = SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+		m_keys[cell] = (code << 32) | static_cast<uint32_t>(cell);
+	}
+
+	//least significant digit first over the code bits, a byte a pass
+	m_sortScratch.resize(cellCount);
+	for (int shift = 32; shift < 32 + MORTON_BITS * 3; shift += RADIX_BITS)
+	{
+		uint32_t counts[RADIX_SIZE + 1] = {};
+		for (uint64_t key : m_keys)
+			counts[((key >> shift) & (RADIX_SIZE - 1)) + 1]++;
+		for (int digit = 0; digit < RADIX_SIZE; digit++)
+			counts[digit + 1] += counts[digit];
+		for (uint64_t key : m_keys)
+			m_sortScratch[counts[(key >> shift) & (RADIX_SIZE - 1)]++] = key;
+		m_keys.swap(m_sortScratch);
+	}
+
+	m_order.resize(cellCount);
+	for (int i = 0; i < cellCount; i++)
+		m_order[i] = static_cast<int>(m_keys[i] & 0xffffffffu);
+}
+
+double GridPicker::FitLeaves()
+{
+	int cellCount = m_columns * m_rows;
+	int nodeCount = (cellCount + LEAF_SIZE - 1) / LEAF_SIZE;
+
+	//a level for every BRANCHES times fewer nodes, resized in place so the boxes keep their storage
+	int levelCount = 1;
+	for (int count = nodeCount; count > 1; count = (count + BRANCHES - 1) / BRANCHES)
+		levelCount++;
+	m_levels.resize(levelCount);
+
+	double extent = 0;
+	std::vector<Box>& leaves = m_levels[0];
+	leaves.resize(nodeCount);
+	for (int leaf = 0; leaf < nodeCount; leaf++)
+	{
+		Box& box = leaves[leaf];
+		box.minimum[0] = box.minimum[1] = box.minimum[2] = FLT_MAX;
+		box.maximum[0] = box.maximum[1] = box.maximum[2] = -FLT_MAX;
+		int end = std::min((leaf + 1) * LEAF_SIZE, cellCount);
+		for (int i = leaf * LEAF_SIZE; i < end; i++)
+		{
+			const Sphere& sphere = m_spheres[m_order[i]];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				box.minimum[axis] = std::min(box.minimum[axis], sphere.center[axis] - sphere.radius);
+				box.maximum[axis] = std::max(box.maximum[axis], sphere.center[axis] + sphere.radius);
+			}
+		}
+		extent += (box.maximum[0] - box.minimum[0]) + (box.maximum[1] - box.minimum[1]) + (box.maximum[2] - box.minimum[2]);
+	}
+	return extent;
+}
+
+//each level up takes BRANCHES of the one below, until there is one box
+void GridPicker::FitParents()
+{
+	for (size_t level = 1; level < m_levels.size(); level++)
+	{
+		const std::vector<Box>& children = m_levels[level - 1];
+		std::vector<Box>& parents = m_levels[level];
+		int childCount = static_cast<int>(children.size());
+		int nodeCount = (childCount + BRANCHES - 1) / BRANCHES;
+		parents.resize(nodeCount);
+		for (int node = 0; node < nodeCount; node++)
+		{
+			Box& parent = parents[node];
+			parent = children[node * BRANCHES];
+			int end = std::min((node + 1) * BRANCHES, childCount);
+			for (int child = node * BRANCHES + 1; child < end; child++)
+			{
+				const Box& box = children[child];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					parent.minimum[axis] = std::min(parent.minimum[axis], box.minimum[axis]);
+					parent.maximum[axis] = std::max(parent.maximum[axis], box.maximum[axis]);
+				}
+			}
+		}
+	}
+}
+
+bool GridPicker::SearchHierarchy(const PickRay& ray, PickHit& hit) const
+{
+	float best = FLT_MAX;
+	hit.cell = -1;
+
+	StackEntry stack[MAX_STACK];
+	int stackSize = 0;
+
+	int top = static_cast<int>(m_levels.size()) - 1;
+	float enter, exit;
+	if (!SlabTest(&ray.origin.x, &ray.direction.x, m_levels[top][0].minimum, m_levels[top][0].maximum, enter, exit))
+		return false;
+	stack[stackSize++] = { top, 0, enter };
+
+	int cellCount = m_columns * m_rows;
+	while (stackSize > 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		if (entry.distance > best)
+			continue;
+		m_stats.nodesVisited++;
+
+		if (entry.level == 0)
+		{
+			int end = std::min((entry.node + 1) * LEAF_SIZE, cellCount);
+			for (int i = entry.node * LEAF_SIZE; i < end; i++)
+			{
+				int cell = m_order[i];
+				m_stats.cellsTested++;
+				float distance;
+				if (TestCell(ray, cell, distance) && (distance < best || (distance == best && cell < hit.cell)))
+				{
+					best = distance;
+					hit.cell = cell;
+				}
+			}
+			continue;
+		}
+
+		//the children the ray reaches before the best hit, pushed farthest first so the nearest is searched first
+		int level = entry.level - 1;
+		const std::vector<Box>& children = m_levels[level];
+		int childEnd = std::min((entry.node + 1) * BRANCHES, static_cast<int>(children.size()));
+		StackEntry reached[BRANCHES];
+		int reachedCount = 0;
+		for (int child = entry.node * BRANCHES; child < childEnd; child++)
+		{
+			const Box& box = children[child];
+			if (!SlabTest(&ray.origin.x, &ray.direction.x, box.minimum, box.maximum, enter, exit) || enter > best)
+				continue;
+
+			//at most BRANCHES of them, inserted in place rather than sorted after
+			int slot = reachedCount++;
+			for (; slot > 0 && reached[slot - 1].distance < enter; slot--)
+				reached[slot] = reached[slot - 1];
+			reached[slot] = { level, child, enter };
+		}
+		for (int i = 0; i < reachedCount && stackSize < MAX_STACK; i++)
+			stack[stackSize++] = reached[i];
+	}
+
+	if (hit.cell < 0)
+		return false;
+	hit.distance = best;
+	return true;
+}
+
+size_t GridPicker::GetMemoryBytes() const
+{
+	size_t bytes = m_chunks.capacity() * sizeof(ChunkInputs);
+	bytes += (m_centerX.capacity() + m_centerY.capacity() + m_centerZ.capacity()) * sizeof(float) + m_spheres.capacity() * sizeof(Sphere);
+	bytes += (m_keys.capacity() + m_sortScratch.capacity()) * sizeof(uint64_t) + m_order.capacity() * sizeof(int);
+	for (const std::vector<Box>& level : m_levels)
+		bytes += level.capacity() * sizeof(Box);
+	return bytes;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ShaderConstants.h"
+#include "TransformBatch.h"
+
+namespace DirectX11_Game
+{
+	//a world space ray, the direction normalised
+	struct PickRay
+	{
+		SimMath::Float3 origin;
+		SimMath::Float3 direction;
+	};
+
+	struct PickHit
+	{
+		int cell;
+		//along the ray from its origin, in world units
+		float distance;
+		SimMath::Float3 point;
+	};
+
+	//Finds the first cube a ray hits on a grid stored in chunks of whole rows,
+	//the way the simulation lays it out. Every cube is the unit mesh moved to its
+	//cell's position, turned by its yaw about the world origin and scaled, so
+	//each cell is tested exactly as a box in its own frame.
+	//
+	//When every cell shares one yaw and scale and sits on the row and column
+	//lattice, the planar modes, the ray is taken into the grid's frame once and
+	//walked through the cells it crosses in order, stopping at the first hit.
+	//Otherwise the cells' bounding spheres go into a bounding volume tree,
+	//packed bottom up along a morton curve so it builds with a radix sort and
+	//no splitting, and searched nearest box first. Building again at the same
+	//size keeps the order and refits the boxes, only sorting again once they
+	//have grown too loose.
+	class GridPicker
+	{
+	public:
+		//cells in a leaf and children of every other node
+		static const int LEAF_SIZE = 16;
+		static const int BRANCHES = 4;
+		//how much bigger refitted leaves can get than when the cells were last sorted
+		static const float RESORT_GROWTH;
+
+		enum Method
+		{
+			Empty,
+			GridWalk,
+			Hierarchy
+		};
+
+		struct Stats
+		{
+			int cellsTested;
+			int nodesVisited;
+		};
+
+		struct BuildStats
+		{
+			//refitted the boxes in the order the cells were sorted in last time
+			bool refitted;
+			int sorts;
+			int refits;
+		};
+
+		GridPicker();
+
+		//A point on the output in pixels from the top left, through the
+		//constants the camera uploads. The ray starts on the near plane.
+		static PickRay Unproject(const ViewProjectionConstantBuffer& constants, float x, float y, float width, float height);
+
+		//Clear, then AddChunk for every chunk in order, then Finish. The inputs
+		//are read from until the next Clear, so they have to stay valid until then.
+		void Clear(int columns, int rows);
+		void AddChunk(const TransformBatch::Inputs& transforms, int cellCount, int firstCell);
+		void Finish();
+
+		//only reads what Finish built, so one thread can pick while another builds a different picker
+		bool Pick(const PickRay& ray, PickHit& hit) const;
+		//every cell, for checking Pick against
+		bool PickBruteForce(const PickRay& ray, PickHit& hit) const;
+
+		Method GetMethod() const { return m_method; }
+		//from the last Pick
+		const Stats& GetStats() const { return m_stats; }
+		//the last Finish, and how many times it has sorted and refitted
+		const BuildStats& GetBuildStats() const { return m_buildStats; }
+		size_t GetMemoryBytes() const;
+
+	private:
+		struct Box
+		{
+			float minimum[3];
+			float maximum[3];
+		};
+
+		//where a chunk's inputs are and the first cell they hold
+		struct ChunkInputs
+		{
+			TransformBatch::Inputs transforms;
+			int firstCell;
+		};
+
+		struct Sphere
+		{
+			float center[3];
+			float radius;
+		};
+
+		struct Cell
+		{
+			float x;
+			float y;
+			float z;
+			float yaw;
+			float scale;
+		};
+
+		Cell GetCell(int cell) const;
+		//distance to the cube along the ray, false when it misses or is behind
+		bool TestCell(const PickRay& ray, int cell, float& distance) const;
+
+		bool WalkGrid(const PickRay& ray, PickHit& hit) const;
+		bool SearchHierarchy(const PickRay& ray, PickHit& hit) const;
+		void BuildHierarchy();
+		void SortCells(const float* low, const float* high);
+		//the leaf boxes over the cells in m_order, returns the sum of their sides
+		double FitLeaves();
+		void FitParents();
+
+		int m_columns;
+		int m_rows;
+		int m_cellsPerChunk;
+		std::vector<ChunkInputs> m_chunks;
+		Method m_method;
+		//written by Pick, which is const for the tree rather than for the counts
+		mutable Stats m_stats;
+		BuildStats m_buildStats;
+
+		//the planar layout, cell 0's position and the height range of every cube
+		bool m_regular;
+		float m_originX;
+		float m_originZ;
+		float m_yaw;
+		float m_scale;
+		float m_minimumY;
+		float m_maximumY;
+
+		//the tree, level 0 the leaves over m_order, node n's children are n * BRANCHES on
+		std::vector<std::vector<Box>> m_levels;
+		std::vector<int> m_order;
+		//FitLeaves when the cells were last sorted, what a refit is held to
+		double m_sortedExtent;
+		std::vector<uint64_t> m_keys;
+		std::vector<uint64_t> m_sortScratch;
+		std::vector<Sphere> m_spheres;
+		//one chunk's centers at a time
+		std::vector<float> m_centerX;
+		std::vector<float> m_centerY;
+		std::vector<float> m_centerZ;
+	};
+}
@@ -0,0 +1,381 @@
+﻿#include "GridSimulation.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+GridSimulation::GridSimulation(int columns, int rows) :
+	m_manipulationType(0),
+	m_runFunction(nullptr),
+	m_radians(0),
+	m_additionalScaling(0.1f),
+	m_buildModels(true),
+	m_wavePaused(false),
+	m_cameraOffset({ 0, 0, 0 }),
+	m_lastManipulationType(0),
+	m_lastRadians(0),
+	m_lastScaling(0),
+	m_lastCameraOffset({ 0, 0, 0 })
+{
+	Resize(columns, rows);
+}
+
+void GridSimulation::Resize(int columns, int rows)
+{
+	m_modAmount = columns > 1 ? columns : 1;
+	m_rowCount = rows > 1 ? rows : 1;
+	m_cellCount = m_modAmount * m_rowCount;
+	m_halfModAmount = m_modAmount >> 1;
+	m_halfRowCount = m_rowCount >> 1;
+	m_waveLimit = std::max(m_modAmount, m_rowCount);
+	m_waveIncremental = 0;
+	m_mandlebrotXScale = 0.45f / std::max(m_modAmount >> 2, 1);
+	m_mandlebrotYScale = 0.25f / std::max(m_rowCount >> 2, 1);
+
+	m_mandlebrotColumnX.assign(m_modAmount, 0);
+	m_mandlebrotRowY.assign(m_rowCount, 0);
+	m_rowWave.assign(m_rowCount, WaveOffset());
+	m_columnWave.assign(m_modAmount, WaveOffset());
+	m_lastRowWave.assign(m_rowCount, WaveOffset());
+	m_lastColumnWave.assign(m_modAmount, WaveOffset());
+	m_rowDirty.assign(m_rowCount, 0);
+	m_dirtyColumnRuns.clear();
+	m_dirtyColumnRuns.reserve(m_modAmount / 2 + 1);
+	m_dirtyRanges.clear();
+	m_dirtyRanges.reserve(GetDirtyRangeLimit(m_rowCount));
+	m_dirtyCellCount = 0;
+
+	m_rowsPerChunk = (CHUNK_CELLS / m_modAmount) / CHUNK_ROW_MULTIPLE * CHUNK_ROW_MULTIPLE;
+	if (m_rowsPerChunk < CHUNK_ROW_MULTIPLE)
+		m_rowsPerChunk = CHUNK_ROW_MULTIPLE;
+
+	//the old chunks go first, so a grid being replaced by a bigger one isn't held twice
+	std::vector<Chunk>().swap(m_chunks);
+	for (int firstRow = 0; firstRow < m_rowCount; firstRow += m_rowsPerChunk)
+	{
+		Chunk chunk;
+		chunk.firstRow = firstRow;
+		chunk.rowCount = std::min(m_rowsPerChunk, m_rowCount - firstRow);
+		chunk.transforms.Resize(firstRow * m_modAmount, chunk.rowCount * m_modAmount);
+		if (m_buildModels)
+			chunk.models.assign(chunk.transforms.GetCellCount(), MatrixIdentity());
+		m_chunks.push_back(std::move(chunk));
+	}
+
+	m_invalid = true;
+}
+
+void GridSimulation::SetBuildModels(bool buildModels)
+{
+	//the matrices were not kept up to date while they were off, and aren't kept at all
+	if (buildModels && !m_buildModels)
+	{
+		m_invalid = true;
+		for (Chunk& chunk : m_chunks)
+			chunk.models.assign(chunk.transforms.GetCellCount(), MatrixIdentity());
+	}
+	else if (!buildModels)
+	{
+		for (Chunk& chunk : m_chunks)
+			std::vector<Float4x4>().swap(chunk.models);
+	}
+	m_buildModels = buildModels;
+}
+
+TransformBatch::Inputs GridSimulation::GetChunkInputs(int chunk) const
+{
+	return m_chunks[chunk].transforms.GetInputs(m_additionalScaling);
+}
+
+size_t GridSimulation::GetChunkMemory(int chunk) const
+{
+	const Chunk& stored = m_chunks[chunk];
+	return stored.transforms.GetMemoryBytes() + stored.models.capacity() * sizeof(Float4x4);
+}
+
+size_t GridSimulation::GetSharedMemory() const
+{
+	return (m_mandlebrotColumnX.capacity() + m_mandlebrotRowY.capacity()) * sizeof(int) +
+		(m_rowWave.capacity() + m_columnWave.capacity() + m_lastRowWave.capacity() + m_lastColumnWave.capacity()) * sizeof(WaveOffset) +
+		m_rowDirty.capacity() + (m_dirtyColumnRuns.capacity() + m_dirtyRanges.capacity()) * sizeof(CellRange) +
+		m_chunks.capacity() * sizeof(Chunk) + m_mandlebrotCache.GetMemoryBytes();
+}
+
+void GridSimulation::Update(float radians)
+{
+	PROFILE_ZONE("GridSimulation::Update");
+	//the same grid, mode, camera and scale as last time, so everything it needs is already there
+	bool steady = !m_invalid && m_manipulationType == m_lastManipulationType &&
+		memcmp(&m_additionalScaling, &m_lastScaling, sizeof(float)) == 0 &&
+		memcmp(&m_cameraOffset, &m_lastCameraOffset, sizeof(Float3)) == 0;
+	NoAllocationScope noAllocations("GridSimulation::Update", steady);
+
+	m_radians = radians;
+	m_fullRebuild = m_invalid || HasGlobalChange();
+	m_invalid = false;
+	m_lastManipulationType = m_manipulationType;
+	m_lastRadians = m_radians;
+	m_lastScaling = m_additionalScaling;
+	m_lastCameraOffset = m_cameraOffset;
+
+	//once for the whole grid rather than per cell
+	m_runFunction = GridModes::Select(m_manipulationType, m_modAmount, m_rowCount);
+
+	//the field only moves with the camera, so it can not dirty anything on its own
+	if (GridModes::UsesField(m_manipulationType))
+		UpdateMandlebrotField();
+
+	m_lastRowWave.swap(m_rowWave);
+	m_lastColumnWave.swap(m_columnWave);
+	UpdateWaveTables();
+	if (!m_fullRebuild)
+		FindDirtyRowsAndColumns();
+
+	//every cell only reads the shared state, so rows can be handed out in any order
+	//and the result is the same as doing them one after another
+	int participants = m_workerPool.GetWorkerCount() + 1;
+	int rowsPerBlock = m_rowCount / (participants * 8);
+	if (rowsPerBlock < 1)
+		rowsPerBlock = 1;
+
+	auto rowTask = [this](int beginRow, int endRow) { UpdateRows(beginRow, endRow); };
+	m_workerPool.ParallelFor(m_rowCount, rowsPerBlock, rowTask);
+	{
+		PROFILE_ZONE("GridSimulation::CollectDirtyRanges");
+		CollectDirtyRanges();
+	}
+
+	//paused the wave tables come out the same next tick, so the wave dirties nothing
+	if (m_wavePaused)
+		return;
+	m_waveIncremental += 1;
+	if (m_waveIncremental > m_waveLimit)
+		m_waveIncremental = -(m_waveLimit >> 1);
+}
+
+//profiled per block of rows, a zone per cell would cost more than the cell
+void GridSimulation::UpdateRows(int beginRow, int endRow)
+{
+	PROFILE_ZONE("GridSimulation::UpdateRows");
+	for (int j = beginRow; j < endRow; j++)
+	{
+		if (m_fullRebuild || m_rowDirty[j])
+		{
+			UpdateCells(j, 0, m_modAmount);
+			continue;
+		}
+
+		for (const CellRange& columns : m_dirtyColumnRuns)
+			UpdateCells(j, columns.begin, columns.end);
+	}
+}
+
+void GridSimulation::UpdateCells(int gridRow, int beginColumn, int endColumn)
+{
+	Chunk& chunk = m_chunks[gridRow / m_rowsPerChunk];
+	int rowStart = gridRow * m_modAmount;
+	int first = rowStart + beginColumn - chunk.transforms.firstCell;
+
+	GridRun run;
+	run.columns = m_modAmount;
+	run.rows = m_rowCount;
+	run.cameraOffset = m_cameraOffset;
+	run.radians = m_radians;
+	run.field = &m_mandlebrotCache;
+	run.gridRow = gridRow;
+	run.beginColumn = beginColumn;
+	run.endColumn = endColumn;
+	run.rowWave = m_rowWave[gridRow];
+	run.columnWave = m_columnWave.data();
+	run.x = chunk.transforms.x.data() + first;
+	run.y = chunk.transforms.y.data() + first;
+	run.z = chunk.transforms.z.data() + first;
+	run.yaw = chunk.transforms.yaw.data() + first;
+	m_runFunction(run);
+
+	//expand the whole run at once rather than a matrix multiply per cell
+	if (m_buildModels)
+	{
+		TransformBatch::Inputs inputs = chunk.transforms.GetInputs(m_additionalScaling);
+		inputs.x += first;
+		inputs.y += first;
+		inputs.z += first;
+		inputs.yaw += first;
+		TransformBatch::Build(inputs, endColumn - beginColumn, &chunk.models[first]);
+	}
+}
+
+bool GridSimulation::HasGlobalChange() const
+{
+	//bitwise so a -0 turning into +0 still counts
+	return m_manipulationType != m_lastManipulationType ||
+		memcmp(&m_radians, &m_lastRadians, sizeof(float)) != 0 ||
+		memcmp(&m_additionalScaling, &m_lastScaling, sizeof(float)) != 0 ||
+		memcmp(&m_cameraOffset, &m_lastCameraOffset, sizeof(Float3)) != 0;
+}
+
+bool GridSimulation::SameWave(const WaveOffset& a, const WaveOffset& b)
+{
+	//the step decides the order the amounts are added in, so it matters as well
+	return a.step == b.step && memcmp(&a.amount, &b.amount, sizeof(float)) == 0;
+}
+
+void GridSimulation::FindDirtyRowsAndColumns()
+{
+	for (int r = 0; r < m_rowCount; r++)
+		m_rowDirty[r] = !SameWave(m_rowWave[r], m_lastRowWave[r]);
+
+	m_dirtyColumnRuns.clear();
+	for (int c = 0; c < m_modAmount; c++)
+	{
+		if (SameWave(m_columnWave[c], m_lastColumnWave[c]))
+			continue;
+
+		if (!m_dirtyColumnRuns.empty() && m_dirtyColumnRuns.back().end == c)
+			m_dirtyColumnRuns.back().end = c + 1;
+		else
+			m_dirtyColumnRuns.push_back({ c, c + 1 });
+	}
+}
+
+void GridSimulation::CollectDirtyRanges()
+{
+	m_dirtyRanges.clear();
+	m_dirtyCellCount = 0;
+
+	auto addRange = [this](int begin, int end)
+	{
+		m_dirtyCellCount += end - begin;
+		if (!m_dirtyRanges.empty() && m_dirtyRanges.back().end == begin)
+			m_dirtyRanges.back().end = end;
+		else
+			m_dirtyRanges.push_back({ begin, end });
+	};
+
+	if (m_fullRebuild)
+	{
+		addRange(0, m_cellCount);
+		return;
+	}
+
+	for (int j = 0; j < m_rowCount; j++)
+	{
+		int rowStart = j * m_modAmount;
+		if (m_rowDirty[j])
+		{
+			addRange(rowStart, rowStart + m_modAmount);
+			continue;
+		}
+
+		for (const CellRange& columns : m_dirtyColumnRuns)
+			addRange(rowStart + columns.begin, rowStart + columns.end);
+	}
+}
+
+//The wave only depends on the row and the column, so rather than every cell
+//walking the 10 steps of the wave it is worked out once per row and column.
+void GridSimulation::UpdateWaveTables()
+{
+	PROFILE_ZONE("GridSimulation::UpdateWaveTables");
+	//-0 leaves every value as it is when added, including -0 itself
+	const WaveOffset noWave = { -0.0f, INT_MAX };
+
+	for (int r = 0; r < m_rowCount; r++)
+	{
+		float z = static_cast<float>(r - m_halfRowCount);
+		WaveOffset wave = noWave;
+		//10 is the upper limit to how far back the wave travels
+		for (int j = 0; j < 10; j++)
+		{
+			//maximum wave size is 10, step of 0.2
+			float diff = 2 - (j * 0.2f);
+			if (z + j == m_waveIncremental)
+				wave = { diff / 2, j };
+			else if (z - j == m_waveIncremental)
+				wave = { diff / 4, j };
+			else
+				continue;
+			break;
+		}
+		m_rowWave[r] = wave;
+	}
+
+	for (int c = 0; c < m_modAmount; c++)
+	{
+		float x = static_cast<float>(c - m_halfModAmount);
+		WaveOffset wave = noWave;
+		for (int j = 0; j < 10; j++)
+		{
+			float diff = 2 - (j * 0.2f);
+			if (x + j == m_waveIncremental)
+				wave = { diff, j };
+			else if (x - j == m_waveIncremental)
+				wave = { diff / 2, j };
+			else
+				continue;
+			break;
+		}
+		m_columnWave[c] = wave;
+	}
+}
+
+//Works out the mandlebrot offsets for each column and row and lets the cache
+//decide how much of the field actually needs computing this tick.
+void GridSimulation::UpdateMandlebrotField()
+{
+	PROFILE_ZONE("GridSimulation::UpdateMandlebrotField");
+	for (int column = 0; column < m_modAmount; column++)
+	{
+		float x = static_cast<float>(column - m_halfModAmount);
+		float valX = m_modAmount - (x + m_cameraOffset.x);
+		//the offsets are truncated to whole cells, the same as the renderer always did
+		m_mandlebrotColumnX[column] = static_cast<int>(valX + (m_cameraOffset.y / 2));
+	}
+
+	for (int row = 0; row < m_rowCount; row++)
+	{
+		float z = static_cast<float>(row - m_halfRowCount);
+		float valZ = m_rowCount - (z + m_cameraOffset.z);
+		m_mandlebrotRowY[row] = static_cast<int>(valZ + (m_cameraOffset.y / 2));
+	}
+
+	MandelbrotFieldCache::Key key;
+	key.cameraOffset = m_cameraOffset;
+	key.xScale = m_mandlebrotXScale;
+	key.yScale = m_mandlebrotYScale;
+	key.maxIterations = m_halfModAmount;
+	key.columns = m_modAmount;
+	key.rows = m_rowCount;
+	m_mandlebrotCache.Refresh(key, m_mandlebrotColumnX.data(), m_mandlebrotRowY.data());
+}
+
+void GridSimulation::ModifyCameraPosition(float amount, int direction)
+{
+	switch (direction)
+	{
+	case 0:
+		m_cameraOffset.x += amount;
+		break;
+	case 1:
+		m_cameraOffset.y += amount;
+		break;
+	case 2:
+		m_cameraOffset.z += amount;
+		break;
+	}
+}
+
+void GridSimulation::UpdatePerspective(float amount)
+{
+	m_additionalScaling += amount;
+
+	if (m_additionalScaling <= 0)
+	{
+		m_additionalScaling = 0.02f;
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+
+#include "GridModes.h"
+#include "MandelbrotFieldCache.h"
+#include "SimMath.h"
+#include "TransformBatch.h"
+#include "WorkerPool.h"
+
+namespace DirectX11_Game
+{
+	//Per-cube math for the grid, pulled out of GameRenderer so it has no
+	//dependency on the device or the UWP types. The renderer feeds it input and
+	//reads back one transposed model matrix per cell each frame.
+	//
+	//Cells are numbered a row at a time, columns wide. The per cell storage is
+	//split into chunks of whole rows, about CHUNK_CELLS each, so a grid of
+	//millions of cells never needs one huge allocation and can be drawn a chunk
+	//at a time.
+	class GridSimulation
+	{
+	public:
+		static const int CHUNK_CELLS = 1 << 16;
+		//chunks are a multiple of this many rows, so the culler's blocks never straddle two
+		static const int CHUNK_ROW_MULTIPLE = 16;
+
+		struct Chunk
+		{
+			int firstRow;
+			int rowCount;
+			TransformChunk transforms;
+			//transposed model matrix for every cell in the chunk, empty while the models aren't built
+			std::vector<SimMath::Float4x4> models;
+		};
+
+		GridSimulation(int columns, int rows);
+
+		//starts over with a grid of this size, keeping the mode, camera, scale and workers
+		void Resize(int columns, int rows);
+
+		// Called once per frame, moves the wave and calculates the model matrices.
+		void Update(float radians);
+
+		void ModifyCameraPosition(float amount, int direction);
+		void UpdatePerspective(float amount);
+		//one of GridModes
+		void SetPlaneManipulation(int manipulationType) { m_manipulationType = manipulationType; }
+		//holds the travelling wave where it is, with no rotation either the grid stops changing
+		void SetWavePaused(bool paused) { m_wavePaused = paused; }
+		bool IsWavePaused() const { return m_wavePaused; }
+
+		//threads helping with Update besides the caller, the output is the same for any count
+		void SetWorkerCount(int workerCount) { m_workerPool.SetWorkerCount(workerCount); }
+		int GetWorkerCount() const { return m_workerPool.GetWorkerCount(); }
+
+		int GetCellCount() const { return m_cellCount; }
+		//the number of columns
+		int GetModAmount() const { return m_modAmount; }
+		int GetRowCount() const { return m_rowCount; }
+		int GetManipulationType() const { return m_manipulationType; }
+		float GetAdditionalScaling() const { return m_additionalScaling; }
+		const SimMath::Float3& GetCameraOffset() const { return m_cameraOffset; }
+
+		int GetChunkCount() const { return static_cast<int>(m_chunks.size()); }
+		const Chunk& GetChunk(int chunk) const { return m_chunks[chunk]; }
+		int GetRowsPerChunk() const { return m_rowsPerChunk; }
+
+		//a chunk's transforms before they are expanded, position and yaw per cell
+		//with one scale for the whole grid
+		TransformBatch::Inputs GetChunkInputs(int chunk) const;
+
+		//bytes held for one chunk, and for the tables and caches shared by the whole grid
+		size_t GetChunkMemory(int chunk) const;
+		size_t GetSharedMemory() const;
+
+		//when off Update only fills the transform inputs, for callers that expand
+		//them later themselves (the compact instance stream)
+		void SetBuildModels(bool buildModels);
+		bool GetBuildModels() const { return m_buildModels; }
+
+		//The cells whose transform changed in the last Update, sorted and merged.
+		//Only the wave moving is tracked cell by cell, a change to the camera,
+		//scale, mode or rotation recomputes the whole grid.
+		const std::vector<CellRange>& GetDirtyRanges() const { return m_dirtyRanges; }
+		int GetDirtyCellCount() const { return m_dirtyCellCount; }
+		//the most dirty ranges a grid with this many rows can have, for reserving
+		//room up front. The wave crosses one band of columns, split in two where
+		//it wraps, so a row adds at most two.
+		static int GetDirtyRangeLimit(int rows) { return 2 * rows + 1; }
+		bool WasFullRebuild() const { return m_fullRebuild; }
+
+		//makes the next Update recompute every cell
+		void Invalidate() { m_invalid = true; }
+
+		//hit and miss counters for the mandlebrot height mode
+		const MandelbrotFieldCache& GetMandlebrotCache() const { return m_mandlebrotCache; }
+
+	private:
+		void UpdateRows(int beginRow, int endRow);
+		void UpdateCells(int gridRow, int beginColumn, int endColumn);
+		bool HasGlobalChange() const;
+		void FindDirtyRowsAndColumns();
+		void CollectDirtyRanges();
+		void UpdateMandlebrotField();
+		void UpdateWaveTables();
+
+		static bool SameWave(const WaveOffset& a, const WaveOffset& b);
+
+		int m_cellCount;
+		int m_modAmount;
+		int m_rowCount;
+		int m_halfModAmount;
+		int m_halfRowCount;
+		//the wave runs across whichever side is longer
+		int m_waveLimit;
+		int m_manipulationType;
+		//the mode's kernel for this grid, picked at the start of every Update
+		GridModes::RunFunction m_runFunction;
+		int m_waveIncremental;
+		float m_radians;
+		float m_additionalScaling;
+		float m_mandlebrotXScale;
+		float m_mandlebrotYScale;
+		bool m_buildModels;
+		bool m_wavePaused;
+		SimMath::Float3 m_cameraOffset;
+
+		//escape counts for the whole grid, refreshed before the per cell loop
+		MandelbrotFieldCache m_mandlebrotCache;
+		std::vector<int> m_mandlebrotColumnX;
+		std::vector<int> m_mandlebrotRowY;
+
+		//wave offsets indexed by grid row and column, rebuilt once per tick
+		std::vector<WaveOffset> m_rowWave;
+		std::vector<WaveOffset> m_columnWave;
+
+		//what the last Update was worked out from, compared bit for bit
+		bool m_invalid;
+		bool m_fullRebuild;
+		int m_lastManipulationType;
+		float m_lastRadians;
+		float m_lastScaling;
+		SimMath::Float3 m_lastCameraOffset;
+		std::vector<WaveOffset> m_lastRowWave;
+		std::vector<WaveOffset> m_lastColumnWave;
+
+		//rows where every cell changed, and runs of columns where every cell changed
+		std::vector<unsigned char> m_rowDirty;
+		std::vector<CellRange> m_dirtyColumnRuns;
+		std::vector<CellRange> m_dirtyRanges;
+		int m_dirtyCellCount;
+
+		//per cell transform inputs written by ExecutePerRow, and the models expanded from them a run at a time
+		std::vector<Chunk> m_chunks;
+		int m_rowsPerChunk;
+
+		WorkerPool m_workerPool;
+	};
+}
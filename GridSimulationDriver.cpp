@@ -0,0 +1,619 @@
+﻿//Headless driver for the grid simulation, runs a number of frames at a given
+//grid size without a window or device and reports how long a frame took.
+//
+//	GridSimulationDriver [--grid side] [--columns count] [--rows count] [--frames count] [--mode type]
+//		[--degrees perSecond] [--workers count] [--draw instanced|compact|cube] [--cull on] [--zoom amount]
+//		[--resident on] [--metrics on] [--trace path] [--threaded on] [--interpolate on] [--memory on]
+//		[--wave off] [--bake on] [--input perStep] [--record path]
+//
+//--grid sets both sides, --columns and --rows set one each for a grid that
+//isn't square. --memory lists the bytes held by each chunk of the grid.
+//
+//--draw also packs and submits every frame to a recording backend, one batch
+//and instance buffer per chunk the way the renderer does, and reports the draw calls and bytes the renderer would have sent to the device. With
+//compact the simulation skips the matrices and the checksum is taken from the
+//compact instances expanded on the cpu, so it should match the other modes.
+//
+//--cull tests the grid against the default camera at 1280x720 and only packs
+//what it can see, --zoom is added to the scale the way the zoom keys do.
+//--resident keeps the instanced or compact stream in the instance buffer and
+//only uploads the cells the simulation reports as changed. --metrics dumps the
+//same registry the overlay reads at the end of the run. --trace writes the
+//profiler zones as chrome trace json to path and prints the per zone summary.
+//
+//--threaded steps the simulation on its own thread and reads the frames back
+//through the triple buffer the way the renderer does, expanding every frame it
+//gets. It runs as fast as it can and the checksum matches the other modes.
+//--interpolate paces the thread at 60hz instead and expands a blended frame on
+//every pass, to show how many frames are drawn per step. --input runs an input
+//thread as well that queues perStep camera moves every 60th of a second, back
+//and forth along x the way a held key would. Each pass drains and merges them
+//before they go to the simulation, and the run reports how many were merged
+//and how long it took from an event being queued to a frame that included it.
+//The moves can leave the camera a cell off at the end, so the checksum won't
+//always match the other modes. --record journals every input the simulation
+//thread applies and writes it to path after the last step, for JournalReplay.
+//
+//--wave off holds the travelling wave still, with --degrees 0 nothing on the
+//grid moves after the first frame. --bake then bakes the grid into
+//pre-transformed chunks once it has been still for a while, when that takes
+//fewer draws than the --draw path did, and reports the bake time and draws.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "FrustumCuller.h"
+#include "GridSimulation.h"
+#include "InputJournal.h"
+#include "InputQueue.h"
+#include "InstanceBatch.h"
+#include "MeshBuilder.h"
+#include "MetricsRegistry.h"
+#include "PerspectiveCamera.h"
+#include "Profiler.h"
+#include "RecordingRenderBackend.h"
+#include "SimulationThread.h"
+#include "ShaderConstants.h"
+#include "StateTrackingBackend.h"
+#include "StaticGridBake.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const uint64_t CHECKSUM_START = 14695981039346656037ull;
+
+	//folds every matrix into a single value so two builds can be compared quickly,
+	//pass the last hash back in to carry on over the next chunk
+	uint64_t Checksum(const SimMath::Float4x4* models, int count, uint64_t hash = CHECKSUM_START)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(models);
+		size_t size = sizeof(SimMath::Float4x4) * count;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	//expands every chunk of a frame into one array for the whole grid
+	void BuildFrame(const SimulationFrame& frame, FrameInterpolator* interpolator, float alpha, SimMath::Float4x4* models)
+	{
+		if (interpolator)
+			interpolator->BeginFrame();
+		for (int chunk = 0; chunk < frame.GetChunkCount(); chunk++)
+		{
+			const TransformChunk& transforms = frame.chunks[chunk];
+			TransformBatch::Inputs inputs = interpolator ? interpolator->Blend(frame, chunk, alpha) : frame.GetInputs(chunk);
+			TransformBatch::Build(inputs, transforms.GetCellCount(), models + transforms.firstCell);
+		}
+	}
+
+	void PrintMemory(const GridSimulation& simulation)
+	{
+		printf("\n%6s %8s %8s %14s %14s\n", "chunk", "rows", "cells", "transform KB", "model KB");
+		size_t total = simulation.GetSharedMemory();
+		for (int i = 0; i < simulation.GetChunkCount(); i++)
+		{
+			const GridSimulation::Chunk& chunk = simulation.GetChunk(i);
+			size_t transformBytes = chunk.transforms.GetMemoryBytes();
+			size_t modelBytes = chunk.models.capacity() * sizeof(SimMath::Float4x4);
+			printf("%6d %8d %8d %14.1f %14.1f\n", i, chunk.rowCount, chunk.transforms.GetCellCount(),
+				transformBytes / 1024.0, modelBytes / 1024.0);
+			total += simulation.GetChunkMemory(i);
+		}
+		printf("shared      %.1f KB\n", simulation.GetSharedMemory() / 1024.0);
+		printf("total       %.1f KB\n", total / 1024.0);
+	}
+
+	//the simulation on its own thread with this thread as the renderer
+	int RunThreaded(int columns, int rows, int frames, int manipulationType, float degreesPerSecond, int workers, float zoom, bool interpolate,
+		int inputsPerStep, const char* recordPath)
+	{
+		SimulationThread thread(columns, rows);
+		InputJournal journal;
+		if (recordPath)
+			thread.SetJournal(&journal);
+		thread.SetWorkerCount(workers);
+		thread.SetInterpolation(interpolate);
+		thread.SetPlaneManipulation(manipulationType);
+		thread.SetDegreesPerSecond(degreesPerSecond);
+		thread.UpdatePerspective(zoom);
+
+		int cells = columns * rows;
+		std::vector<SimMath::Float4x4> models(cells);
+		FrameInterpolator interpolator;
+		int lastSequence = 0;
+		int renders = 0;
+		int skipped = 0;
+
+		//stands in for the window's input thread
+		InputQueue inputQueue;
+		std::atomic<bool> inputStopping(false);
+		std::thread inputThread;
+		if (inputsPerStep > 0)
+		{
+			inputThread = std::thread([&]()
+			{
+				auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(thread.GetStepSeconds()));
+				auto next = std::chrono::steady_clock::now();
+				while (!inputStopping.load(std::memory_order_relaxed))
+				{
+					for (int i = 0; i < inputsPerStep; i++)
+						inputQueue.PushMove(i % 2 ? 1 : 3, 0, i % 2 ? -1.0f : 1.0f);
+					next += step;
+					std::this_thread::sleep_until(next);
+				}
+			});
+		}
+
+		std::vector<InputEvent> inputEvents;
+		long long inputsDrained = 0;
+		long long inputsApplied = 0;
+		bool inputPending = false;
+		std::chrono::steady_clock::time_point inputQueued;
+		int inputMark = 0;
+		std::vector<double> latencies;
+
+		auto start = std::chrono::steady_clock::now();
+		thread.Start(interpolate, frames);
+		while (lastSequence < frames)
+		{
+			//once a pass, the same as the game does once a tick
+			int drained = inputQueue.Drain(inputEvents);
+			if (drained > 0)
+			{
+				inputsDrained += drained;
+				inputsApplied += inputEvents.size();
+				for (const InputEvent& event : inputEvents)
+					thread.ModifyCameraPosition(event.amount, event.direction);
+				if (!inputPending)
+				{
+					inputPending = true;
+					inputQueued = inputEvents.front().queued;
+					inputMark = thread.GetQueuedInputCount();
+				}
+			}
+
+			const SimulationFrame* frame = thread.AcquireFrame();
+			if (frame && inputPending && frame->inputCount >= inputMark)
+			{
+				latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inputQueued).count());
+				inputPending = false;
+			}
+			if (!frame || (frame->sequence == lastSequence && !interpolate))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			float alpha = 1;
+			if (interpolate)
+			{
+				double sinceStep = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame->published).count();
+				alpha = static_cast<float>(std::min(sinceStep / thread.GetStepSeconds(), 1.0));
+			}
+			BuildFrame(*frame, interpolate ? &interpolator : nullptr, alpha, models.data());
+
+			renders++;
+			if (frame->sequence > lastSequence + 1)
+				skipped += frame->sequence - lastSequence - 1;
+			lastSequence = frame->sequence;
+		}
+		thread.Stop();
+		inputStopping.store(true, std::memory_order_relaxed);
+		if (inputThread.joinable())
+			inputThread.join();
+		if (recordPath && !thread.SaveJournal(recordPath))
+			return 1;
+		double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		//the last step unblended, so it can be compared with the other modes
+		BuildFrame(*thread.AcquireFrame(), nullptr, 1, models.data());
+
+		printf("grid        %d x %d (%d cells)\n", columns, rows, cells);
+		printf("mode        %d\n", manipulationType);
+		printf("workers     %d\n", workers);
+		printf("steps       %d on the simulation thread%s\n", thread.GetStepCount(), interpolate ? ", paced at 60hz" : "");
+		printf("total       %.3f ms\n", totalMs);
+		printf("renders     %d, %.2f per step, %d steps never seen\n", renders, static_cast<double>(renders) / frames, skipped);
+		if (inputsPerStep > 0)
+		{
+			double latencyTotal = 0;
+			double latencyMax = 0;
+			for (double latency : latencies)
+			{
+				latencyTotal += latency;
+				latencyMax = std::max(latencyMax, latency);
+			}
+			printf("inputs      %lld queued, %lld after merging, %d dropped\n", inputsDrained, inputsApplied, inputQueue.GetDroppedCount());
+			printf("latency     %.3f ms average, %.3f ms worst, input to frame over %d samples\n",
+				latencies.empty() ? 0.0 : latencyTotal / latencies.size(), latencyMax, static_cast<int>(latencies.size()));
+		}
+		if (recordPath)
+			printf("journal     %s, %zu bytes\n", recordPath, thread.FinishJournal().size());
+		printf("checksum    %016llx\n", static_cast<unsigned long long>(Checksum(models.data(), cells)));
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int columns = 100;
+	int rows = 100;
+	int frames = 600;
+	int manipulationType = 0;
+	float degreesPerSecond = 0;
+	int workers = 0;
+	bool drawInstanced = false;
+	bool drawCompact = false;
+	bool drawCubes = false;
+	bool cull = false;
+	float zoom = 0;
+	bool resident = false;
+	bool dumpMetrics = false;
+	const char* tracePath = nullptr;
+	bool threaded = false;
+	bool interpolate = false;
+	bool showMemory = false;
+	bool wavePaused = false;
+	bool bakeStill = false;
+	int inputsPerStep = 0;
+	const char* recordPath = nullptr;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--grid") == 0)
+			columns = rows = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--columns") == 0)
+			columns = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--rows") == 0)
+			rows = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--frames") == 0)
+			frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--mode") == 0)
+			manipulationType = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--degrees") == 0)
+			degreesPerSecond = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--workers") == 0)
+			workers = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--draw") == 0 && strcmp(argv[i + 1], "instanced") == 0)
+			drawInstanced = true;
+		else if (strcmp(argv[i], "--draw") == 0 && strcmp(argv[i + 1], "compact") == 0)
+			drawCompact = true;
+		else if (strcmp(argv[i], "--draw") == 0 && strcmp(argv[i + 1], "cube") == 0)
+			drawCubes = true;
+		else if (strcmp(argv[i], "--cull") == 0)
+			cull = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--zoom") == 0)
+			zoom = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--resident") == 0)
+			resident = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--metrics") == 0)
+			dumpMetrics = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--trace") == 0)
+			tracePath = argv[i + 1];
+		else if (strcmp(argv[i], "--threaded") == 0)
+			threaded = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--interpolate") == 0)
+			interpolate = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--memory") == 0)
+			showMemory = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--wave") == 0)
+			wavePaused = strcmp(argv[i + 1], "off") == 0;
+		else if (strcmp(argv[i], "--bake") == 0)
+			bakeStill = strcmp(argv[i + 1], "on") == 0;
+		else if (strcmp(argv[i], "--input") == 0)
+			inputsPerStep = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--record") == 0)
+			recordPath = argv[i + 1];
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (columns < 4 || rows < 4 || frames < 1)
+	{
+		fprintf(stderr, "grid sides must be at least 4 and frames at least 1\n");
+		return 1;
+	}
+
+	if (threaded || interpolate || inputsPerStep > 0 || recordPath)
+		return RunThreaded(columns, rows, frames, manipulationType, degreesPerSecond, workers, zoom, interpolate, inputsPerStep, recordPath);
+
+	GridSimulation simulation(columns, rows);
+	simulation.SetPlaneManipulation(manipulationType);
+	simulation.SetWorkerCount(workers);
+	simulation.SetBuildModels(!drawCompact);
+	simulation.UpdatePerspective(zoom);
+	simulation.SetWavePaused(wavePaused);
+
+	PerspectiveCamera camera;
+	camera.SetOutputSize(1280, 720);
+	camera.Refresh();
+	FrustumCuller culler;
+	culler.SetViewProjection(camera.GetConstants());
+	unsigned long long visibleCells = 0;
+	unsigned long long culledCells = 0;
+	unsigned long long dirtyCells = 0;
+	int fullRebuilds = 0;
+
+	//same fixed 60hz step the game timer uses
+	const double elapsedSeconds = 1.0 / 60;
+	double totalSeconds = 0;
+	double slowestMs = 0;
+
+	//stand ins for the device objects, the recording backend never dereferences them
+	static char resources[8];
+	InstanceDrawBindings bindings = {};
+	bindings.vertexBuffer = &resources[0];
+	bindings.vertexStride = 24;
+	bindings.indexBuffer = &resources[1];
+	bindings.indexFormat = IndexFormat::Index16;
+	bindings.indexCount = 36;
+	bindings.inputLayout = &resources[2];
+	bindings.vertexShader = &resources[3];
+	bindings.pixelShader = &resources[4];
+	bindings.frameConstantBuffer = &resources[5];
+	bindings.objectConstantBuffer = &resources[7];
+	bindings.objectConstantsSize = sizeof(ModelConstantBuffer);
+
+	//a batch and an instance buffer for each chunk
+	int chunkCount = simulation.GetChunkCount();
+	std::vector<InstanceBatch> batches(chunkCount);
+	std::vector<InstanceDrawBindings> chunkBindings(chunkCount, bindings);
+	std::vector<char> instanceBuffers(chunkCount);
+	for (int i = 0; i < chunkCount; i++)
+	{
+		chunkBindings[i].instanceBuffer = &instanceBuffers[i];
+		chunkBindings[i].instanceCapacity = simulation.GetChunk(i).transforms.GetCellCount();
+		batches[i].Reserve(chunkBindings[i].instanceCapacity, drawCompact, GridSimulation::GetDirtyRangeLimit(rows));
+	}
+	//where each chunk's cells are in the culler's visible list
+	std::vector<CellRange> visibleSpans(chunkCount);
+
+	RecordingRenderBackend backend;
+	backend.SetRecording(false);
+	StateTrackingBackend stateTracker(backend);
+	unsigned long long bindsIssued = 0;
+	unsigned long long bindsSkipped = 0;
+
+	//the baked grid with stand ins for its buffers, baked once it has been still long enough
+	StaticGridBake bake;
+	if (bakeStill)
+		bake.SetMesh(MeshBuilder::Cube());
+	std::vector<char> bakeBuffers;
+	int lastChanged = 0;
+	int liveDrawCalls = 0;
+	int bakedFrames = 0;
+
+	//the same names the game registers
+	MetricsRegistry metrics;
+	MetricsRegistry::Counter* frameCounter = metrics.GetCounter("frames");
+	MetricsRegistry::Gauge* dirtyGauge = metrics.GetGauge("dirty cells");
+	MetricsRegistry::Gauge* visibleGauge = metrics.GetGauge("visible cells");
+	MetricsRegistry::Histogram* frameTimer = metrics.GetTimer("frame ms");
+	MetricsRegistry::Histogram* updateTimer = metrics.GetTimer("update ms");
+	MetricsRegistry::Histogram* renderTimer = metrics.GetTimer("render ms");
+
+	PROFILE_THREAD_NAME("main");
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		PROFILE_ZONE("Frame");
+		//a bake allocates, so it is made ahead of the frame from the step the last frame drew
+		if (bakeStill && bake.Track(frame, lastChanged) && !bake.IsBaked() && bake.IsWorthBaking(simulation.GetCellCount(), liveDrawCalls))
+		{
+			bake.Begin();
+			for (int i = 0; i < chunkCount; i++)
+				bake.Add(simulation.GetChunkInputs(i), simulation.GetChunk(i).transforms.GetCellCount());
+			bake.End();
+
+			bakeBuffers.assign(bake.GetChunkCount() * 2, 0);
+			for (int i = 0; i < bake.GetChunkCount(); i++)
+			{
+				bake.GetChunk(i).vertexBuffer = &bakeBuffers[i * 2];
+				bake.GetChunk(i).indexBuffer = &bakeBuffers[i * 2 + 1];
+				backend.UpdateBuffer(&bakeBuffers[i * 2], nullptr, bake.GetChunk(i).vertices.size() * sizeof(MeshVertex));
+				backend.UpdateBuffer(&bakeBuffers[i * 2 + 1], nullptr, bake.GetChunk(i).indices.size() * sizeof(uint16_t));
+			}
+			bake.ReleaseGeometry();
+		}
+
+		//after the first frame nothing changes size, so nothing should allocate
+		NoAllocationScope noAllocations("GridSimulationDriver frame", frame > 0);
+		totalSeconds += elapsedSeconds;
+		float radians = static_cast<float>(fmod(totalSeconds * SimMath::ConvertToRadians(degreesPerSecond), SimMath::TWO_PI));
+
+		auto frameStart = std::chrono::steady_clock::now();
+		simulation.Update(radians);
+		auto updateEnd = std::chrono::steady_clock::now();
+		dirtyCells += simulation.GetDirtyCellCount();
+		if (simulation.WasFullRebuild())
+			fullRebuilds++;
+		stateTracker.BeginFrame();
+
+		//the step is the frame's sequence, the bake goes as soon as one moves anything
+		if (simulation.GetDirtyCellCount() > 0)
+			lastChanged = frame + 1;
+		bool drawBaked = false;
+		if (bakeStill)
+		{
+			bake.Track(frame + 1, lastChanged);
+			drawBaked = bake.IsBaked();
+		}
+
+		//without culling every cell is in the list
+		int visibleCount = simulation.GetCellCount();
+		if (cull)
+		{
+			culler.Clear();
+			for (int i = 0; i < chunkCount; i++)
+			{
+				const TransformChunk& transforms = simulation.GetChunk(i).transforms;
+				visibleSpans[i].begin = static_cast<int>(culler.GetVisible().size());
+				culler.CullChunk(simulation.GetChunkInputs(i), simulation.GetModAmount(), transforms.GetCellCount(), transforms.firstCell);
+				visibleSpans[i].end = static_cast<int>(culler.GetVisible().size());
+			}
+			visibleCount = culler.GetStats().visibleCells;
+			visibleCells += culler.GetStats().visibleCells;
+			culledCells += culler.GetStats().culledCells;
+		}
+
+		if (drawBaked)
+		{
+			bake.Submit(stateTracker, bindings);
+			bakedFrames++;
+		}
+
+		for (int i = 0; i < chunkCount && !drawBaked; i++)
+		{
+			const GridSimulation::Chunk& chunk = simulation.GetChunk(i);
+			int firstCell = chunk.transforms.firstCell;
+			int chunkCells = chunk.transforms.GetCellCount();
+			const int* visible = cull ? culler.GetVisible().data() + visibleSpans[i].begin : nullptr;
+			int chunkVisible = cull ? visibleSpans[i].end - visibleSpans[i].begin : chunkCells;
+			InstanceBatch& batch = batches[i];
+
+			if (resident && (drawInstanced || drawCompact))
+			{
+				if (drawInstanced)
+					batch.UpdateResident(chunk.models.data(), chunkCells, simulation.GetDirtyRanges(), firstCell);
+				else
+					batch.UpdateResidentCompact(simulation.GetChunkInputs(i), chunkCells, simulation.GetDirtyRanges(), firstCell);
+				batch.SubmitResident(stateTracker, chunkBindings[i], cull ? &culler.GetVisible() : nullptr, firstCell);
+			}
+			else if (drawInstanced)
+			{
+				if (visible)
+					batch.Pack(chunk.models.data(), visible, chunkVisible, firstCell);
+				else
+					batch.Pack(chunk.models.data(), chunkVisible);
+				batch.Submit(stateTracker, chunkBindings[i]);
+			}
+			else if (drawCompact)
+			{
+				if (visible)
+					batch.PackCompact(simulation.GetChunkInputs(i), visible, chunkVisible, firstCell);
+				else
+					batch.PackCompact(simulation.GetChunkInputs(i), chunkVisible);
+				batch.Submit(stateTracker, chunkBindings[i]);
+			}
+			else if (drawCubes)
+			{
+				//per cube constants, only the size matters to the recording backend
+				for (int j = 0; j < chunkVisible; j++)
+					InstanceBatch::SubmitSingle(stateTracker, bindings, &chunk.models[visible ? visible[j] - firstCell : j]);
+			}
+		}
+		if (!drawBaked)
+			liveDrawCalls = stateTracker.GetFrameCounters().draws;
+		bindsIssued += stateTracker.GetFrameCounters().issued;
+		bindsSkipped += stateTracker.GetFrameCounters().skipped;
+		auto frameEnd = std::chrono::steady_clock::now();
+		double frameMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+		if (frameMs > slowestMs)
+			slowestMs = frameMs;
+
+		frameCounter->Add();
+		dirtyGauge->Set(simulation.GetDirtyCellCount());
+		visibleGauge->Set(visibleCount);
+		frameTimer->Record(frameMs);
+		updateTimer->Record(std::chrono::duration<double, std::milli>(updateEnd - frameStart).count());
+		renderTimer->Record(std::chrono::duration<double, std::milli>(frameEnd - updateEnd).count());
+	}
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	int cells = simulation.GetCellCount();
+	uint64_t checksum = CHECKSUM_START;
+	std::vector<SimMath::Float4x4> expanded;
+	for (int i = 0; i < chunkCount; i++)
+	{
+		const GridSimulation::Chunk& chunk = simulation.GetChunk(i);
+		int chunkCells = chunk.transforms.GetCellCount();
+		const SimMath::Float4x4* models = chunk.models.data();
+		if (drawCompact)
+		{
+			//the drawn batch may be culled, so pack every cell again for the checksum
+			InstanceBatch everyCell;
+			everyCell.PackCompact(simulation.GetChunkInputs(i), chunkCells);
+			expanded.resize(chunkCells);
+			TransformBatch::Expand(everyCell.GetCompactInstances(), chunkCells, expanded.data());
+			models = expanded.data();
+		}
+		checksum = Checksum(models, chunkCells, checksum);
+	}
+
+	printf("grid        %d x %d (%d cells, %d chunks)\n", columns, rows, cells, chunkCount);
+	printf("mode        %d\n", manipulationType);
+	printf("workers     %d\n", simulation.GetWorkerCount());
+	printf("frames      %d\n", frames);
+	printf("total       %.3f ms\n", totalMs);
+	printf("frame avg   %.4f ms\n", totalMs / frames);
+	printf("frame max   %.4f ms\n", slowestMs);
+	printf("frame pct   p50 %.4f, p95 %.4f, p99 %.4f ms over the last %d\n", frameTimer->Percentile(50),
+		frameTimer->Percentile(95), frameTimer->Percentile(99), MetricsRegistry::Histogram::HISTORY);
+	printf("per cell    %.2f ns\n", totalMs * 1e6 / (static_cast<double>(frames) * cells));
+	printf("checksum    %016llx\n", static_cast<unsigned long long>(checksum));
+	printf("dirty cells %.1f per frame, %d full rebuilds\n", static_cast<double>(dirtyCells) / frames, fullRebuilds);
+
+	if (drawInstanced || drawCompact || drawCubes)
+	{
+		printf("binds       %.1f issued, %.1f skipped per frame\n",
+			static_cast<double>(bindsIssued) / frames, static_cast<double>(bindsSkipped) / frames);
+		printf("draw calls  %.1f per frame\n", static_cast<double>(backend.GetDrawCalls()) / frames);
+		printf("uploaded    %.1f KB per frame\n", static_cast<double>(backend.GetBytesUploaded()) / frames / 1024);
+	}
+
+	if (bakeStill)
+	{
+		printf("baked       %d of %d frames, %d bakes, the last took %.3f ms\n", bakedFrames, frames, bake.GetBakeCount(), bake.GetBakeMilliseconds());
+		printf("bake draws  %d per baked frame instead of %d\n", bake.GetChunkCount(), liveDrawCalls);
+	}
+
+	if (cull)
+	{
+		printf("culling     %.1f visible, %.1f culled per frame\n",
+			static_cast<double>(visibleCells) / frames, static_cast<double>(culledCells) / frames);
+		const FrustumCuller::Stats& stats = culler.GetStats();
+		printf("last blocks %d inside, %d partial, %d outside\n", stats.blocksInside, stats.blocksPartial, stats.blocksOutside);
+	}
+
+	if (manipulationType == 4)
+	{
+		const MandelbrotFieldCache& cache = simulation.GetMandlebrotCache();
+		printf("field cache %llu hits, %llu misses, %llu shifts, %llu cells computed, %llu reused\n",
+			cache.GetHits(), cache.GetMisses(), cache.GetShifts(), cache.GetCellsComputed(), cache.GetCellsReused());
+	}
+	if (showMemory)
+		PrintMemory(simulation);
+	if (dumpMetrics)
+		printf("\n%s", metrics.Format().c_str());
+
+	if (tracePath)
+	{
+		std::string trace = Profiler::ChromeTrace();
+		FILE* file = fopen(tracePath, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "could not write %s\n", tracePath);
+			return 1;
+		}
+		fwrite(trace.data(), 1, trace.size(), file);
+		fclose(file);
+		printf("\n%s", Profiler::Summary().c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,39 @@
+// View and projection are shared by the whole grid and only change on resize,
+// the model matrix is the only thing uploaded per cube.
+cbuffer ViewProjectionConstantBuffer : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+cbuffer ModelConstantBuffer : register(b1)
+{
+	matrix model;
+};
+
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 color : COLOR0;
+};
+
+struct PixelShaderInput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	PixelShaderInput output;
+	float4 pos = float4(input.pos, 1.0f);
+
+	pos = mul(pos, model);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+
+	output.color = input.color;
+
+	return output;
+}
@@ -0,0 +1,228 @@
+﻿#include "InputJournal.h"
+#include "GridSimulation.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const uint8_t END_RECORD = 0xff;
+	const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+
+	void WriteBytes(std::vector<uint8_t>& bytes, uint64_t value, int count)
+	{
+		for (int i = 0; i < count; i++)
+			bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+	}
+
+	uint64_t Hash(const void* data, size_t size, uint64_t hash)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	//reads the journal front to back, every read fails once anything runs past the end
+	class Reader
+	{
+	public:
+		Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size), m_position(0), m_failed(false) {}
+
+		uint64_t Read(int count)
+		{
+			if (m_position + count > m_size)
+			{
+				m_failed = true;
+				return 0;
+			}
+			uint64_t value = 0;
+			for (int i = 0; i < count; i++)
+				value |= static_cast<uint64_t>(m_data[m_position + i]) << (i * 8);
+			m_position += count;
+			return value;
+		}
+
+		int ReadVarint()
+		{
+			uint32_t encoded = 0;
+			for (int shift = 0; shift < 35; shift += 7)
+			{
+				uint64_t byte = Read(1);
+				if (m_failed)
+					return 0;
+				encoded |= static_cast<uint32_t>(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+					return static_cast<int>((encoded >> 1) ^ (0u - (encoded & 1)));
+			}
+			m_failed = true;
+			return 0;
+		}
+
+		bool IsDone() const { return m_position == m_size; }
+		bool HasFailed() const { return m_failed; }
+
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_position;
+		bool m_failed;
+	};
+}
+
+InputJournal::InputJournal() :
+	m_header(),
+	m_recording(false),
+	m_lastStep(0),
+	m_stepCount(0),
+	m_checksum(0)
+{
+}
+
+void InputJournal::Begin(const Header& header)
+{
+	m_header = header;
+	m_recording = true;
+	m_lastStep = 0;
+	m_records.clear();
+	m_bytes.clear();
+
+	uint64_t stepBits;
+	memcpy(&stepBits, &header.stepSeconds, sizeof(stepBits));
+	WriteBytes(m_bytes, MAGIC, 4);
+	WriteBytes(m_bytes, VERSION, 4);
+	WriteBytes(m_bytes, static_cast<uint32_t>(header.columns), 4);
+	WriteBytes(m_bytes, static_cast<uint32_t>(header.rows), 4);
+	WriteBytes(m_bytes, stepBits, 8);
+}
+
+//zigzag so small negative values stay one byte as well
+void InputJournal::WriteVarint(int value)
+{
+	uint32_t encoded = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	while (encoded >= 0x80)
+	{
+		m_bytes.push_back(static_cast<uint8_t>(encoded | 0x80));
+		encoded >>= 7;
+	}
+	m_bytes.push_back(static_cast<uint8_t>(encoded));
+}
+
+void InputJournal::Add(const Record& record)
+{
+	uint32_t amountBits;
+	memcpy(&amountBits, &record.amount, sizeof(amountBits));
+
+	WriteVarint(record.step - m_lastStep);
+	m_bytes.push_back(record.type);
+	WriteBytes(m_bytes, amountBits, 4);
+	WriteVarint(record.value);
+	WriteVarint(record.secondValue);
+	m_lastStep = record.step;
+}
+
+std::vector<uint8_t> InputJournal::Finish(int stepCount, uint64_t checksum) const
+{
+	InputJournal closed = *this;
+	closed.WriteVarint(stepCount - m_lastStep);
+	closed.m_bytes.push_back(END_RECORD);
+	WriteBytes(closed.m_bytes, checksum, 8);
+	return closed.m_bytes;
+}
+
+bool InputJournal::Save(const char* path, int stepCount, uint64_t checksum) const
+{
+	std::vector<uint8_t> bytes = Finish(stepCount, checksum);
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		fprintf(stderr, "can't write %s\n", path);
+		return false;
+	}
+	bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return written;
+}
+
+bool InputJournal::Load(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "can't read %s\n", path);
+		return false;
+	}
+	std::vector<uint8_t> bytes;
+	uint8_t buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer + read);
+	fclose(file);
+
+	if (!Parse(bytes.data(), bytes.size()))
+	{
+		fprintf(stderr, "%s isn't a whole journal\n", path);
+		return false;
+	}
+	return true;
+}
+
+bool InputJournal::Parse(const uint8_t* data, size_t size)
+{
+	m_records.clear();
+	m_recording = false;
+
+	Reader reader(data, size);
+	if (reader.Read(4) != MAGIC || reader.Read(4) != VERSION)
+		return false;
+	m_header.columns = static_cast<int>(reader.Read(4));
+	m_header.rows = static_cast<int>(reader.Read(4));
+	uint64_t stepBits = reader.Read(8);
+	memcpy(&m_header.stepSeconds, &stepBits, sizeof(stepBits));
+
+	int step = 0;
+	while (!reader.HasFailed())
+	{
+		step += reader.ReadVarint();
+		uint8_t type = static_cast<uint8_t>(reader.Read(1));
+		if (type == END_RECORD)
+		{
+			m_stepCount = step;
+			m_checksum = reader.Read(8);
+			return !reader.HasFailed() && reader.IsDone();
+		}
+
+		Record record;
+		record.step = step;
+		record.type = type;
+		uint32_t amountBits = static_cast<uint32_t>(reader.Read(4));
+		memcpy(&record.amount, &amountBits, sizeof(amountBits));
+		record.value = reader.ReadVarint();
+		record.secondValue = reader.ReadVarint();
+		m_records.push_back(record);
+	}
+	return false;
+}
+
+uint64_t InputJournal::Checksum(const GridSimulation& simulation)
+{
+	uint64_t hash = FNV_OFFSET;
+	float scale = simulation.GetAdditionalScaling();
+	hash = Hash(&scale, sizeof(scale), hash);
+	for (int i = 0; i < simulation.GetChunkCount(); i++)
+	{
+		const TransformChunk& transforms = simulation.GetChunk(i).transforms;
+		size_t size = transforms.x.size() * sizeof(float);
+		hash = Hash(transforms.x.data(), size, hash);
+		hash = Hash(transforms.y.data(), size, hash);
+		hash = Hash(transforms.z.data(), size, hash);
+		hash = Hash(transforms.yaw.data(), size, hash);
+	}
+	return hash;
+}
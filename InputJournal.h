@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace DirectX11_Game
+{
+	class GridSimulation;
+
+	//Every input a simulation applied and the step it was applied on, so the
+	//steps can be run again without a window and come out bit for bit the same.
+	//The simulation only depends on its inputs and how many fixed steps it has
+	//run, so that is all a session needs.
+	//
+	//The file is a header, then one record per input holding the steps since the
+	//last record, the input type and its values, with the integers as zigzag
+	//varints. An end record closes it with the step count and a checksum of the
+	//grid after the last step, for the replay to compare against.
+	class InputJournal
+	{
+	public:
+		static const uint32_t MAGIC = 0x4e524a47; //GJRN
+		static const uint32_t VERSION = 1;
+
+		struct Header
+		{
+			int columns;
+			int rows;
+			double stepSeconds;
+		};
+
+		//the simulation thread's own input, type is its InputType
+		struct Record
+		{
+			int step;
+			uint8_t type;
+			float amount;
+			int value;
+			int secondValue;
+		};
+
+		InputJournal();
+
+		//writing, records in step order
+		void Begin(const Header& header);
+		void Add(const Record& record);
+		bool IsRecording() const { return m_recording; }
+
+		//the journal so far with an end record after it, the journal itself carries on
+		std::vector<uint8_t> Finish(int stepCount, uint64_t checksum) const;
+		bool Save(const char* path, int stepCount, uint64_t checksum) const;
+
+		//reading, false when the bytes aren't a whole journal
+		bool Load(const char* path);
+		bool Parse(const uint8_t* data, size_t size);
+
+		const Header& GetHeader() const { return m_header; }
+		const std::vector<Record>& GetRecords() const { return m_records; }
+		int GetStepCount() const { return m_stepCount; }
+		uint64_t GetChecksum() const { return m_checksum; }
+		//the records so far, without the end
+		size_t GetSize() const { return m_bytes.size(); }
+
+		//FNV-1a over every cell's position and yaw and the scale, what the renderer draws from
+		static uint64_t Checksum(const GridSimulation& simulation);
+
+	private:
+		void WriteVarint(int value);
+
+		Header m_header;
+		bool m_recording;
+		int m_lastStep;
+		std::vector<uint8_t> m_bytes;
+
+		std::vector<Record> m_records;
+		int m_stepCount;
+		uint64_t m_checksum;
+	};
+}
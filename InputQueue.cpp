@@ -0,0 +1,101 @@
+﻿#include "InputQueue.h"
+
+using namespace DirectX11_Game;
+
+bool InputQueue::Push(InputEvent::Type type, int code, int direction, float amount, float x, float y)
+{
+	InputEvent event;
+	event.type = type;
+	event.code = code;
+	event.direction = direction;
+	event.amount = amount;
+	event.x = x;
+	event.y = y;
+	event.queued = std::chrono::steady_clock::now();
+	event.count = 1;
+
+	if (m_events.Push(event))
+		return true;
+	m_dropped.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+bool InputQueue::PushKey(int code)
+{
+	return Push(InputEvent::Key, code, 0, 0, 0, 0);
+}
+
+bool InputQueue::PushMove(int code, int direction, float amount)
+{
+	return Push(InputEvent::Move, code, direction, amount, 0, 0);
+}
+
+bool InputQueue::PushZoom(int code, float amount)
+{
+	return Push(InputEvent::Zoom, code, 0, amount, 0, 0);
+}
+
+bool InputQueue::PushPointer(int code, float x, float y)
+{
+	return Push(InputEvent::Pointer, code, 0, 0, x, y);
+}
+
+int InputQueue::Drain(std::vector<InputEvent>& events)
+{
+	//room for a full queue, so draining never allocates after the first time
+	events.clear();
+	events.reserve(CAPACITY);
+	InputEvent event;
+	while (m_events.Pop(event))
+		events.push_back(event);
+
+	int drained = static_cast<int>(events.size());
+	Coalesce(events);
+	return drained;
+}
+
+void InputQueue::Coalesce(std::vector<InputEvent>& events)
+{
+	//everything before a key stays where it is
+	size_t barrier = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const InputEvent& event = events[i];
+		if (event.type == InputEvent::Key)
+		{
+			events[kept++] = event;
+			barrier = kept;
+			continue;
+		}
+
+		//the newest earlier one of the same kind, moves along other axes and other kinds don't affect it
+		size_t match = kept;
+		for (size_t j = kept; j > barrier; j--)
+		{
+			const InputEvent& earlier = events[j - 1];
+			if (earlier.type == event.type && (event.type != InputEvent::Move || earlier.direction == event.direction))
+			{
+				match = j - 1;
+				break;
+			}
+		}
+
+		bool merge = match < kept;
+		if (merge && event.type == InputEvent::Zoom)
+			merge = (events[match].amount < 0) == (event.amount < 0);
+		if (!merge)
+		{
+			events[kept++] = event;
+			continue;
+		}
+
+		InputEvent& into = events[match];
+		into.amount += event.amount;
+		into.x = event.x;
+		into.y = event.y;
+		into.code = event.code;
+		into.count += event.count;
+	}
+	events.resize(kept);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "SpscQueue.h"
+
+namespace DirectX11_Game
+{
+	//One thing the player did, stamped when the input thread saw it
+	struct InputEvent
+	{
+		enum Type : uint8_t
+		{
+			//anything that sets state rather than adding to it, never merged
+			Key,
+			//amount added to the camera offset along direction
+			Move,
+			//amount added to the scale
+			Zoom,
+			//an absolute pointer position in x and y, the newest one wins
+			Pointer
+		};
+
+		Type type;
+		//what the input thread was handed, kept for the overlay
+		int code;
+		int direction;
+		float amount;
+		float x;
+		float y;
+		//the oldest of the events merged into this one
+		std::chrono::steady_clock::time_point queued;
+		//events merged into this one, 1 for one that wasn't merged
+		int count;
+	};
+
+	//Events from the input thread to whoever applies them, drained once a tick.
+	//A held key or a fast wheel can raise dozens of events a frame, Drain
+	//merges the ones that only add to something so each reaches the renderer
+	//once. Push never blocks, when the reader has stopped draining for so long
+	//that the queue fills the event is dropped and counted.
+	class InputQueue
+	{
+	public:
+		static const uint32_t CAPACITY = 256;
+
+		InputQueue() : m_dropped(0) {}
+
+		//input thread only, false when the event was dropped
+		bool PushKey(int code);
+		bool PushMove(int code, int direction, float amount);
+		bool PushZoom(int code, float amount);
+		bool PushPointer(int code, float x, float y);
+
+		//reader only, replaces events with everything queued so far, merged.
+		//Returns the events taken off the queue before merging.
+		int Drain(std::vector<InputEvent>& events);
+
+		//Merges each Move, Zoom and Pointer into the newest earlier one of its
+		//kind, as long as no Key came in between. Moves merge per direction.
+		//Zooms only merge with the same sign since the scale is clamped on the
+		//way down, a zoom out then in isn't the same as the two added together.
+		static void Coalesce(std::vector<InputEvent>& events);
+
+		int GetDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+	private:
+		bool Push(InputEvent::Type type, int code, int direction, float amount, float x, float y);
+
+		SpscQueue<InputEvent, CAPACITY> m_events;
+		std::atomic<int> m_dropped;
+	};
+}
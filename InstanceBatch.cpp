@@ -0,0 +1,278 @@
+﻿#include "InstanceBatch.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX11_Game;
+
+InstanceBatch::InstanceBatch() :
+	m_compact(false),
+	m_resident(false)
+{
+}
+
+void InstanceBatch::Pack(const SimMath::Float4x4* models, int count)
+{
+	PROFILE_ZONE("InstanceBatch::Pack");
+	static_assert(sizeof(InstanceData) == sizeof(SimMath::Float4x4), "instance data must stay tightly packed");
+
+	//resize only reallocates when the grid grows
+	m_compact = false;
+	m_resident = false;
+	m_instances.resize(count);
+	if (count > 0)
+		memcpy(m_instances.data(), models, sizeof(InstanceData) * count);
+}
+
+void InstanceBatch::PackCompact(const TransformBatch::Inputs& transforms, int count)
+{
+	PROFILE_ZONE("InstanceBatch::PackCompact");
+	static_assert(sizeof(CompactInstance) == sizeof(float) * 5, "compact instances must stay tightly packed");
+
+	m_compact = true;
+	m_resident = false;
+	m_compactInstances.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		CompactInstance& instance = m_compactInstances[i];
+		instance.x = transforms.x[i];
+		instance.y = transforms.y[i];
+		instance.z = transforms.z[i];
+		instance.yaw = transforms.yaw[i];
+		instance.scale = transforms.scale ? transforms.scale[i] : transforms.uniformScale;
+	}
+}
+
+void InstanceBatch::Pack(const SimMath::Float4x4* models, const int* indices, int count, int firstCell)
+{
+	PROFILE_ZONE("InstanceBatch::Pack");
+	m_compact = false;
+	m_resident = false;
+	m_instances.resize(count);
+	for (int i = 0; i < count; i++)
+		m_instances[i].model = models[indices[i] - firstCell];
+}
+
+void InstanceBatch::PackCompact(const TransformBatch::Inputs& transforms, const int* indices, int count, int firstCell)
+{
+	PROFILE_ZONE("InstanceBatch::PackCompact");
+	m_compact = true;
+	m_resident = false;
+	m_compactInstances.resize(count);
+	for (int i = 0; i < count; i++)
+	{
+		int cell = indices[i] - firstCell;
+		CompactInstance& instance = m_compactInstances[i];
+		instance.x = transforms.x[cell];
+		instance.y = transforms.y[cell];
+		instance.z = transforms.z[cell];
+		instance.yaw = transforms.yaw[cell];
+		instance.scale = transforms.scale ? transforms.scale[cell] : transforms.uniformScale;
+	}
+}
+
+int InstanceBatch::GetInstanceCount() const
+{
+	return static_cast<int>(m_compact ? m_compactInstances.size() : m_instances.size());
+}
+
+unsigned int InstanceBatch::GetInstanceStride() const
+{
+	return m_compact ? sizeof(CompactInstance) : sizeof(InstanceData);
+}
+
+void InstanceBatch::BindInstanced(RenderBackend& backend, const InstanceDrawBindings& bindings) const
+{
+	//slot 0 is the cube mesh, slot 1 steps once per instance
+	backend.SetVertexBuffer(0, bindings.vertexBuffer, bindings.vertexStride, 0);
+	backend.SetVertexBuffer(1, bindings.instanceBuffer, GetInstanceStride(), 0);
+	backend.SetIndexBuffer(bindings.indexBuffer, bindings.indexFormat, 0);
+	backend.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+	backend.SetInputLayout(bindings.inputLayout);
+	backend.SetVertexShader(bindings.vertexShader);
+	backend.SetVertexConstantBuffer(0, bindings.frameConstantBuffer);
+	backend.SetPixelShader(bindings.pixelShader);
+}
+
+void InstanceBatch::Submit(RenderBackend& backend, const InstanceDrawBindings& bindings) const
+{
+	PROFILE_ZONE("InstanceBatch::Submit");
+	int instanceCount = GetInstanceCount();
+	if (instanceCount == 0 || bindings.instanceCapacity == 0)
+		return;
+
+	unsigned int stride = GetInstanceStride();
+	const unsigned char* instances = m_compact ?
+		reinterpret_cast<const unsigned char*>(m_compactInstances.data()) :
+		reinterpret_cast<const unsigned char*>(m_instances.data());
+	BindInstanced(backend, bindings);
+
+	for (int first = 0; first < instanceCount; first += bindings.instanceCapacity)
+	{
+		int count = instanceCount - first;
+		if (count > static_cast<int>(bindings.instanceCapacity))
+			count = bindings.instanceCapacity;
+
+		backend.WriteDynamicBuffer(bindings.instanceBuffer, instances + static_cast<size_t>(stride) * first, stride * count);
+		backend.DrawIndexedInstanced(bindings.indexCount, count, 0, 0, 0);
+	}
+}
+
+bool InstanceBatch::BeginResident(bool compact, int count)
+{
+	bool intact = m_resident && m_compact == compact && GetInstanceCount() == count;
+	m_resident = true;
+	m_compact = compact;
+	if (!intact)
+	{
+		m_pendingUploads.clear();
+		if (count > 0)
+			m_pendingUploads.push_back({ 0, count });
+	}
+	return intact;
+}
+
+//Updates without a submit in between would otherwise pile up, interpolated
+//frames change every cell every render and would queue the whole batch each time.
+void InstanceBatch::AddPendingUpload(const CellRange& range, int count)
+{
+	bool whole = range.begin == 0 && range.end == count;
+	if (!m_pendingUploads.empty() && m_pendingUploads.front().begin == 0 && m_pendingUploads.front().end == count)
+		return;
+	if (whole)
+		m_pendingUploads.clear();
+	m_pendingUploads.push_back(range);
+}
+
+void InstanceBatch::Reserve(int instanceCount, bool compact, int rangeCount)
+{
+	if (compact)
+		m_compactInstances.reserve(instanceCount);
+	else
+		m_instances.reserve(instanceCount);
+	m_localRanges.reserve(rangeCount);
+	m_pendingUploads.reserve(rangeCount + 1);
+}
+
+const std::vector<CellRange>& InstanceBatch::LocalRanges(const std::vector<CellRange>& changed, int count, int firstCell)
+{
+	//a whole grid in one batch takes the ranges as they are
+	if (firstCell == 0 && (changed.empty() || changed.back().end <= count))
+		return changed;
+
+	m_localRanges.clear();
+	for (const CellRange& range : changed)
+	{
+		int begin = std::max(range.begin - firstCell, 0);
+		int end = std::min(range.end - firstCell, count);
+		if (begin < end)
+			m_localRanges.push_back({ begin, end });
+	}
+	return m_localRanges;
+}
+
+void InstanceBatch::UpdateResident(const SimMath::Float4x4* models, int count, const std::vector<CellRange>& changed, int firstCell)
+{
+	PROFILE_ZONE("InstanceBatch::UpdateResident");
+	if (!BeginResident(false, count))
+	{
+		m_instances.resize(count);
+		if (count > 0)
+			memcpy(m_instances.data(), models, sizeof(InstanceData) * count);
+		return;
+	}
+
+	for (const CellRange& range : LocalRanges(changed, count, firstCell))
+	{
+		memcpy(&m_instances[range.begin], &models[range.begin], sizeof(InstanceData) * (range.end - range.begin));
+		AddPendingUpload(range, count);
+	}
+}
+
+void InstanceBatch::UpdateResidentCompact(const TransformBatch::Inputs& transforms, int count, const std::vector<CellRange>& changed, int firstCell)
+{
+	PROFILE_ZONE("InstanceBatch::UpdateResidentCompact");
+	bool intact = BeginResident(true, count);
+	if (!intact)
+		m_compactInstances.resize(count);
+
+	//the whole grid when the mirror was not intact, otherwise just what changed
+	const std::vector<CellRange>& local = LocalRanges(changed, count, firstCell);
+	const std::vector<CellRange>& ranges = intact ? local : m_pendingUploads;
+	for (const CellRange& range : ranges)
+	{
+		for (int i = range.begin; i < range.end; i++)
+		{
+			CompactInstance& instance = m_compactInstances[i];
+			instance.x = transforms.x[i];
+			instance.y = transforms.y[i];
+			instance.z = transforms.z[i];
+			instance.yaw = transforms.yaw[i];
+			instance.scale = transforms.scale ? transforms.scale[i] : transforms.uniformScale;
+		}
+	}
+
+	if (!intact)
+		return;
+	for (const CellRange& range : local)
+		AddPendingUpload(range, count);
+}
+
+void InstanceBatch::SubmitResident(RenderBackend& backend, const InstanceDrawBindings& bindings, const std::vector<int>* visible, int firstCell)
+{
+	PROFILE_ZONE("InstanceBatch::SubmitResident");
+	int instanceCount = GetInstanceCount();
+	if (instanceCount == 0 || static_cast<int>(bindings.instanceCapacity) < instanceCount)
+		return;
+
+	unsigned int stride = GetInstanceStride();
+	const unsigned char* instances = m_compact ?
+		reinterpret_cast<const unsigned char*>(m_compactInstances.data()) :
+		reinterpret_cast<const unsigned char*>(m_instances.data());
+
+	for (const CellRange& range : m_pendingUploads)
+	{
+		backend.UpdateBufferRegion(bindings.instanceBuffer, stride * range.begin,
+			instances + static_cast<size_t>(stride) * range.begin, stride * (range.end - range.begin));
+	}
+	m_pendingUploads.clear();
+
+	BindInstanced(backend, bindings);
+
+	if (!visible)
+	{
+		backend.DrawIndexedInstanced(bindings.indexCount, instanceCount, 0, 0, 0);
+		return;
+	}
+
+	//the instances stay where they are, so visible cells are drawn as runs with
+	//start instance offsets, a few hidden cubes are cheaper than another draw
+	const int* cell = std::lower_bound(visible->data(), visible->data() + visible->size(), firstCell);
+	const int* end = std::lower_bound(cell, visible->data() + visible->size(), firstCell + instanceCount);
+	while (cell < end)
+	{
+		int runStart = *cell - firstCell;
+		int runEnd = runStart + 1;
+		for (cell++; cell < end && *cell - firstCell - runEnd < RESIDENT_RUN_GAP; cell++)
+			runEnd = *cell - firstCell + 1;
+
+		backend.DrawIndexedInstanced(bindings.indexCount, runEnd - runStart, 0, 0, runStart);
+	}
+}
+
+void InstanceBatch::SubmitSingle(RenderBackend& backend, const InstanceDrawBindings& bindings, const void* constants)
+{
+	backend.UpdateBuffer(bindings.objectConstantBuffer, constants, bindings.objectConstantsSize);
+
+	backend.SetVertexBuffer(0, bindings.vertexBuffer, bindings.vertexStride, 0);
+	backend.SetIndexBuffer(bindings.indexBuffer, bindings.indexFormat, 0);
+	backend.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+	backend.SetInputLayout(bindings.inputLayout);
+	backend.SetVertexShader(bindings.vertexShader);
+	backend.SetVertexConstantBuffer(0, bindings.frameConstantBuffer);
+	backend.SetVertexConstantBuffer(1, bindings.objectConstantBuffer);
+	backend.SetPixelShader(bindings.pixelShader);
+
+	backend.DrawIndexed(bindings.indexCount, 0, 0);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+
+#include "RenderBackend.h"
+#include "SimMath.h"
+#include "TransformBatch.h"
+
+namespace DirectX11_Game
+{
+	//Per-instance stream entry, the transposed model matrix split over four
+	//INSTANCEMODEL rows in the input layout.
+	struct InstanceData
+	{
+		SimMath::Float4x4 model;
+	};
+
+	//Everything needed to draw the cube mesh, the instance buffer is only used
+	//by InstanceBatch::Submit.
+	struct InstanceDrawBindings
+	{
+		void* vertexBuffer;
+		unsigned int vertexStride;
+		void* indexBuffer;
+		IndexFormat indexFormat;
+		unsigned int indexCount;
+		void* inputLayout;
+		void* vertexShader;
+		void* pixelShader;
+
+		//view and projection in slot 0, written by the caller only when they change
+		void* frameConstantBuffer;
+
+		//model matrix in slot 1, only used by SubmitSingle
+		void* objectConstantBuffer;
+		unsigned int objectConstantsSize;
+
+		//dynamic vertex buffer the instances are written into, the input layout
+		//and vertex shader have to match whichever of Pack or PackCompact was used
+		void* instanceBuffer;
+		unsigned int instanceCapacity;
+	};
+
+	//Packs all of the per-cell transforms into one contiguous instance stream so
+	//the whole grid goes out in a single upload and a single DrawIndexedInstanced.
+	class InstanceBatch
+	{
+	public:
+		InstanceBatch();
+
+		void Pack(const SimMath::Float4x4* models, int count);
+
+		//position, yaw and scale per cube instead of the full matrix, the vertex
+		//shader expands them so only 20 of the 64 bytes go over the bus
+		void PackCompact(const TransformBatch::Inputs& transforms, int count);
+
+		//the same, but only the cells in the index list, the visible ones after culling.
+		//For a chunk of a bigger grid the indices are the grid's and the models or
+		//transforms start at firstCell.
+		void Pack(const SimMath::Float4x4* models, const int* indices, int count, int firstCell = 0);
+		void PackCompact(const TransformBatch::Inputs& transforms, const int* indices, int count, int firstCell = 0);
+
+		//uploads and draws the packed instances, only splits into more than one
+		//draw when the instance buffer is smaller than the batch
+		void Submit(RenderBackend& backend, const InstanceDrawBindings& bindings) const;
+
+		//Resident batches keep every cell in a default usage instance buffer between
+		//frames, in cell order, so only the ranges that changed are copied and
+		//uploaded. The buffer has to hold the whole grid. Anything that breaks the
+		//mirror (a Pack, a new count, switching format) uploads everything once.
+		//For a chunk of a bigger grid the changed ranges are the grid's, only the
+		//part from firstCell to firstCell + count is taken.
+		void UpdateResident(const SimMath::Float4x4* models, int count, const std::vector<CellRange>& changed, int firstCell = 0);
+		void UpdateResidentCompact(const TransformBatch::Inputs& transforms, int count, const std::vector<CellRange>& changed, int firstCell = 0);
+
+		//uploads what changed and draws the visible cells, or all of them when visible
+		//is null. Visible cells less than RESIDENT_RUN_GAP apart share a draw. The
+		//visible list is the grid's, only the chunk's own cells are drawn.
+		void SubmitResident(RenderBackend& backend, const InstanceDrawBindings& bindings, const std::vector<int>* visible, int firstCell = 0);
+		//room for this many instances in one format and this many changed ranges a
+		//frame, so packing and resident updates never allocate once the batch is
+		//in use, see GridSimulation::GetDirtyRangeLimit
+		void Reserve(int instanceCount, bool compact, int rangeCount);
+		//the next resident update copies and uploads everything, for when updates were skipped
+		void Invalidate() { m_resident = false; }
+
+		//uploads one cube's model constants and draws it, the way the renderer did before instancing
+		static void SubmitSingle(RenderBackend& backend, const InstanceDrawBindings& bindings, const void* constants);
+
+		int GetInstanceCount() const;
+		unsigned int GetInstanceStride() const;
+		bool IsCompact() const { return m_compact; }
+		const InstanceData* GetInstances() const { return m_instances.data(); }
+		const CompactInstance* GetCompactInstances() const { return m_compactInstances.data(); }
+
+		static const int RESIDENT_RUN_GAP = 32;
+
+	private:
+		void BindInstanced(RenderBackend& backend, const InstanceDrawBindings& bindings) const;
+		//true when the mirror can take just the changed ranges
+		bool BeginResident(bool compact, int count);
+		//the changed ranges that fall in this batch's cells, moved to start at 0
+		const std::vector<CellRange>& LocalRanges(const std::vector<CellRange>& changed, int count, int firstCell);
+		//queues a range for the next SubmitResident, one over the whole batch replaces the rest
+		void AddPendingUpload(const CellRange& range, int count);
+
+		bool m_compact;
+		bool m_resident;
+		std::vector<CellRange> m_pendingUploads;
+		std::vector<CellRange> m_localRanges;
+		std::vector<InstanceData> m_instances;
+		std::vector<CompactInstance> m_compactInstances;
+	};
+}
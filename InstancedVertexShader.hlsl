@@ -0,0 +1,41 @@
+// Same as GridVertexShader, except the model matrix comes from the per-instance
+// stream in slot 1 instead of a constant buffer, so the whole grid is one draw.
+cbuffer ViewProjectionConstantBuffer : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 color : COLOR0;
+	// rows of the transposed model matrix, as written by InstanceBatch
+	float4 model0 : INSTANCEMODEL0;
+	float4 model1 : INSTANCEMODEL1;
+	float4 model2 : INSTANCEMODEL2;
+	float4 model3 : INSTANCEMODEL3;
+};
+
+struct PixelShaderInput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+};
+
+PixelShaderInput main(VertexShaderInput input)
+{
+	PixelShaderInput output;
+	float4 pos = float4(input.pos, 1.0f);
+
+	// the stream holds the transpose, so the instance matrix goes on the left
+	float4x4 instanceModel = float4x4(input.model0, input.model1, input.model2, input.model3);
+	pos = mul(instanceModel, pos);
+	pos = mul(pos, view);
+	pos = mul(pos, projection);
+	output.pos = pos;
+
+	output.color = input.color;
+
+	return output;
+}
@@ -0,0 +1,120 @@
+﻿//Runs a recorded session again without a window, every input on the step it
+//was applied on, and checks the grid comes out the same as it did live.
+//
+//	JournalReplay journal [--workers count] [--slowest count]
+//
+//The steps run back to back on this thread, so the timings are the simulation
+//alone with nothing else competing for it. Reports the average and spread of a
+//step and the --slowest steps with the inputs that went into them. The run
+//fails when the checksum after the last step isn't the one the journal was
+//closed with, the worker count makes no difference to it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "InputJournal.h"
+#include "SimulationThread.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	struct StepTime
+	{
+		int step;
+		int inputs;
+		double ms;
+	};
+
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: JournalReplay journal [--workers count] [--slowest count]\n");
+		return 1;
+	}
+
+	const char* path = argv[1];
+	int workers = 0;
+	int slowestCount = 5;
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--workers") == 0)
+			workers = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--slowest") == 0)
+			slowestCount = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	InputJournal journal;
+	if (!journal.Load(path))
+		return 1;
+
+	const InputJournal::Header& header = journal.GetHeader();
+	const std::vector<InputJournal::Record>& records = journal.GetRecords();
+	if (header.columns < 4 || header.rows < 4 || journal.GetStepCount() < 1)
+	{
+		fprintf(stderr, "%s has no steps to replay\n", path);
+		return 1;
+	}
+
+	SimulationThread thread(header.columns, header.rows, header.stepSeconds);
+	thread.SetWorkerCount(workers);
+
+	std::vector<StepTime> times;
+	times.reserve(journal.GetStepCount());
+	size_t next = 0;
+	for (int step = 1; step <= journal.GetStepCount(); step++)
+	{
+		int inputs = 0;
+		for (; next < records.size() && records[next].step == step; next++, inputs++)
+			thread.Replay(records[next]);
+
+		auto start = std::chrono::steady_clock::now();
+		thread.Step();
+		times.push_back({ step, inputs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() });
+	}
+
+	uint64_t checksum = thread.GetChecksum();
+	bool matched = checksum == journal.GetChecksum();
+
+	std::vector<double> sorted;
+	sorted.reserve(times.size());
+	double totalMs = 0;
+	for (const StepTime& time : times)
+	{
+		sorted.push_back(time.ms);
+		totalMs += time.ms;
+	}
+	std::sort(sorted.begin(), sorted.end());
+
+	printf("journal     %s, %zu inputs over %d steps\n", path, records.size(), journal.GetStepCount());
+	printf("grid        %d x %d (%d cells), %.4f s steps\n", header.columns, header.rows, header.columns * header.rows, header.stepSeconds);
+	printf("workers     %d\n", workers);
+	printf("total       %.3f ms\n", totalMs);
+	printf("step        %.3f ms average, %.3f p50, %.3f p95, %.3f p99, %.3f worst\n", totalMs / times.size(),
+		Percentile(sorted, 0.5), Percentile(sorted, 0.95), Percentile(sorted, 0.99), sorted.back());
+
+	std::sort(times.begin(), times.end(), [](const StepTime& a, const StepTime& b) { return a.ms > b.ms; });
+	for (int i = 0; i < slowestCount && i < static_cast<int>(times.size()); i++)
+		printf("  step %6d %9.3f ms, %d inputs\n", times[i].step, times[i].ms, times[i].inputs);
+
+	printf("checksum    %016llx, recorded %016llx%s\n", static_cast<unsigned long long>(checksum),
+		static_cast<unsigned long long>(journal.GetChecksum()), matched ? "" : " FAIL");
+	return matched ? 0 : 1;
+}
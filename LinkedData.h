@@ -1,70 +1,150 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Ordered list of pointers. Nodes live in one pooled array and are linked by
+//index, a treap ordered by the order value keeps AddOrdered at O(log n) and a
+//second set of links threads the nodes in order so walking them is a straight
+//loop. Add puts a value after everything already in the list, AddOrdered puts
+//it after every value with an order less than or equal to its own.
 template<class T>
 class LinkedData {
-	LinkedData* next;
-	LinkedData* prev;
+	static const int NONE = -1;
+
+	struct Node
+	{
+		T* data;
+		float order;
+		uint32_t priority;
+		int left;
+		int right;
+		//the next node in order, for iterating without walking the tree
+		int next;
+	};
+
 public:
+	class Iterator
+	{
+	public:
+		Iterator(const Node* nodes, int index) : m_nodes(nodes), m_index(index) {}
+		T* operator*() const { return m_nodes[m_index].data; }
+		Iterator& operator++() { m_index = m_nodes[m_index].next; return *this; }
+		bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+		bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+	private:
+		const Node* m_nodes;
+		int m_index;
+	};
+
 	bool empty;
-	LinkedData() { empty = true; };
-	LinkedData(T* value) { data = reinterpret_cast<T*>(value); empty = false; };
+	LinkedData() : empty(true), m_root(NONE), m_head(NONE), m_seed(0x9E3779B9u), m_maxOrder(0) {};
+	LinkedData(T* value) : LinkedData() { Add(value); };
+
 	void Add(T* value)
 	{
-		if (empty == true)
-		{
-			data = reinterpret_cast<T*>(value);
-			empty = false;
-		}
-		else
-		{
-			if (next == nullptr)
-			{
-				next = new LinkedData<T>(value);
-				next->prev = this;
-			}
-			else
-				next->Add(value);
-		}
+		//ties go after the values already there, so the largest order keeps it last
+		float order = m_nodes.empty() ? 0.0f : m_maxOrder;
+		Insert(value, order);
 	};
 	void AddOrdered(T* value, float order)
 	{
-		if (empty == true)
+		Insert(value, order);
+	};
+
+	//room for count values without the pool growing
+	void Reserve(size_t count) { m_nodes.reserve(count); }
+	void Clear()
+	{
+		m_nodes.clear();
+		m_root = NONE;
+		m_head = NONE;
+		empty = true;
+	}
+
+	size_t Size() const { return m_nodes.size(); }
+	Iterator begin() const { return Iterator(m_nodes.data(), m_head); }
+	Iterator end() const { return Iterator(m_nodes.data(), NONE); }
+
+	std::wstring ToString() const
+	{
+		std::wstring result;
+		for (int i = m_head; i != NONE; i = m_nodes[i].next)
 		{
-			data = reinterpret_cast<T*>(value);
-			empty = false;
-			return;
+			if (i != m_head)
+				result += L' ';
+			result += std::to_wstring(*m_nodes[i].data);
 		}
+		return result;
+	}
+private:
+	void Insert(T* value, float order)
+	{
+		if (m_nodes.empty() || order > m_maxOrder)
+			m_maxOrder = order;
+
+		//xorshift, only has to keep the tree balanced
+		m_seed ^= m_seed << 13;
+		m_seed ^= m_seed >> 17;
+		m_seed ^= m_seed << 5;
+
+		int index = static_cast<int>(m_nodes.size());
+		m_nodes.push_back({ value, order, m_seed, NONE, NONE, NONE });
+
+		int predecessor = NONE;
+		m_root = InsertNode(m_root, index, predecessor);
 
-		LinkedData<T> newNode = new LinkedData<T>(value);
-		//put this reference after the previous value
-		if (prev->order < order) 
+		//thread the new node in straight after the last one the search passed on its left
+		if (predecessor == NONE)
 		{
-			if (next == nullptr)
-			{
-				next = newNode;
-				next->prev = this;
-			}
-			else
-				next->Add(value);
+			m_nodes[index].next = m_head;
+			m_head = index;
 		}
-		//assign the previous value to the current one
-		else 
+		else
 		{
-			prev->prev = newNode; //remove association to previous
-			newNode.next = prev; //attach previous to next 
+			m_nodes[index].next = m_nodes[predecessor].next;
+			m_nodes[predecessor].next = index;
 		}
+		empty = false;
+	}
 
-		newNode->order = order;
-	};
-
-	std::wstring ToString() 
+	//returns the new root of the subtree, rotating the new node up while its priority is higher
+	int InsertNode(int root, int index, int& predecessor)
 	{
-		if (next != nullptr)
-			return std::to_wstring(*data) + L" " + next->ToString();
+		if (root == NONE)
+			return index;
 
-		return std::to_wstring(*data);
+		//an equal order goes to the right, after the values that were there first
+		if (m_nodes[index].order < m_nodes[root].order)
+		{
+			int child = InsertNode(m_nodes[root].left, index, predecessor);
+			m_nodes[root].left = child;
+			if (m_nodes[child].priority > m_nodes[root].priority)
+			{
+				m_nodes[root].left = m_nodes[child].right;
+				m_nodes[child].right = root;
+				return child;
+			}
+		}
+		else
+		{
+			predecessor = root;
+			int child = InsertNode(m_nodes[root].right, index, predecessor);
+			m_nodes[root].right = child;
+			if (m_nodes[child].priority > m_nodes[root].priority)
+			{
+				m_nodes[root].right = m_nodes[child].left;
+				m_nodes[child].left = root;
+				return child;
+			}
+		}
+		return root;
 	}
-private:
-	T* data;
-	float order;
-};
\ No newline at end of file
+
+	std::vector<Node> m_nodes;
+	int m_root;
+	int m_head;
+	uint32_t m_seed;
+	float m_maxOrder;
+};
@@ -0,0 +1,173 @@
+﻿//Benchmark for LinkedData against the one node per element list it replaced,
+//appending, ordered inserts, walking in order and ToString at each size, with
+//the ordered results checked against a stable sort.
+//
+//	LinkedDataBench [--max count]
+//
+//The old list is quadratic and recurses once per element, so it is only run
+//up to OLD_LIST_LIMIT elements.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "LinkedData.h"
+
+namespace
+{
+	const int OLD_LIST_LIMIT = 10000;
+
+	//The list as it was, with the pointers initialised so it runs at all.
+	//AddOrdered is left out because it never compiled.
+	template<class T>
+	class OldLinkedData {
+		OldLinkedData* next;
+		OldLinkedData* prev;
+	public:
+		bool empty;
+		OldLinkedData() : next(nullptr), prev(nullptr), data(nullptr) { empty = true; };
+		OldLinkedData(T* value) : next(nullptr), prev(nullptr) { data = reinterpret_cast<T*>(value); empty = false; };
+		~OldLinkedData()
+		{
+			//iterative, the default recursion would be as deep as the list
+			OldLinkedData* node = next;
+			while (node)
+			{
+				OldLinkedData* following = node->next;
+				node->next = nullptr;
+				delete node;
+				node = following;
+			}
+		}
+		void Add(T* value)
+		{
+			if (empty == true)
+			{
+				data = reinterpret_cast<T*>(value);
+				empty = false;
+			}
+			else
+			{
+				if (next == nullptr)
+				{
+					next = new OldLinkedData<T>(value);
+					next->prev = this;
+				}
+				else
+					next->Add(value);
+			}
+		};
+
+		std::wstring ToString()
+		{
+			if (next != nullptr)
+				return std::to_wstring(*data) + L" " + next->ToString();
+
+			return std::to_wstring(*data);
+		}
+	private:
+		T* data;
+	};
+
+	double Milliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int maxCount = 1000000;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--max") == 0)
+			maxCount = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	printf("%9s %-8s %12s %12s %12s %12s %s\n", "count", "list", "add ms", "ordered ms", "walk ms", "string ms", "result");
+
+	int failures = 0;
+	for (int count = 1000; count <= maxCount; count *= 10)
+	{
+		std::vector<int> values(count);
+		std::iota(values.begin(), values.end(), 0);
+
+		//few distinct orders so ties have to keep their insertion order
+		std::mt19937 random(count);
+		std::vector<float> orders(count);
+		for (float& order : orders)
+			order = static_cast<float>(random() % (count / 4 + 1));
+
+		if (count <= OLD_LIST_LIMIT)
+		{
+			auto start = std::chrono::steady_clock::now();
+			OldLinkedData<int> old;
+			for (int& value : values)
+				old.Add(&value);
+			double addMs = Milliseconds(start);
+
+			start = std::chrono::steady_clock::now();
+			std::wstring text = old.ToString();
+			double stringMs = Milliseconds(start);
+
+			printf("%9d %-8s %12.3f %12s %12s %12.3f %zu chars\n", count, "old", addMs, "-", "-", stringMs, text.size());
+		}
+		else
+		{
+			printf("%9d %-8s %12s %12s %12s %12s %s\n", count, "old", "-", "-", "-", "-", "skipped, quadratic");
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		LinkedData<int> appended;
+		for (int& value : values)
+			appended.Add(&value);
+		double addMs = Milliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		LinkedData<int> ordered;
+		for (int i = 0; i < count; i++)
+			ordered.AddOrdered(&values[i], orders[i]);
+		double orderedMs = Milliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		long long sum = 0;
+		for (int* value : ordered)
+			sum += *value;
+		double walkMs = Milliseconds(start);
+
+		start = std::chrono::steady_clock::now();
+		std::wstring text = ordered.ToString();
+		double stringMs = Milliseconds(start);
+
+		//appends come back as they went in, ordered inserts as a stable sort by order
+		std::vector<int> expected(values);
+		std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) { return orders[a] < orders[b]; });
+
+		bool matches = static_cast<int>(ordered.Size()) == count && sum == static_cast<long long>(count) * (count - 1) / 2;
+		int position = 0;
+		for (int* value : appended)
+			matches = matches && *value == position++;
+		position = 0;
+		for (int* value : ordered)
+			matches = matches && *value == expected[position++];
+		if (!matches)
+			failures++;
+
+		printf("%9d %-8s %12.3f %12.3f %12.3f %12.3f %s\n", count, "pooled", addMs, orderedMs, walkMs, stringMs,
+			matches ? "in order" : "WRONG ORDER");
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+﻿//Microbenchmark for the mandlebrot escape kernel, runs the same grid through
+//every instruction set the cpu supports, checks each one against the scalar
+//loop and reports cells per second.
+//
+//	MandelbrotBench [--grid side] [--repeat count]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "MandelbrotKernel.h"
+
+using namespace DirectX11_Game;
+
+int main(int argc, char** argv)
+{
+	int gridSide = 512;
+	int repeat = 20;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--grid") == 0)
+			gridSide = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--repeat") == 0)
+			repeat = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (gridSide < 4 || repeat < 1)
+	{
+		fprintf(stderr, "grid must be at least 4 and repeat at least 1\n");
+		return 1;
+	}
+
+	//same coordinates and scales the simulation uses for a grid this size
+	int modAmount = gridSide;
+	int halfModAmount = modAmount >> 1;
+	float xScale = 0.45f / (modAmount >> 2);
+	float yScale = 0.25f / (modAmount >> 2);
+
+	int cells = gridSide * gridSide;
+	std::vector<int> x(cells);
+	std::vector<int> y(cells);
+	for (int i = 0; i < cells; i++)
+	{
+		x[i] = modAmount - ((i % gridSide) - halfModAmount);
+		y[i] = modAmount - ((i / gridSide) - halfModAmount);
+	}
+
+	std::vector<int> expected(cells);
+	for (int i = 0; i < cells; i++)
+		expected[i] = MandelbrotKernel::EscapeCount(x[i], y[i], xScale, yScale, halfModAmount);
+
+	printf("grid %d x %d, %d iterations max\n", gridSide, gridSide, halfModAmount);
+	printf("%-8s %6s %14s %10s %s\n", "isa", "lanes", "cells/sec", "speedup", "result");
+
+	double scalarRate = 0;
+	int failures = 0;
+	std::vector<int> counts(cells);
+	for (int isa = MandelbrotKernel::Scalar; isa < MandelbrotKernel::IsaCount; isa++)
+	{
+		MandelbrotKernel::Isa kernelIsa = static_cast<MandelbrotKernel::Isa>(isa);
+		if (!MandelbrotKernel::IsSupported(kernelIsa))
+		{
+			printf("%-8s %6s %14s %10s %s\n", MandelbrotKernel::GetIsaName(kernelIsa), "-", "-", "-", "unsupported");
+			continue;
+		}
+
+		MandelbrotKernel kernel(kernelIsa);
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeat; r++)
+			kernel.EscapeCounts(x.data(), y.data(), counts.data(), cells, xScale, yScale, halfModAmount);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool matches = memcmp(counts.data(), expected.data(), sizeof(int) * cells) == 0;
+		if (!matches)
+			failures++;
+
+		double rate = static_cast<double>(cells) * repeat / seconds;
+		if (kernelIsa == MandelbrotKernel::Scalar)
+			scalarRate = rate;
+
+		printf("%-8s %6d %14.0f %9.2fx %s\n", MandelbrotKernel::GetIsaName(kernelIsa), kernel.GetLaneCount(),
+			rate, scalarRate > 0 ? rate / scalarRate : 0.0, matches ? "exact" : "MISMATCH");
+	}
+
+	return failures == 0 ? 0 : 1;
+}
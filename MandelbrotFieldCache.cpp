@@ -0,0 +1,154 @@
+﻿#include "MandelbrotFieldCache.h"
+
+#include <algorithm>
+
+using namespace DirectX11_Game;
+
+MandelbrotFieldCache::MandelbrotFieldCache() :
+	m_key(),
+	m_valid(false),
+	m_minX(0),
+	m_minY(0),
+	m_width(0),
+	m_height(0),
+	m_hits(0),
+	m_misses(0),
+	m_shifts(0),
+	m_cellsComputed(0),
+	m_cellsReused(0)
+{
+}
+
+void MandelbrotFieldCache::ResetCounters()
+{
+	m_hits = 0;
+	m_misses = 0;
+	m_shifts = 0;
+	m_cellsComputed = 0;
+	m_cellsReused = 0;
+}
+
+bool MandelbrotFieldCache::SameKey(const Key& key) const
+{
+	return m_key.cameraOffset.x == key.cameraOffset.x &&
+		m_key.cameraOffset.y == key.cameraOffset.y &&
+		m_key.cameraOffset.z == key.cameraOffset.z &&
+		m_key.xScale == key.xScale &&
+		m_key.yScale == key.yScale &&
+		m_key.maxIterations == key.maxIterations &&
+		m_key.columns == key.columns &&
+		m_key.rows == key.rows;
+}
+
+void MandelbrotFieldCache::Refresh(const Key& key, const int* columnX, const int* rowY)
+{
+	if (m_valid && SameKey(key))
+	{
+		m_hits++;
+		return;
+	}
+
+	//the offsets are truncated, so neighbouring columns can share a value, but the
+	//field is always one dense rectangle between the smallest and largest offsets
+	auto xRange = std::minmax_element(columnX, columnX + key.columns);
+	auto yRange = std::minmax_element(rowY, rowY + key.rows);
+	int minX = *xRange.first;
+	int maxX = *xRange.second;
+	int minY = *yRange.first;
+	int maxY = *yRange.second;
+
+	//anything still on screen can be reused as long as the set itself hasn't changed
+	bool sameSet = m_valid &&
+		m_key.xScale == key.xScale &&
+		m_key.yScale == key.yScale &&
+		m_key.maxIterations == key.maxIterations;
+	int overlapMinX = std::max(minX, m_minX);
+	int overlapMaxX = std::min(maxX, m_minX + m_width - 1);
+	int overlapMinY = std::max(minY, m_minY);
+	int overlapMaxY = std::min(maxY, m_minY + m_height - 1);
+	bool overlaps = sameSet && overlapMinX <= overlapMaxX && overlapMinY <= overlapMaxY;
+
+	m_previousField.swap(m_field);
+	int previousMinX = m_minX;
+	int previousMinY = m_minY;
+	int previousWidth = m_width;
+
+	m_minX = minX;
+	m_minY = minY;
+	m_width = maxX - minX + 1;
+	m_height = maxY - minY + 1;
+	m_field.resize(static_cast<size_t>(m_width) * m_height);
+
+	if (overlaps)
+	{
+		m_shifts++;
+		for (int y = overlapMinY; y <= overlapMaxY; y++)
+		{
+			const int* source = &m_previousField[static_cast<size_t>(y - previousMinY) * previousWidth + (overlapMinX - previousMinX)];
+			int* destination = &m_field[static_cast<size_t>(y - m_minY) * m_width + (overlapMinX - m_minX)];
+			std::copy(source, source + (overlapMaxX - overlapMinX + 1), destination);
+		}
+		m_cellsReused += static_cast<unsigned long long>(overlapMaxX - overlapMinX + 1) * (overlapMaxY - overlapMinY + 1);
+
+		//only the strips around the kept rectangle are new
+		m_key = key;
+		if (minY < overlapMinY)
+			ComputeRect(minX, maxX, minY, overlapMinY - 1);
+		if (maxY > overlapMaxY)
+			ComputeRect(minX, maxX, overlapMaxY + 1, maxY);
+		if (minX < overlapMinX)
+			ComputeRect(minX, overlapMinX - 1, overlapMinY, overlapMaxY);
+		if (maxX > overlapMaxX)
+			ComputeRect(overlapMaxX + 1, maxX, overlapMinY, overlapMaxY);
+	}
+	else
+	{
+		m_misses++;
+		m_key = key;
+		ComputeRect(minX, maxX, minY, maxY);
+	}
+
+	m_columnStart.resize(key.columns);
+	for (int column = 0; column < key.columns; column++)
+		m_columnStart[column] = columnX[column] - m_minX;
+
+	m_rowStart.resize(key.rows);
+	for (int row = 0; row < key.rows; row++)
+		m_rowStart[row] = (rowY[row] - m_minY) * m_width;
+
+	m_valid = true;
+}
+
+//runs one rectangle of the field through the kernel as a single batch
+void MandelbrotFieldCache::ComputeRect(int minX, int maxX, int minY, int maxY)
+{
+	int width = maxX - minX + 1;
+	int count = width * (maxY - minY + 1);
+	m_batchX.resize(count);
+	m_batchY.resize(count);
+	m_batchCounts.resize(count);
+
+	int i = 0;
+	for (int y = minY; y <= maxY; y++)
+	{
+		for (int x = minX; x <= maxX; x++)
+		{
+			m_batchX[i] = x;
+			m_batchY[i] = y;
+			i++;
+		}
+	}
+
+	m_kernel.EscapeCounts(m_batchX.data(), m_batchY.data(), m_batchCounts.data(), count,
+		m_key.xScale, m_key.yScale, m_key.maxIterations);
+
+	i = 0;
+	for (int y = minY; y <= maxY; y++)
+	{
+		int* destination = &m_field[static_cast<size_t>(y - m_minY) * m_width + (minX - m_minX)];
+		std::copy(&m_batchCounts[i], &m_batchCounts[i] + width, destination);
+		i += width;
+	}
+
+	m_cellsComputed += count;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+#include "MandelbrotKernel.h"
+#include "SimMath.h"
+
+namespace DirectX11_Game
+{
+	//Keeps the mandlebrot escape field for the cells on screen between ticks.
+	//The field only depends on the camera offset and the scales, so while those
+	//stay put every lookup is served from the cache. When the view pans by whole
+	//cells the overlapping part of the field is kept and only the newly exposed
+	//strip goes through the kernel.
+	class MandelbrotFieldCache
+	{
+	public:
+		struct Key
+		{
+			SimMath::Float3 cameraOffset;
+			float xScale;
+			float yScale;
+			int maxIterations;
+			int columns;
+			int rows;
+		};
+
+		MandelbrotFieldCache();
+
+		// columnX	- whole cell x offset passed to the kernel for each column of the grid
+		// rowY		- whole cell y offset passed to the kernel for each row of the grid
+		void Refresh(const Key& key, const int* columnX, const int* rowY);
+
+		//escape count for a cell, by grid column and row starting at 0
+		int At(int column, int row) const { return m_field[m_rowStart[row] + m_columnStart[column]]; }
+
+		void ResetCounters();
+
+		//Refresh calls that found the field already current
+		unsigned long long GetHits() const { return m_hits; }
+		//Refresh calls that had to rebuild the whole field
+		unsigned long long GetMisses() const { return m_misses; }
+		//Refresh calls that kept part of the field and filled in the rest
+		unsigned long long GetShifts() const { return m_shifts; }
+		unsigned long long GetCellsComputed() const { return m_cellsComputed; }
+		unsigned long long GetCellsReused() const { return m_cellsReused; }
+
+		//bytes held by the field and the buffers used to fill it
+		size_t GetMemoryBytes() const
+		{
+			return (m_field.capacity() + m_previousField.capacity() + m_columnStart.capacity() + m_rowStart.capacity() +
+				m_batchX.capacity() + m_batchY.capacity() + m_batchCounts.capacity()) * sizeof(int);
+		}
+
+	private:
+		bool SameKey(const Key& key) const;
+		void ComputeRect(int minX, int maxX, int minY, int maxY);
+
+		MandelbrotKernel m_kernel;
+		Key m_key;
+		bool m_valid;
+
+		//the field covers [m_minX, m_minX + m_width) by [m_minY, m_minY + m_height)
+		int m_minX;
+		int m_minY;
+		int m_width;
+		int m_height;
+		std::vector<int> m_field;
+		std::vector<int> m_previousField;
+
+		//offsets into m_field for each grid column and row
+		std::vector<int> m_columnStart;
+		std::vector<int> m_rowStart;
+
+		//batch buffers for the cells that need computing
+		std::vector<int> m_batchX;
+		std::vector<int> m_batchY;
+		std::vector<int> m_batchCounts;
+
+		unsigned long long m_hits;
+		unsigned long long m_misses;
+		unsigned long long m_shifts;
+		unsigned long long m_cellsComputed;
+		unsigned long long m_cellsReused;
+	};
+}
@@ -0,0 +1,366 @@
+﻿#include "MandelbrotKernel.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MANDELBROT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//gcc and clang only emit wider instructions inside functions marked for them,
+//msvc accepts the intrinsics anywhere
+#if defined(MANDELBROT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MANDELBROT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MANDELBROT_TARGET(isa)
+#endif
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	//https://www.geeksforgeeks.org/fractals-in-cc/
+	//left = -1.75; top = -0.25;
+	const float LEFT = -1.75f;
+	const float TOP = -0.25f;
+	const float ESCAPE = 4.0f;
+
+	void ScalarBatch(const int* x, const int* y, int* counts, int count, float xScale, float yScale, int maxIterations)
+	{
+		for (int i = 0; i < count; i++)
+			counts[i] = MandelbrotKernel::EscapeCount(x[i], y[i], xScale, yScale, maxIterations);
+	}
+
+	//the last partial batch is run through the vector path on a padded copy
+	template<int Lanes, typename Step>
+	void RunTail(const int* x, const int* y, int* counts, int remaining, Step step)
+	{
+		if (remaining <= 0)
+			return;
+
+		int paddedX[Lanes];
+		int paddedY[Lanes];
+		int paddedCounts[Lanes];
+		for (int lane = 0; lane < Lanes; lane++)
+		{
+			int source = lane < remaining ? lane : 0;
+			paddedX[lane] = x[source];
+			paddedY[lane] = y[source];
+		}
+		step(paddedX, paddedY, paddedCounts);
+		for (int lane = 0; lane < remaining; lane++)
+			counts[lane] = paddedCounts[lane];
+	}
+
+#if defined(MANDELBROT_X86)
+	//4 cells per pass, sse2 is always there on x64
+	void Sse2Step(const int* x, const int* y, int* counts, float xScale, float yScale, int maxIterations)
+	{
+		const __m128 four = _mm_set1_ps(ESCAPE);
+		__m128 cx = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(x))), _mm_set1_ps(xScale)), _mm_set1_ps(LEFT));
+		__m128 cy = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y))), _mm_set1_ps(yScale)), _mm_set1_ps(TOP));
+		__m128 zx = _mm_setzero_ps();
+		__m128 zy = _mm_setzero_ps();
+		__m128i iterations = _mm_setzero_si128();
+		__m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (int i = 0; i < maxIterations; i++)
+		{
+			__m128 zx2 = _mm_mul_ps(zx, zx);
+			__m128 zy2 = _mm_mul_ps(zy, zy);
+			//a lane stops once it reaches the escape radius, NaN keeps going like the scalar compare
+			active = _mm_andnot_ps(_mm_cmpge_ps(_mm_add_ps(zx2, zy2), four), active);
+			if (_mm_movemask_ps(active) == 0)
+				break;
+
+			//active lanes are all ones, subtracting them counts the iteration
+			iterations = _mm_sub_epi32(iterations, _mm_castps_si128(active));
+
+			__m128 tempx = _mm_add_ps(_mm_sub_ps(zx2, zy2), cx);
+			zy = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), zx), zy), cy);
+			zx = tempx;
+		}
+
+		//count is the last iteration run, -2 when none ran
+		__m128i none = _mm_cmpeq_epi32(iterations, _mm_setzero_si128());
+		__m128i last = _mm_sub_epi32(iterations, _mm_set1_epi32(1));
+		__m128i result = _mm_or_si128(_mm_and_si128(none, _mm_set1_epi32(-2)), _mm_andnot_si128(none, last));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(counts), result);
+	}
+
+	void Sse2Batch(const int* x, const int* y, int* counts, int count, float xScale, float yScale, int maxIterations)
+	{
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+			Sse2Step(x + i, y + i, counts + i, xScale, yScale, maxIterations);
+
+		RunTail<4>(x + i, y + i, counts + i, count - i, [&](const int* px, const int* py, int* pc)
+			{
+				Sse2Step(px, py, pc, xScale, yScale, maxIterations);
+			});
+	}
+
+	//8 cells per pass
+	MANDELBROT_TARGET("avx2")
+	void Avx2Step(const int* x, const int* y, int* counts, float xScale, float yScale, int maxIterations)
+	{
+		const __m256 four = _mm256_set1_ps(ESCAPE);
+		__m256 cx = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(x))), _mm256_set1_ps(xScale)), _mm256_set1_ps(LEFT));
+		__m256 cy = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(y))), _mm256_set1_ps(yScale)), _mm256_set1_ps(TOP));
+		__m256 zx = _mm256_setzero_ps();
+		__m256 zy = _mm256_setzero_ps();
+		__m256i iterations = _mm256_setzero_si256();
+		__m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (int i = 0; i < maxIterations; i++)
+		{
+			__m256 zx2 = _mm256_mul_ps(zx, zx);
+			__m256 zy2 = _mm256_mul_ps(zy, zy);
+			active = _mm256_andnot_ps(_mm256_cmp_ps(_mm256_add_ps(zx2, zy2), four, _CMP_GE_OQ), active);
+			if (_mm256_movemask_ps(active) == 0)
+				break;
+
+			iterations = _mm256_sub_epi32(iterations, _mm256_castps_si256(active));
+
+			__m256 tempx = _mm256_add_ps(_mm256_sub_ps(zx2, zy2), cx);
+			zy = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), zx), zy), cy);
+			zx = tempx;
+		}
+
+		__m256i none = _mm256_cmpeq_epi32(iterations, _mm256_setzero_si256());
+		__m256i last = _mm256_sub_epi32(iterations, _mm256_set1_epi32(1));
+		__m256i result = _mm256_blendv_epi8(last, _mm256_set1_epi32(-2), none);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(counts), result);
+	}
+
+	MANDELBROT_TARGET("avx2")
+	void Avx2Batch(const int* x, const int* y, int* counts, int count, float xScale, float yScale, int maxIterations)
+	{
+		int i = 0;
+		for (; i + 8 <= count; i += 8)
+			Avx2Step(x + i, y + i, counts + i, xScale, yScale, maxIterations);
+
+		RunTail<8>(x + i, y + i, counts + i, count - i, [&](const int* px, const int* py, int* pc)
+			{
+				Avx2Step(px, py, pc, xScale, yScale, maxIterations);
+			});
+	}
+
+	//gcc 12 expands _mm512_cvtepi32_ps through _mm512_undefined_ps and then warns
+	//that the undefined register it made on purpose is uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+	//16 cells per pass, lanes are tracked in a mask register
+	MANDELBROT_TARGET("avx512f")
+	void Avx512Step(const int* x, const int* y, int* counts, float xScale, float yScale, int maxIterations)
+	{
+		const __m512 four = _mm512_set1_ps(ESCAPE);
+		const __m512i one = _mm512_set1_epi32(1);
+		__m512 cx = _mm512_add_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_loadu_si512(x)), _mm512_set1_ps(xScale)), _mm512_set1_ps(LEFT));
+		__m512 cy = _mm512_add_ps(_mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_loadu_si512(y)), _mm512_set1_ps(yScale)), _mm512_set1_ps(TOP));
+		__m512 zx = _mm512_setzero_ps();
+		__m512 zy = _mm512_setzero_ps();
+		__m512i iterations = _mm512_setzero_si512();
+		__mmask16 active = 0xFFFF;
+
+		for (int i = 0; i < maxIterations; i++)
+		{
+			__m512 zx2 = _mm512_mul_ps(zx, zx);
+			__m512 zy2 = _mm512_mul_ps(zy, zy);
+			active = _mm512_mask_cmp_ps_mask(active, _mm512_add_ps(zx2, zy2), four, _CMP_NGE_UQ);
+			if (active == 0)
+				break;
+
+			iterations = _mm512_mask_add_epi32(iterations, active, iterations, one);
+
+			__m512 tempx = _mm512_add_ps(_mm512_sub_ps(zx2, zy2), cx);
+			zy = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(2.0f), zx), zy), cy);
+			zx = tempx;
+		}
+
+		__mmask16 none = _mm512_cmpeq_epi32_mask(iterations, _mm512_setzero_si512());
+		__m512i result = _mm512_mask_mov_epi32(_mm512_sub_epi32(iterations, one), none, _mm512_set1_epi32(-2));
+		_mm512_storeu_si512(counts, result);
+	}
+
+	MANDELBROT_TARGET("avx512f")
+	void Avx512Batch(const int* x, const int* y, int* counts, int count, float xScale, float yScale, int maxIterations)
+	{
+		int i = 0;
+		for (; i + 16 <= count; i += 16)
+			Avx512Step(x + i, y + i, counts + i, xScale, yScale, maxIterations);
+
+		RunTail<16>(x + i, y + i, counts + i, count - i, [&](const int* px, const int* py, int* pc)
+			{
+				Avx512Step(px, py, pc, xScale, yScale, maxIterations);
+			});
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#if defined(_MSC_VER)
+	bool CpuHasAvx2()
+	{
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		//the os has to save the ymm registers as well as the cpu supporting them
+		bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		return osSavesYmm && (info[1] & (1 << 5));
+	}
+
+	bool CpuHasAvx512()
+	{
+		if (!CpuHasAvx2())
+			return false;
+		int info[4];
+		__cpuidex(info, 7, 0);
+		bool osSavesZmm = (_xgetbv(0) & 0xE6) == 0xE6;
+		return osSavesZmm && (info[1] & (1 << 16));
+	}
+#else
+	bool CpuHasAvx2()
+	{
+		return __builtin_cpu_supports("avx2");
+	}
+
+	bool CpuHasAvx512()
+	{
+		return __builtin_cpu_supports("avx512f");
+	}
+#endif
+#endif
+}
+
+MandelbrotKernel::MandelbrotKernel() :
+	MandelbrotKernel(GetBestIsa())
+{
+}
+
+MandelbrotKernel::MandelbrotKernel(Isa isa) :
+	m_isa(IsSupported(isa) ? isa : Scalar),
+	m_batch(ScalarBatch)
+{
+#if defined(MANDELBROT_X86)
+	switch (m_isa)
+	{
+	case SSE2:
+		m_batch = Sse2Batch;
+		break;
+	case AVX2:
+		m_batch = Avx2Batch;
+		break;
+	case AVX512:
+		m_batch = Avx512Batch;
+		break;
+	default:
+		break;
+	}
+#endif
+}
+
+int MandelbrotKernel::GetLaneCount() const
+{
+	switch (m_isa)
+	{
+	case SSE2:
+		return 4;
+	case AVX2:
+		return 8;
+	case AVX512:
+		return 16;
+	default:
+		return 1;
+	}
+}
+
+void MandelbrotKernel::EscapeCounts(const int* x, const int* y, int* counts, int count,
+	float xScale, float yScale, int maxIterations) const
+{
+	m_batch(x, y, counts, count, xScale, yScale, maxIterations);
+}
+
+int MandelbrotKernel::EscapeCount(int x, int y, float xScale, float yScale, int maxIterations)
+{
+	float cx = x * xScale + LEFT;  // c_real
+	float cy = y * yScale + TOP;   // c_imaginary
+
+	float zx = 0;  // z_real
+	float zy = 0;  // z_imaginary
+
+	int count = -2;
+
+	// If you reach the Maximum number of iterations
+	// and If the distance from the origin is
+	// greater than 2 exit the loop
+	for (int i = 0; i < maxIterations; i++)
+	{
+		if (zx * zx + zy * zy >= ESCAPE)
+			break;
+
+		// z = z*z + c where z is a complex number
+		float tempx = zx * zx - zy * zy + cx;
+
+		zy = 2 * zx * zy + cy;
+
+		zx = tempx;
+		count = i;
+	}
+
+	return count;
+}
+
+bool MandelbrotKernel::IsSupported(Isa isa)
+{
+	switch (isa)
+	{
+	case Scalar:
+		return true;
+#if defined(MANDELBROT_X86)
+	case SSE2:
+		return true;
+	case AVX2:
+		return CpuHasAvx2();
+	case AVX512:
+		return CpuHasAvx512();
+#endif
+	default:
+		return false;
+	}
+}
+
+MandelbrotKernel::Isa MandelbrotKernel::GetBestIsa()
+{
+	if (IsSupported(AVX512))
+		return AVX512;
+	if (IsSupported(AVX2))
+		return AVX2;
+	if (IsSupported(SSE2))
+		return SSE2;
+	return Scalar;
+}
+
+const char* MandelbrotKernel::GetIsaName(Isa isa)
+{
+	switch (isa)
+	{
+	case Scalar:
+		return "scalar";
+	case SSE2:
+		return "sse2";
+	case AVX2:
+		return "avx2";
+	case AVX512:
+		return "avx512";
+	default:
+		return "unknown";
+	}
+}
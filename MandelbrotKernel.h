@@ -0,0 +1,45 @@
+#pragma once
+
+namespace DirectX11_Game
+{
+	//Escape time counts for the mandlebrot height mode, worked out for a batch
+	//of cells at once. The vector paths give the same counts as the scalar loop,
+	//lanes that escape early are masked off rather than branched on.
+	class MandelbrotKernel
+	{
+	public:
+		enum Isa
+		{
+			Scalar,
+			SSE2,
+			AVX2,
+			AVX512,
+			IsaCount
+		};
+
+		//picks the widest instruction set the cpu supports
+		MandelbrotKernel();
+		MandelbrotKernel(Isa isa);
+
+		Isa GetIsa() const { return m_isa; }
+		int GetLaneCount() const;
+
+		// x, y			- whole cell coordinates, scaled into the set by xScale and yScale
+		// counts		- receives the iteration the point escaped on, -2 if it never iterated
+		void EscapeCounts(const int* x, const int* y, int* counts, int count,
+			float xScale, float yScale, int maxIterations) const;
+
+		//the original per cell loop, every other path must match it exactly
+		static int EscapeCount(int x, int y, float xScale, float yScale, int maxIterations);
+
+		static bool IsSupported(Isa isa);
+		static Isa GetBestIsa();
+		static const char* GetIsaName(Isa isa);
+
+	private:
+		typedef void (*BatchFunction)(const int*, const int*, int*, int, float, float, int);
+
+		Isa m_isa;
+		BatchFunction m_batch;
+	};
+}
@@ -0,0 +1,140 @@
+﻿//Builds every MeshBuilder shape at a few tessellations and reports vertex
+//cache efficiency for the order the shape is generated in and after
+//MeshBuilder::Optimize, along with how long the optimisation took.
+//
+//	MeshBench [--cache size]
+//
+//Fails when an optimised mesh has a worse acmr than the generated order, when
+//a triangle faces inward, or when a mesh gets the wrong index size.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "MeshBuilder.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	struct Shape
+	{
+		std::string name;
+		std::function<Mesh(bool)> build;
+		//the plane is open, everything else is closed around the origin
+		bool closed;
+	};
+
+	//every triangle's cross product has to point into the shape, clockwise from outside
+	bool CheckWinding(const Mesh& mesh, bool closed)
+	{
+		for (int t = 0; t < mesh.GetTriangleCount(); t++)
+		{
+			const SimMath::Float3& a = mesh.vertices[mesh.indices[t * 3]].position;
+			const SimMath::Float3& b = mesh.vertices[mesh.indices[t * 3 + 1]].position;
+			const SimMath::Float3& c = mesh.vertices[mesh.indices[t * 3 + 2]].position;
+			float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+			float vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+			float nx = uy * vz - uz * vy;
+			float ny = uz * vx - ux * vz;
+			float nz = ux * vy - uy * vx;
+			float outward = closed ? nx * (a.x + b.x + c.x) + ny * (a.y + b.y + c.y) + nz * (a.z + b.z + c.z) : ny;
+			if (outward >= 0)
+				return false;
+		}
+		return true;
+	}
+
+	bool CheckIndices(const Mesh& mesh)
+	{
+		for (uint32_t index : mesh.indices)
+		{
+			if (index >= mesh.vertices.size())
+				return false;
+		}
+		return mesh.indices.size() % 3 == 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int cacheSize = MeshBuilder::CACHE_SIZE;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--cache") == 0)
+			cacheSize = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (cacheSize < 3)
+	{
+		fprintf(stderr, "the cache needs room for at least one triangle\n");
+		return 1;
+	}
+
+	std::vector<Shape> shapes = {
+		{ "cube 1", [](bool optimize) { return MeshBuilder::Cube(1, optimize); }, true },
+		{ "cube 16", [](bool optimize) { return MeshBuilder::Cube(16, optimize); }, true },
+		{ "sphere 16x8", [](bool optimize) { return MeshBuilder::Sphere(16, 8, optimize); }, true },
+		{ "sphere 64x32", [](bool optimize) { return MeshBuilder::Sphere(64, 32, optimize); }, true },
+		{ "sphere 512x256", [](bool optimize) { return MeshBuilder::Sphere(512, 256, optimize); }, true },
+		{ "plane 1x1", [](bool optimize) { return MeshBuilder::Plane(1, 1, optimize); }, false },
+		{ "plane 64x64", [](bool optimize) { return MeshBuilder::Plane(64, 64, optimize); }, false },
+		{ "plane 300x300", [](bool optimize) { return MeshBuilder::Plane(300, 300, optimize); }, false },
+		{ "cylinder 16x1", [](bool optimize) { return MeshBuilder::Cylinder(16, 1, optimize); }, true },
+		{ "cylinder 128x64", [](bool optimize) { return MeshBuilder::Cylinder(128, 64, optimize); }, true },
+	};
+
+	printf("cache %d\n", cacheSize);
+	printf("%-16s %8s %8s %6s %13s %13s %10s %s\n", "shape", "vertices", "tris", "index",
+		"acmr gen/opt", "atvr gen/opt", "opt ms", "");
+
+	bool failed = false;
+	for (const Shape& shape : shapes)
+	{
+		Mesh generated = shape.build(false);
+		auto start = std::chrono::steady_clock::now();
+		Mesh optimized = shape.build(true);
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		VertexCacheStats before = MeshBuilder::AnalyzeVertexCache(generated.indices, generated.GetVertexCount(), cacheSize);
+		VertexCacheStats after = MeshBuilder::AnalyzeVertexCache(optimized.indices, optimized.GetVertexCount(), cacheSize);
+
+		int expectedIndexSize = optimized.GetVertexCount() <= 0x10000 ? 2 : 4;
+		std::string verdict;
+		if (!CheckIndices(optimized) || optimized.GetTriangleCount() != generated.GetTriangleCount())
+			verdict = "FAIL triangles lost";
+		else if (!CheckWinding(optimized, shape.closed) || !CheckWinding(generated, shape.closed))
+			verdict = "FAIL inward triangle";
+		else if (optimized.GetIndexSize() != expectedIndexSize)
+			verdict = "FAIL index size";
+		else if (after.acmr > before.acmr)
+			verdict = "FAIL acmr got worse";
+
+		if (!verdict.empty())
+			failed = true;
+
+		printf("%-16s %8d %8d %5db %6.3f/%6.3f %6.3f/%6.3f %10.2f %s\n", shape.name.c_str(), optimized.GetVertexCount(),
+			optimized.GetTriangleCount(), optimized.GetIndexSize() * 8, before.acmr, after.acmr, before.atvr, after.atvr,
+			milliseconds, verdict.c_str());
+	}
+
+	//the cube the renderer draws, the eight corners and twelve triangles it always had
+	Mesh cube = MeshBuilder::Cube();
+	if (cube.GetVertexCount() != 8 || cube.GetTriangleCount() != 12)
+	{
+		printf("FAIL the default cube has %d vertices and %d triangles\n", cube.GetVertexCount(), cube.GetTriangleCount());
+		failed = true;
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,528 @@
+﻿#include "MeshBuilder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+namespace
+{
+	//the cache Forsyth's scores assume, larger than CACHE_SIZE so the order
+	//still holds up on hardware with a bigger one
+	const int FORSYTH_CACHE_SIZE = 32;
+	const float FORSYTH_CACHE_DECAY = 1.5f;
+	const float FORSYTH_LAST_TRIANGLE = 0.75f;
+	const float FORSYTH_VALENCE_SCALE = 2.0f;
+	const float FORSYTH_VALENCE_POWER = 0.5f;
+
+	//coloured by position, the unit cube maps onto the whole colour cube
+	uint32_t AddVertex(Mesh& mesh, float x, float y, float z)
+	{
+		MeshVertex vertex;
+		vertex.position = { x, y, z };
+		vertex.color = { x + 0.5f, y + 0.5f, z + 0.5f };
+		mesh.vertices.push_back(vertex);
+		return static_cast<uint32_t>(mesh.vertices.size() - 1);
+	}
+
+	//wound so the triangle's front faces along outward
+	void AddTriangle(Mesh& mesh, uint32_t a, uint32_t b, uint32_t c, const Float3& outward)
+	{
+		const Float3& pa = mesh.vertices[a].position;
+		Float3 normal = Cross(Subtract(mesh.vertices[b].position, pa), Subtract(mesh.vertices[c].position, pa));
+		//clockwise from the front in a left handed view, the cross product points away from the viewer
+		if (Dot(normal, outward) > 0)
+			std::swap(b, c);
+		mesh.indices.push_back(a);
+		mesh.indices.push_back(b);
+		mesh.indices.push_back(c);
+	}
+
+	void AddQuad(Mesh& mesh, uint32_t a, uint32_t b, uint32_t c, uint32_t d, const Float3& outward)
+	{
+		AddTriangle(mesh, a, b, c, outward);
+		AddTriangle(mesh, a, c, d, outward);
+	}
+
+	//the way out of a closed shape centred on the origin, through the middle of the triangle
+	Float3 Centroid(const Mesh& mesh, uint32_t a, uint32_t b, uint32_t c)
+	{
+		const Float3& pa = mesh.vertices[a].position;
+		const Float3& pb = mesh.vertices[b].position;
+		const Float3& pc = mesh.vertices[c].position;
+		return { pa.x + pb.x + pc.x, pa.y + pb.y + pc.y, pa.z + pb.z + pc.z };
+	}
+
+	//merges vertices at exactly the same position, colour follows position so nothing is lost
+	void Weld(Mesh& mesh)
+	{
+		std::map<std::array<float, 3>, uint32_t> welded;
+		std::vector<uint32_t> remap(mesh.vertices.size());
+		std::vector<MeshVertex> vertices;
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			const Float3& position = mesh.vertices[i].position;
+			auto inserted = welded.insert({ { position.x, position.y, position.z }, static_cast<uint32_t>(vertices.size()) });
+			if (inserted.second)
+				vertices.push_back(mesh.vertices[i]);
+			remap[i] = inserted.first->second;
+		}
+		for (uint32_t& index : mesh.indices)
+			index = remap[index];
+		mesh.vertices.swap(vertices);
+	}
+
+	float ForsythScore(int cachePosition, int remaining)
+	{
+		//nothing left to draw with it
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			//the last triangle's vertices get a fixed score so its neighbours aren't favoured over a fresh strip
+			if (cachePosition < 3)
+				score = FORSYTH_LAST_TRIANGLE;
+			else
+				score = powf(1.0f - static_cast<float>(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY);
+		}
+		//favour vertices with few triangles left so they are finished off rather than left stranded
+		return score + FORSYTH_VALENCE_SCALE * powf(static_cast<float>(remaining), -FORSYTH_VALENCE_POWER);
+	}
+}
+
+void Mesh::CopyIndices(void* target) const
+{
+	if (GetIndexSize() == 4)
+	{
+		memcpy(target, indices.data(), indices.size() * sizeof(uint32_t));
+		return;
+	}
+
+	uint16_t* shortIndices = static_cast<uint16_t*>(target);
+	for (size_t i = 0; i < indices.size(); i++)
+		shortIndices[i] = static_cast<uint16_t>(indices[i]);
+}
+
+Mesh MeshBuilder::Cube(int segments, bool optimize)
+{
+	segments = std::max(segments, 1);
+
+	//each face as its own grid, the shared edges are welded afterwards
+	static const int AXES[6][3] = {
+		{ 0, 1, 2 }, { 0, 1, 2 },
+		{ 1, 2, 0 }, { 1, 2, 0 },
+		{ 2, 0, 1 }, { 2, 0, 1 }
+	};
+
+	Mesh mesh;
+	int side = segments + 1;
+	for (int face = 0; face < 6; face++)
+	{
+		int normalAxis = AXES[face][0];
+		float normalSign = face % 2 == 0 ? -0.5f : 0.5f;
+		uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+
+		for (int v = 0; v < side; v++)
+		{
+			for (int u = 0; u < side; u++)
+			{
+				float coordinates[3];
+				coordinates[normalAxis] = normalSign;
+				coordinates[AXES[face][1]] = static_cast<float>(u) / segments - 0.5f;
+				coordinates[AXES[face][2]] = static_cast<float>(v) / segments - 0.5f;
+				AddVertex(mesh, coordinates[0], coordinates[1], coordinates[2]);
+			}
+		}
+
+		Float3 outward = { 0, 0, 0 };
+		(&outward.x)[normalAxis] = normalSign;
+		for (int v = 0; v < segments; v++)
+		{
+			for (int u = 0; u < segments; u++)
+			{
+				uint32_t corner = first + v * side + u;
+				AddQuad(mesh, corner, corner + 1, corner + side + 1, corner + side, outward);
+			}
+		}
+	}
+
+	Weld(mesh);
+	if (optimize)
+		Optimize(mesh);
+	return mesh;
+}
+
+Mesh MeshBuilder::Sphere(int slices, int stacks, bool optimize)
+{
+	slices = std::max(slices, 3);
+	stacks = std::max(stacks, 2);
+
+	Mesh mesh;
+	uint32_t top = AddVertex(mesh, 0.0f, 0.5f, 0.0f);
+	for (int stack = 1; stack < stacks; stack++)
+	{
+		float polar = PI * stack / stacks;
+		float radius = 0.5f * sinf(polar);
+		float y = 0.5f * cosf(polar);
+		for (int slice = 0; slice < slices; slice++)
+		{
+			float around = TWO_PI * slice / slices;
+			AddVertex(mesh, radius * cosf(around), y, radius * sinf(around));
+		}
+	}
+	uint32_t bottom = AddVertex(mesh, 0.0f, -0.5f, 0.0f);
+
+	//ring r starts at 1 + r * slices, the seam wraps back to the first vertex of the ring
+	auto ring = [slices](int r, int slice) { return static_cast<uint32_t>(1 + r * slices + slice % slices); };
+	for (int slice = 0; slice < slices; slice++)
+	{
+		uint32_t a = ring(0, slice);
+		uint32_t b = ring(0, slice + 1);
+		AddTriangle(mesh, top, a, b, Centroid(mesh, top, a, b));
+	}
+	for (int r = 0; r + 1 < stacks - 1; r++)
+	{
+		for (int slice = 0; slice < slices; slice++)
+		{
+			uint32_t a = ring(r, slice);
+			uint32_t b = ring(r, slice + 1);
+			uint32_t c = ring(r + 1, slice + 1);
+			uint32_t d = ring(r + 1, slice);
+			AddQuad(mesh, a, b, c, d, Centroid(mesh, a, b, c));
+		}
+	}
+	for (int slice = 0; slice < slices; slice++)
+	{
+		uint32_t a = ring(stacks - 2, slice);
+		uint32_t b = ring(stacks - 2, slice + 1);
+		AddTriangle(mesh, bottom, a, b, Centroid(mesh, bottom, a, b));
+	}
+
+	if (optimize)
+		Optimize(mesh);
+	return mesh;
+}
+
+Mesh MeshBuilder::Plane(int columns, int rows, bool optimize)
+{
+	columns = std::max(columns, 1);
+	rows = std::max(rows, 1);
+
+	Mesh mesh;
+	for (int row = 0; row <= rows; row++)
+	{
+		for (int column = 0; column <= columns; column++)
+			AddVertex(mesh, static_cast<float>(column) / columns - 0.5f, 0.0f, static_cast<float>(row) / rows - 0.5f);
+	}
+
+	uint32_t side = static_cast<uint32_t>(columns + 1);
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			uint32_t corner = row * side + column;
+			AddQuad(mesh, corner, corner + 1, corner + side + 1, corner + side, { 0.0f, 1.0f, 0.0f });
+		}
+	}
+
+	if (optimize)
+		Optimize(mesh);
+	return mesh;
+}
+
+Mesh MeshBuilder::Cylinder(int slices, int stacks, bool optimize)
+{
+	slices = std::max(slices, 3);
+	stacks = std::max(stacks, 1);
+
+	Mesh mesh;
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		float y = static_cast<float>(stack) / stacks - 0.5f;
+		for (int slice = 0; slice < slices; slice++)
+		{
+			float around = TWO_PI * slice / slices;
+			AddVertex(mesh, 0.5f * cosf(around), y, 0.5f * sinf(around));
+		}
+	}
+	uint32_t bottom = AddVertex(mesh, 0.0f, -0.5f, 0.0f);
+	uint32_t top = AddVertex(mesh, 0.0f, 0.5f, 0.0f);
+
+	auto ring = [slices](int r, int slice) { return static_cast<uint32_t>(r * slices + slice % slices); };
+	for (int r = 0; r < stacks; r++)
+	{
+		for (int slice = 0; slice < slices; slice++)
+		{
+			uint32_t a = ring(r, slice);
+			uint32_t b = ring(r, slice + 1);
+			uint32_t c = ring(r + 1, slice + 1);
+			uint32_t d = ring(r + 1, slice);
+			Float3 middle = Centroid(mesh, a, b, c);
+			AddQuad(mesh, a, b, c, d, { middle.x, 0.0f, middle.z });
+		}
+	}
+
+	//the caps share the rim with the sides, there are no normals to keep apart
+	for (int slice = 0; slice < slices; slice++)
+	{
+		AddTriangle(mesh, bottom, ring(0, slice), ring(0, slice + 1), { 0.0f, -1.0f, 0.0f });
+		AddTriangle(mesh, top, ring(stacks, slice), ring(stacks, slice + 1), { 0.0f, 1.0f, 0.0f });
+	}
+
+	if (optimize)
+		Optimize(mesh);
+	return mesh;
+}
+
+void MeshBuilder::Optimize(Mesh& mesh)
+{
+	OptimizeVertexCache(mesh.indices, mesh.GetVertexCount());
+	OptimizeOverdraw(mesh.vertices, mesh.indices);
+	OptimizeVertexFetch(mesh);
+}
+
+void MeshBuilder::OptimizeVertexCache(std::vector<uint32_t>& indices, int vertexCount)
+{
+	int triangleCount = static_cast<int>(indices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	//the triangles using each vertex, the first remaining[v] of them still to be drawn
+	std::vector<int> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+		remaining[index]++;
+	std::vector<int> firstTriangle(vertexCount + 1, 0);
+	for (int v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+	std::vector<int> triangles(indices.size());
+	std::vector<int> filled(vertexCount, 0);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = indices[t * 3 + corner];
+			triangles[firstTriangle[v] + filled[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+		vertexScore[v] = ForsythScore(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> drawn(triangleCount, false);
+	for (int t = 0; t < triangleCount; t++)
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+	std::vector<uint32_t> ordered;
+	ordered.reserve(indices.size());
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> nextCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	int best = -1;
+	int nextUndrawn = 0;
+	for (int drawnCount = 0; drawnCount < triangleCount; drawnCount++)
+	{
+		//nothing in the cache has triangles left, start again from the next undrawn one
+		if (best < 0)
+		{
+			while (drawn[nextUndrawn])
+				nextUndrawn++;
+			best = nextUndrawn;
+		}
+
+		drawn[best] = true;
+		const uint32_t* corners = &indices[best * 3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = corners[corner];
+			ordered.push_back(v);
+
+			//swap the triangle past the end of the ones left to draw
+			int* list = &triangles[firstTriangle[v]];
+			int* found = std::find(list, list + remaining[v], best);
+			if (found != list + remaining[v])
+			{
+				std::swap(*found, list[remaining[v] - 1]);
+				remaining[v]--;
+			}
+		}
+
+		//the triangle's vertices go to the front, everything else shifts back
+		nextCache.assign(corners, corners + 3);
+		for (uint32_t v : cache)
+		{
+			if (v != corners[0] && v != corners[1] && v != corners[2])
+				nextCache.push_back(v);
+		}
+
+		for (size_t i = 0; i < nextCache.size(); i++)
+		{
+			uint32_t v = nextCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+			vertexScore[v] = ForsythScore(cachePosition[v], remaining[v]);
+		}
+
+		//only triangles touching a vertex that moved can have changed score
+		best = -1;
+		float bestScore = -1.0f;
+		for (uint32_t v : nextCache)
+		{
+			for (int i = 0; i < remaining[v]; i++)
+			{
+				int t = triangles[firstTriangle[v] + i];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > FORSYTH_CACHE_SIZE)
+			nextCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(nextCache);
+	}
+
+	indices.swap(ordered);
+}
+
+void MeshBuilder::OptimizeOverdraw(const std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, float threshold)
+{
+	int triangleCount = static_cast<int>(indices.size() / 3);
+	int vertexCount = static_cast<int>(vertices.size());
+	if (triangleCount < 2)
+		return;
+
+	//a cluster starts wherever the cache order had to start over, a triangle with no vertex in the cache
+	std::vector<int> clusterStarts;
+	std::vector<int> insertedAt(vertexCount, -CACHE_SIZE - 1);
+	int transforms = 0;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = indices[t * 3 + corner];
+			if (transforms - insertedAt[v] > CACHE_SIZE)
+			{
+				insertedAt[v] = transforms++;
+				misses++;
+			}
+		}
+		if (t == 0 || misses == 3)
+			clusterStarts.push_back(t);
+	}
+	if (clusterStarts.size() < 2)
+		return;
+	clusterStarts.push_back(triangleCount);
+
+	//area weighted, so long thin triangles don't pull the centres about
+	Float3 meshCentre = { 0, 0, 0 };
+	float meshArea = 0;
+	struct Cluster
+	{
+		int begin;
+		int end;
+		float outwardness;
+	};
+	std::vector<Cluster> clusters;
+	std::vector<Float3> centres;
+	std::vector<Float3> normals;
+	for (size_t c = 0; c + 1 < clusterStarts.size(); c++)
+	{
+		Float3 centre = { 0, 0, 0 };
+		Float3 normal = { 0, 0, 0 };
+		float area = 0;
+		for (int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			const Float3& a = vertices[indices[t * 3]].position;
+			const Float3& b = vertices[indices[t * 3 + 1]].position;
+			const Float3& d = vertices[indices[t * 3 + 2]].position;
+			Float3 cross = Cross(Subtract(b, a), Subtract(d, a));
+			float weight = sqrtf(Dot(cross, cross));
+			centre.x += (a.x + b.x + d.x) * weight;
+			centre.y += (a.y + b.y + d.y) * weight;
+			centre.z += (a.z + b.z + d.z) * weight;
+			//the winding puts the cross product on the back of the triangle
+			normal = Subtract(normal, cross);
+			area += weight;
+		}
+
+		meshCentre.x += centre.x;
+		meshCentre.y += centre.y;
+		meshCentre.z += centre.z;
+		meshArea += area;
+		if (area > 0)
+			centre = { centre.x / (area * 3), centre.y / (area * 3), centre.z / (area * 3) };
+		normal = Normalize(normal);
+
+		clusters.push_back({ clusterStarts[c], clusterStarts[c + 1], 0.0f });
+		centres.push_back(centre);
+		normals.push_back(normal);
+	}
+	if (meshArea <= 0)
+		return;
+	meshCentre = { meshCentre.x / (meshArea * 3), meshCentre.y / (meshArea * 3), meshCentre.z / (meshArea * 3) };
+
+	//clusters far out along their own normal are the ones likely to cover the rest
+	for (size_t c = 0; c < clusters.size(); c++)
+		clusters[c].outwardness = Dot(Subtract(centres[c], meshCentre), normals[c]);
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.outwardness > b.outwardness; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const Cluster& cluster : clusters)
+		sorted.insert(sorted.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+
+	double cacheOrder = AnalyzeVertexCache(indices, vertexCount).acmr;
+	if (AnalyzeVertexCache(sorted, vertexCount).acmr <= cacheOrder * threshold)
+		indices.swap(sorted);
+}
+
+void MeshBuilder::OptimizeVertexFetch(Mesh& mesh)
+{
+	const uint32_t UNUSED = 0xffffffff;
+	std::vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+	std::vector<MeshVertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+	for (uint32_t& index : mesh.indices)
+	{
+		if (remap[index] == UNUSED)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+VertexCacheStats MeshBuilder::AnalyzeVertexCache(const std::vector<uint32_t>& indices, int vertexCount, int cacheSize)
+{
+	//a FIFO cache holds a vertex until cacheSize others have been transformed after it
+	std::vector<int> insertedAt(vertexCount, -cacheSize - 1);
+	int transforms = 0;
+	for (uint32_t index : indices)
+	{
+		if (transforms - insertedAt[index] > cacheSize)
+			insertedAt[index] = transforms++;
+	}
+
+	VertexCacheStats stats;
+	stats.transforms = transforms;
+	stats.acmr = indices.size() >= 3 ? static_cast<double>(transforms) / (indices.size() / 3) : 0.0;
+	stats.atvr = vertexCount > 0 ? static_cast<double>(transforms) / vertexCount : 0.0;
+	return stats;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SimMath.h"
+
+namespace DirectX11_Game
+{
+	//layout compatible with VertexPositionColor
+	struct MeshVertex
+	{
+		SimMath::Float3 position;
+		SimMath::Float3 color;
+	};
+
+	//Triangle list, clockwise when seen from the front the same as the old
+	//hand written cube. Indices are kept 32 bit here and narrowed on the way to
+	//the index buffer when every vertex fits in 16 bits.
+	struct Mesh
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;
+
+		int GetVertexCount() const { return static_cast<int>(vertices.size()); }
+		int GetIndexCount() const { return static_cast<int>(indices.size()); }
+		int GetTriangleCount() const { return static_cast<int>(indices.size() / 3); }
+		//2 or 4 bytes
+		int GetIndexSize() const { return vertices.size() <= 0x10000 ? 2 : 4; }
+		//writes GetIndexCount indices of GetIndexSize bytes each
+		void CopyIndices(void* target) const;
+	};
+
+	//How well an index order uses the post transform vertex cache, from a FIFO
+	//cache of the given size. acmr is vertex shader runs per triangle, 0.5 at
+	//best on a large regular mesh and 3 at worst. atvr is runs per vertex, 1 at
+	//best where every vertex is only transformed once.
+	struct VertexCacheStats
+	{
+		int transforms;
+		double acmr;
+		double atvr;
+	};
+
+	//Unit sized shapes centred on the origin, coloured by position the way the
+	//cube always was, so the corner at -0.5 is black and the one at +0.5 white.
+	//With optimize on the triangles are reordered for the vertex cache, then
+	//for overdraw, then the vertices for fetch order, see Optimize.
+	class MeshBuilder
+	{
+	public:
+		//the cache size the stats are measured with, a conservative guess at current hardware
+		static const int CACHE_SIZE = 16;
+
+		// segments	- quads along each edge of every face
+		static Mesh Cube(int segments = 1, bool optimize = true);
+		// slices		- around the y axis
+		// stacks		- from pole to pole
+		static Mesh Sphere(int slices = 16, int stacks = 8, bool optimize = true);
+		//flat in x and z, facing up
+		static Mesh Plane(int columns = 1, int rows = 1, bool optimize = true);
+		//around the y axis, capped at both ends
+		static Mesh Cylinder(int slices = 16, int stacks = 1, bool optimize = true);
+
+		static void Optimize(Mesh& mesh);
+
+		//Forsyth's linear speed ordering, greedily picks the next triangle by how
+		//recently its vertices were used and how few triangles they have left
+		static void OptimizeVertexCache(std::vector<uint32_t>& indices, int vertexCount);
+		//Splits the cache order into clusters where the cache restarts and draws
+		//the most outward facing ones first, so less is shaded and then hidden.
+		//Kept only while acmr stays within threshold of the cache order.
+		static void OptimizeOverdraw(const std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, float threshold = 1.05f);
+		//renumbers the vertices in the order the indices first use them, drops unused ones
+		static void OptimizeVertexFetch(Mesh& mesh);
+
+		static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, int vertexCount, int cacheSize = CACHE_SIZE);
+	};
+}
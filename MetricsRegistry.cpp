@@ -0,0 +1,157 @@
+﻿#include "MetricsRegistry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	//atomic<double> has no fetch_add before c++20
+	void AtomicAdd(std::atomic<double>& target, double amount)
+	{
+		double current = target.load(std::memory_order_relaxed);
+		while (!target.compare_exchange_weak(current, current + amount, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void AtomicMax(std::atomic<double>& target, double value)
+	{
+		double current = target.load(std::memory_order_relaxed);
+		while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	template<class Metric>
+	Metric* Find(const std::vector<std::unique_ptr<Metric>>& metrics, const std::string& name)
+	{
+		for (const std::unique_ptr<Metric>& metric : metrics)
+		{
+			if (metric->GetName() == name)
+				return metric.get();
+		}
+		return nullptr;
+	}
+}
+
+MetricsRegistry::Histogram::Histogram(const std::string& name, double lowest, double highest, int bucketCount) :
+	m_name(name),
+	m_count(0),
+	m_sum(0),
+	m_max(0)
+{
+	if (bucketCount < 1)
+		bucketCount = 1;
+
+	//bucket 0 takes everything up to lowest, the rest grow by the same ratio up to highest
+	double ratio = bucketCount > 1 ? pow(highest / lowest, 1.0 / (bucketCount - 1)) : 1.0;
+	m_bounds.resize(bucketCount);
+	for (int i = 0; i < bucketCount; i++)
+		m_bounds[i] = lowest * pow(ratio, i);
+
+	m_buckets.reset(new std::atomic<unsigned long long>[bucketCount + 1]);
+	for (int i = 0; i <= bucketCount; i++)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+
+	for (std::atomic<double>& sample : m_history)
+		sample.store(0, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::Histogram::Record(double value)
+{
+	int bucket = static_cast<int>(std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin());
+	m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	//the count hands out the history slot, so two threads never write the same one
+	unsigned long long index = m_count.fetch_add(1, std::memory_order_relaxed);
+	m_history[index % HISTORY].store(value, std::memory_order_relaxed);
+
+	AtomicAdd(m_sum, value);
+	AtomicMax(m_max, value);
+}
+
+double MetricsRegistry::Histogram::Percentile(double percent) const
+{
+	unsigned long long count = GetCount();
+	int samples = static_cast<int>(count < HISTORY ? count : HISTORY);
+	if (samples == 0)
+		return 0;
+
+	double window[HISTORY];
+	for (int i = 0; i < samples; i++)
+		window[i] = m_history[i].load(std::memory_order_relaxed);
+
+	//nearest rank
+	int rank = static_cast<int>(ceil(percent / 100.0 * samples)) - 1;
+	if (rank < 0)
+		rank = 0;
+	if (rank >= samples)
+		rank = samples - 1;
+	std::nth_element(window, window + rank, window + samples);
+	return window[rank];
+}
+
+MetricsRegistry::Counter* MetricsRegistry::GetCounter(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	Counter* counter = Find(m_counters, name);
+	if (!counter)
+	{
+		m_counters.emplace_back(new Counter(name));
+		counter = m_counters.back().get();
+	}
+	return counter;
+}
+
+MetricsRegistry::Gauge* MetricsRegistry::GetGauge(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	Gauge* gauge = Find(m_gauges, name);
+	if (!gauge)
+	{
+		m_gauges.emplace_back(new Gauge(name));
+		gauge = m_gauges.back().get();
+	}
+	return gauge;
+}
+
+MetricsRegistry::Histogram* MetricsRegistry::GetHistogram(const std::string& name, double lowest, double highest, int bucketCount)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	Histogram* histogram = Find(m_histograms, name);
+	if (!histogram)
+	{
+		m_histograms.emplace_back(new Histogram(name, lowest, highest, bucketCount));
+		histogram = m_histograms.back().get();
+	}
+	return histogram;
+}
+
+std::string MetricsRegistry::Format() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+
+	std::string result;
+	char line[256];
+	for (const std::unique_ptr<Counter>& counter : m_counters)
+	{
+		snprintf(line, sizeof(line), "%-20s %llu\n", counter->GetName().c_str(), counter->Get());
+		result += line;
+	}
+	for (const std::unique_ptr<Gauge>& gauge : m_gauges)
+	{
+		snprintf(line, sizeof(line), "%-20s %g\n", gauge->GetName().c_str(), gauge->Get());
+		result += line;
+	}
+	for (const std::unique_ptr<Histogram>& histogram : m_histograms)
+	{
+		snprintf(line, sizeof(line), "%-20s n %llu  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+			histogram->GetName().c_str(), histogram->GetCount(),
+			histogram->Percentile(50), histogram->Percentile(95), histogram->Percentile(99), histogram->GetMax());
+		result += line;
+	}
+	return result;
+}
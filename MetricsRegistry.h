@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace DirectX11_Game
+{
+	//Named counters, gauges and histograms for the debug overlay and the headless
+	//tools. Looking a metric up takes a lock, so do it once and keep the pointer,
+	//updating one afterwards is a relaxed atomic and safe from any thread.
+	class MetricsRegistry
+	{
+	public:
+		class Counter
+		{
+		public:
+			Counter(const std::string& name) : m_name(name), m_value(0) {}
+			void Add(unsigned long long amount = 1) { m_value.fetch_add(amount, std::memory_order_relaxed); }
+			unsigned long long Get() const { return m_value.load(std::memory_order_relaxed); }
+			const std::string& GetName() const { return m_name; }
+		private:
+			std::string m_name;
+			std::atomic<unsigned long long> m_value;
+		};
+
+		class Gauge
+		{
+		public:
+			Gauge(const std::string& name) : m_name(name), m_value(0) {}
+			void Set(double value) { m_value.store(value, std::memory_order_relaxed); }
+			double Get() const { return m_value.load(std::memory_order_relaxed); }
+			const std::string& GetName() const { return m_name; }
+		private:
+			std::string m_name;
+			std::atomic<double> m_value;
+		};
+
+		//Counts samples into fixed buckets spaced evenly on a log scale between
+		//lowest and highest, with one more on each end for anything outside. The
+		//last HISTORY samples are also kept so the percentiles follow recent frames.
+		class Histogram
+		{
+		public:
+			static const int HISTORY = 512;
+
+			Histogram(const std::string& name, double lowest, double highest, int bucketCount);
+
+			void Record(double value);
+
+			//over the last HISTORY samples, 0 when nothing has been recorded
+			double Percentile(double percent) const;
+
+			unsigned long long GetCount() const { return m_count.load(std::memory_order_relaxed); }
+			double GetSum() const { return m_sum.load(std::memory_order_relaxed); }
+			double GetMax() const { return m_max.load(std::memory_order_relaxed); }
+
+			//upper bound of each bucket, the overflow bucket has no bound
+			const std::vector<double>& GetBounds() const { return m_bounds; }
+			unsigned long long GetBucket(int bucket) const { return m_buckets[bucket].load(std::memory_order_relaxed); }
+			int GetBucketCount() const { return static_cast<int>(m_bounds.size()) + 1; }
+
+			const std::string& GetName() const { return m_name; }
+
+		private:
+			std::string m_name;
+			std::vector<double> m_bounds;
+			std::unique_ptr<std::atomic<unsigned long long>[]> m_buckets;
+			std::atomic<unsigned long long> m_count;
+			std::atomic<double> m_sum;
+			std::atomic<double> m_max;
+			std::atomic<double> m_history[HISTORY];
+		};
+
+		//Records the time from construction to destruction in milliseconds.
+		class ScopedTimer
+		{
+		public:
+			ScopedTimer(Histogram* histogram) : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+			~ScopedTimer()
+			{
+				if (m_histogram)
+					m_histogram->Record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count());
+			}
+		private:
+			Histogram* m_histogram;
+			std::chrono::steady_clock::time_point m_start;
+		};
+
+		//return the existing metric when the name is already registered
+		Counter* GetCounter(const std::string& name);
+		Gauge* GetGauge(const std::string& name);
+		Histogram* GetHistogram(const std::string& name, double lowest, double highest, int bucketCount);
+		//buckets from 0.01 to 1000 milliseconds
+		Histogram* GetTimer(const std::string& name) { return GetHistogram(name, 0.01, 1000.0, 40); }
+
+		//one line per metric, timers as count, p50, p95, p99 and max
+		std::string Format() const;
+
+	private:
+		mutable std::mutex m_lock;
+		std::vector<std::unique_ptr<Counter>> m_counters;
+		std::vector<std::unique_ptr<Gauge>> m_gauges;
+		std::vector<std::unique_ptr<Histogram>> m_histograms;
+	};
+}
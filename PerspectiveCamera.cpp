@@ -0,0 +1,74 @@
+﻿#include "PerspectiveCamera.h"
+
+#include <cstring>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+PerspectiveCamera::PerspectiveCamera() :
+	m_width(1),
+	m_height(1),
+	m_orientation(MatrixIdentity()),
+	m_eye({ 0.0f, 5.7f, 11.5f }),
+	m_dirty(true),
+	m_rebuildCount(0),
+	m_constants()
+{
+}
+
+void PerspectiveCamera::SetOutputSize(float width, float height)
+{
+	if (width == m_width && height == m_height)
+		return;
+
+	m_width = width;
+	m_height = height;
+	m_dirty = true;
+}
+
+void PerspectiveCamera::SetOrientation(const Float4x4& orientation)
+{
+	if (memcmp(&orientation, &m_orientation, sizeof(Float4x4)) == 0)
+		return;
+
+	m_orientation = orientation;
+	m_dirty = true;
+}
+
+void PerspectiveCamera::SetEye(const Float3& eye)
+{
+	if (eye.x == m_eye.x && eye.y == m_eye.y && eye.z == m_eye.z)
+		return;
+
+	m_eye = eye;
+	m_dirty = true;
+}
+
+bool PerspectiveCamera::Refresh()
+{
+	if (!m_dirty)
+		return false;
+
+	float aspectRatio = m_width / m_height;
+	float fovAngleY = 70.0f * PI / 180.0f;
+
+	// This is a simple example of change that can be made when the app is in portrait or snapped view.
+	if (aspectRatio < 1.0f)
+	{
+		fovAngleY *= 2.0f;
+	}
+
+	// Note that the OrientationTransform3D matrix is post-multiplied here in order to correctly orient the scene to match the display orientation.
+	// This sample makes use of a right-handed coordinate system using row-major matrices.
+	Float4x4 perspectiveMatrix = MatrixPerspectiveFovRH(fovAngleY, aspectRatio, 0.01f, 100.0f);
+	m_constants.projection = MatrixTranspose(perspectiveMatrix * m_orientation);
+
+	// Looking at point (0,-0.1,0) with the up-vector along the y-axis.
+	static const Float3 at = { 0.0f, -0.1f, 0.0f };
+	static const Float3 up = { 0.0f, 1.0f, 0.0f };
+	m_constants.view = MatrixTranspose(MatrixLookAtRH(m_eye, at, up));
+
+	m_dirty = false;
+	m_rebuildCount++;
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ShaderConstants.h"
+
+namespace DirectX11_Game
+{
+	//Works out the per-frame view and projection once, and again only when the
+	//output size, orientation or eye actually change.
+	class PerspectiveCamera
+	{
+	public:
+		PerspectiveCamera();
+
+		void SetOutputSize(float width, float height);
+		void SetOrientation(const SimMath::Float4x4& orientation);
+		void SetEye(const SimMath::Float3& eye);
+
+		const SimMath::Float3& GetEye() const { return m_eye; }
+
+		//rebuilds the matrices if anything changed, true when they need uploading
+		bool Refresh();
+
+		//transposed, ready for the shader
+		const ViewProjectionConstantBuffer& GetConstants() const { return m_constants; }
+
+		//how many times the matrices were actually rebuilt
+		unsigned int GetRebuildCount() const { return m_rebuildCount; }
+
+	private:
+		float m_width;
+		float m_height;
+		SimMath::Float4x4 m_orientation;
+		SimMath::Float3 m_eye;
+		bool m_dirty;
+		unsigned int m_rebuildCount;
+
+		ViewProjectionConstantBuffer m_constants;
+	};
+}
@@ -0,0 +1,191 @@
+﻿//Picks through the grid the way a pointer press does and checks every answer
+//against testing each cell in turn, for every manipulation mode.
+//
+//	PickBench [--grid side] [--rays count] [--checked count] [--mode type]
+//
+//Half the rays go through random points on a 1280x720 output from the default
+//camera, half from the eye straight at a random cell so most of them hit.
+//Reports how the grid was searched, how long building and picking took and how
+//many cells a pick tested. Each mode is built once, stepped and built again,
+//the way the simulation thread does a step later, and picked on the second
+//build, refit ms is that one and says sorted when it didn't refit. The first
+//--checked rays of each mode are also picked by brute force, the run fails
+//when any of those disagree.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "GridPicker.h"
+#include "GridSimulation.h"
+#include "PerspectiveCamera.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const float OUTPUT_WIDTH = 1280;
+	const float OUTPUT_HEIGHT = 720;
+
+	const char* MethodName(GridPicker::Method method)
+	{
+		switch (method)
+		{
+		case GridPicker::GridWalk:
+			return "grid walk";
+		case GridPicker::Hierarchy:
+			return "hierarchy";
+		default:
+			return "empty";
+		}
+	}
+
+	//the same hit, or a different cell the same distance away where two cubes meet
+	bool SameHit(bool found, const PickHit& hit, bool expectedFound, const PickHit& expected)
+	{
+		if (found != expectedFound)
+			return false;
+		if (!found)
+			return true;
+		return hit.cell == expected.cell || fabsf(hit.distance - expected.distance) <= 1e-3f * std::max(1.0f, expected.distance);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int side = 1000;
+	int rayCount = 2000;
+	int checkedCount = 50;
+	int onlyMode = -1;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--grid") == 0)
+			side = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--rays") == 0)
+			rayCount = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--checked") == 0)
+			checkedCount = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--mode") == 0)
+			onlyMode = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (side < 4 || rayCount < 1)
+	{
+		fprintf(stderr, "the grid side must be at least 4 and rays at least 1\n");
+		return 1;
+	}
+
+	PerspectiveCamera camera;
+	camera.SetOutputSize(OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	camera.Refresh();
+	const SimMath::Float3& eye = camera.GetEye();
+
+	printf("grid %d x %d (%d cells), %d rays, %d checked\n", side, side, side * side, rayCount, checkedCount);
+	printf("%-4s %-10s %9s %9s %10s %10s %8s %10s %s\n", "mode", "method", "build ms", "refit ms", "pick us", "worst us", "hits", "cells/pick", "");
+
+	bool failed = false;
+	for (int mode = 0; mode <= 6; mode++)
+	{
+		if (onlyMode >= 0 && mode != onlyMode)
+			continue;
+
+		GridSimulation simulation(side, side);
+		simulation.SetBuildModels(false);
+		simulation.SetPlaneManipulation(mode);
+		simulation.Update(0.3f);
+
+		GridPicker picker;
+		double buildMs[2];
+		for (int build = 0; build < 2; build++)
+		{
+			//a step on, turned and with the wave moved
+			if (build > 0)
+				simulation.Update(0.35f);
+
+			auto buildStart = std::chrono::steady_clock::now();
+			picker.Clear(simulation.GetModAmount(), simulation.GetRowCount());
+			for (int i = 0; i < simulation.GetChunkCount(); i++)
+			{
+				const TransformChunk& transforms = simulation.GetChunk(i).transforms;
+				picker.AddChunk(simulation.GetChunkInputs(i), transforms.GetCellCount(), transforms.firstCell);
+			}
+			picker.Finish();
+			buildMs[build] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+		}
+		bool refitted = picker.GetMethod() != GridPicker::Hierarchy || picker.GetBuildStats().refitted;
+
+		//the same rays every run
+		srand(1234 + mode);
+		double totalUs = 0;
+		double worstUs = 0;
+		long long cellsTested = 0;
+		int hits = 0;
+		int mismatches = 0;
+		for (int r = 0; r < rayCount; r++)
+		{
+			PickRay ray;
+			if (r % 2 == 0)
+			{
+				float x = OUTPUT_WIDTH * rand() / RAND_MAX;
+				float y = OUTPUT_HEIGHT * rand() / RAND_MAX;
+				ray = GridPicker::Unproject(camera.GetConstants(), x, y, OUTPUT_WIDTH, OUTPUT_HEIGHT);
+			}
+			else
+			{
+				int chunk = rand() % simulation.GetChunkCount();
+				TransformBatch::Inputs inputs = simulation.GetChunkInputs(chunk);
+				int local = rand() % simulation.GetChunk(chunk).transforms.GetCellCount();
+				float centerX, centerY, centerZ;
+				inputs.x += local;
+				inputs.y += local;
+				inputs.z += local;
+				inputs.yaw += local;
+				TransformBatch::BuildCenters(inputs, 1, &centerX, &centerY, &centerZ);
+				ray.origin = eye;
+				ray.direction = SimMath::Normalize(SimMath::Float3({ centerX - eye.x, centerY - eye.y, centerZ - eye.z }));
+			}
+
+			PickHit hit;
+			auto start = std::chrono::steady_clock::now();
+			bool found = picker.Pick(ray, hit);
+			double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+			totalUs += us;
+			worstUs = std::max(worstUs, us);
+			cellsTested += picker.GetStats().cellsTested;
+			if (found)
+				hits++;
+
+			if (r < checkedCount)
+			{
+				PickHit expected;
+				bool expectedFound = picker.PickBruteForce(ray, expected);
+				if (!SameHit(found, hit, expectedFound, expected))
+				{
+					mismatches++;
+					if (mismatches <= 3)
+					{
+						printf("  ray %d picked %d at %.4f, every cell says %d at %.4f\n", r, found ? hit.cell : -1, found ? hit.distance : 0.0f,
+							expectedFound ? expected.cell : -1, expectedFound ? expected.distance : 0.0f);
+					}
+				}
+			}
+		}
+
+		if (mismatches > 0)
+			failed = true;
+		printf("%-4d %-10s %9.2f %9.2f %10.2f %10.2f %8d %10.1f %s%s\n", mode, MethodName(picker.GetMethod()), buildMs[0], buildMs[1],
+			totalUs / rayCount, worstUs, hits, static_cast<double>(cellsTested) / rayCount, refitted ? "" : "sorted ", mismatches > 0 ? "FAIL" : "");
+	}
+
+	return failed ? 1 : 0;
+}
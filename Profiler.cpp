@@ -0,0 +1,304 @@
+﻿#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC 1
+#endif
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	struct ThreadRing
+	{
+		Profiler::Event events[Profiler::RING_SIZE];
+		//total zones ever written, the next one goes in written % RING_SIZE
+		std::atomic<uint64_t> written;
+		//anything before this was dropped by Reset
+		std::atomic<uint64_t> firstKept;
+		int threadId;
+		std::string name;
+		//its thread has exited, the next new thread takes it over
+		bool retired;
+	};
+
+	struct Registry
+	{
+		std::mutex lock;
+		std::vector<ThreadRing*> rings;
+
+		//ticks and wall time when the profiler started, for turning ticks into microseconds
+		uint64_t originTicks;
+		std::chrono::steady_clock::time_point originTime;
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry* registry = []()
+		{
+			//never freed, worker threads can still be recording while the process exits
+			Registry* created = new Registry();
+			created->originTicks = Profiler::Now();
+			created->originTime = std::chrono::steady_clock::now();
+			return created;
+		}();
+		return *registry;
+	}
+
+	//plain pointer so Record doesn't pay for a thread_local with a destructor
+	thread_local ThreadRing* t_ring = nullptr;
+
+	//hands the ring back when the thread exits, so restarting the worker pool
+	//doesn't leave a ring behind for every thread it ever had
+	struct RingOwner
+	{
+		ThreadRing* ring = nullptr;
+		~RingOwner()
+		{
+			if (!ring)
+				return;
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.lock);
+			ring->retired = true;
+		}
+	};
+	thread_local RingOwner t_owner;
+
+	ThreadRing* CreateRing()
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.lock);
+
+		ThreadRing* ring = nullptr;
+		for (ThreadRing* existing : registry.rings)
+		{
+			if (existing->retired)
+			{
+				ring = existing;
+				break;
+			}
+		}
+		if (!ring)
+		{
+			ring = new ThreadRing();
+			ring->written.store(0, std::memory_order_relaxed);
+			ring->firstKept.store(0, std::memory_order_relaxed);
+			ring->threadId = static_cast<int>(registry.rings.size()) + 1;
+			registry.rings.push_back(ring);
+		}
+		//a reused ring keeps the old thread's zones, they just show under the new name
+		ring->retired = false;
+		ring->name = "thread " + std::to_string(ring->threadId);
+
+		t_ring = ring;
+		t_owner.ring = ring;
+		return ring;
+	}
+
+	struct Copied
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t end;
+		int threadId;
+	};
+
+	//The oldest zone that can't be being overwritten once written has reached
+	//this. The owner fills slot written % RING_SIZE before it moves written on,
+	//so the zone RING_SIZE behind it is already gone.
+	uint64_t FirstIntact(uint64_t written)
+	{
+		return written + 1 > Profiler::RING_SIZE ? written + 1 - Profiler::RING_SIZE : 0;
+	}
+
+	//copies every zone still in the rings, dropping any the owner may have
+	//overwritten while they were being read
+	std::vector<Copied> CopyEvents(Registry& registry)
+	{
+		std::vector<Copied> copied;
+		for (ThreadRing* ring : registry.rings)
+		{
+			uint64_t end = ring->written.load(std::memory_order_acquire);
+			uint64_t begin = std::max(FirstIntact(end), ring->firstKept.load(std::memory_order_relaxed));
+
+			size_t first = copied.size();
+			for (uint64_t i = begin; i < end; i++)
+			{
+				const Profiler::Event& event = ring->events[i % Profiler::RING_SIZE];
+				copied.push_back({ event.name.load(std::memory_order_relaxed), event.start.load(std::memory_order_relaxed),
+					event.end.load(std::memory_order_relaxed), ring->threadId });
+			}
+
+			//the copies have to be read before written is read again, or a slot
+			//changing under them could go unseen
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t safe = FirstIntact(ring->written.load(std::memory_order_relaxed));
+			if (safe > begin)
+			{
+				size_t overwritten = static_cast<size_t>(std::min(safe, end) - begin);
+				copied.erase(copied.begin() + first, copied.begin() + first + overwritten);
+			}
+		}
+		return copied;
+	}
+
+	//microseconds per tick, measured against the wall clock since the profiler started
+	double MicrosecondsPerTick(Registry& registry)
+	{
+#if defined(PROFILER_RDTSC)
+		//a very short run would give a poor ratio, so make sure some time has passed
+		while (std::chrono::steady_clock::now() - registry.originTime < std::chrono::milliseconds(10))
+			std::this_thread::yield();
+
+		uint64_t ticks = Profiler::Now() - registry.originTicks;
+		double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - registry.originTime).count();
+		return ticks > 0 ? microseconds / ticks : 0;
+#else
+		(void)registry;
+		return 0.001;
+#endif
+	}
+
+	void AppendEscaped(std::string& out, const char* text)
+	{
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				out += '\\';
+			out += *c;
+		}
+	}
+}
+
+uint64_t Profiler::Now()
+{
+#if defined(PROFILER_RDTSC)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+void Profiler::Record(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadRing* ring = t_ring ? t_ring : CreateRing();
+
+	//only this thread writes the ring, readers check written before and after copying
+	uint64_t index = ring->written.load(std::memory_order_relaxed);
+	Event& event = ring->events[index % RING_SIZE];
+	event.name.store(name, std::memory_order_relaxed);
+	event.start.store(start, std::memory_order_relaxed);
+	event.end.store(end, std::memory_order_relaxed);
+	ring->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadRing* ring = t_ring ? t_ring : CreateRing();
+
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+	ring->name = name;
+}
+
+std::string Profiler::ChromeTrace()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+
+	std::vector<Copied> events = CopyEvents(registry);
+	double scale = MicrosecondsPerTick(registry);
+
+	uint64_t origin = UINT64_MAX;
+	for (const Copied& event : events)
+		origin = std::min(origin, event.start);
+
+	std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	char number[96];
+	bool first = true;
+	for (ThreadRing* ring : registry.rings)
+	{
+		out += first ? "" : ",\n";
+		first = false;
+		snprintf(number, sizeof(number), "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"", ring->threadId);
+		out += number;
+		AppendEscaped(out, ring->name.c_str());
+		out += "\"}}";
+	}
+	for (const Copied& event : events)
+	{
+		out += first ? "" : ",\n";
+		first = false;
+		out += "{\"ph\":\"X\",\"pid\":1,\"name\":\"";
+		AppendEscaped(out, event.name);
+		snprintf(number, sizeof(number), "\",\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.threadId,
+			(event.start - origin) * scale, (event.end - event.start) * scale);
+		out += number;
+	}
+	out += "\n]}\n";
+	return out;
+}
+
+std::string Profiler::Summary()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+
+	std::vector<Copied> events = CopyEvents(registry);
+	double scale = MicrosecondsPerTick(registry);
+
+	struct Totals
+	{
+		unsigned long long count;
+		double total;
+		double longest;
+	};
+	std::map<std::string, Totals> zones;
+	for (const Copied& event : events)
+	{
+		double duration = (event.end - event.start) * scale;
+		Totals& totals = zones[event.name];
+		totals.count++;
+		totals.total += duration;
+		totals.longest = std::max(totals.longest, duration);
+	}
+
+	//most expensive first
+	std::vector<std::pair<std::string, Totals>> sorted(zones.begin(), zones.end());
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Totals>& a, const std::pair<std::string, Totals>& b)
+	{
+		return a.second.total > b.second.total;
+	});
+
+	std::string out;
+	char line[256];
+	snprintf(line, sizeof(line), "%-40s %10s %12s %10s %10s\n", "zone", "count", "total ms", "avg us", "max us");
+	out += line;
+	for (const std::pair<std::string, Totals>& zone : sorted)
+	{
+		snprintf(line, sizeof(line), "%-40s %10llu %12.3f %10.3f %10.3f\n", zone.first.c_str(), zone.second.count,
+			zone.second.total / 1000, zone.second.total / zone.second.count, zone.second.longest);
+		out += line;
+	}
+	return out;
+}
+
+void Profiler::Reset()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.lock);
+	for (ThreadRing* ring : registry.rings)
+		ring->firstKept.store(ring->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
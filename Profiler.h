@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//Scoped zones for seeing where a frame goes. Each thread writes finished zones
+//into its own ring buffer, so marking a zone is two timestamps and a few
+//stores with no locks. Define PROFILER_DISABLED and the macros compile to nothing.
+//
+//	void GridSimulation::Update(float radians)
+//	{
+//		PROFILE_ZONE("GridSimulation::Update");
+//		...
+//
+//Names must be string literals, or anything else that outlives the profiler.
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if defined(PROFILER_DISABLED)
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD_NAME(name)
+#else
+#define PROFILE_ZONE(name) DirectX11_Game::Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) DirectX11_Game::Profiler::SetThreadName(name)
+#endif
+
+namespace DirectX11_Game
+{
+	class Profiler
+	{
+	public:
+		//zones kept per thread, older ones are overwritten. A trace leaves out the
+		//oldest, its slot is the one the thread writes over next.
+		static const int RING_SIZE = 1 << 15;
+
+		struct Event
+		{
+			std::atomic<const char*> name;
+			std::atomic<uint64_t> start;
+			std::atomic<uint64_t> end;
+		};
+
+		class Zone
+		{
+		public:
+			Zone(const char* name) : m_name(name), m_start(Now()) {}
+			~Zone() { Record(m_name, m_start, Now()); }
+		private:
+			const char* m_name;
+			uint64_t m_start;
+		};
+
+		//raw ticks, only meaningful relative to each other
+		static uint64_t Now();
+		static void Record(const char* name, uint64_t start, uint64_t end);
+
+		//shown as the thread's name in the trace
+		static void SetThreadName(const char* name);
+
+		//every zone still in the rings as chrome trace_event json, for chrome://tracing or perfetto
+		static std::string ChromeTrace();
+		//one line per zone name with the count, total, average and longest time
+		static std::string Summary();
+
+		//drops everything recorded so far
+		static void Reset();
+	};
+}
@@ -0,0 +1,159 @@
+﻿//Measures what a PROFILE_ZONE costs, on one thread and with several threads
+//recording at once, and checks the trace comes back with every zone in it.
+//
+//	ProfilerBench [--zones count] [--threads count]
+//
+//Fails unless a zone costs under ZONE_BUDGET_NS, as printed, on one thread
+//and on the slowest of the threads. The threads are only held to it when the
+//machine has a core for each, otherwise they take turns and time each other.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	const double ZONE_BUDGET_NS = 50;
+
+	//the cost the way it is printed, so a run that shows 50.00 can't pass
+	bool UnderBudget(double nanoseconds)
+	{
+		return std::round(nanoseconds * 100) / 100 < ZONE_BUDGET_NS;
+	}
+
+	double Nanoseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//volatile so the loop can't be folded away around the zones
+	volatile int g_sink = 0;
+
+	double TimeZones(int count)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++)
+		{
+			PROFILE_ZONE("bench zone");
+			g_sink = i;
+		}
+		return Nanoseconds(start);
+	}
+
+	double TimeEmpty(int count)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++)
+			g_sink = i;
+		return Nanoseconds(start);
+	}
+
+	int CountOccurrences(const std::string& text, const char* pattern)
+	{
+		int count = 0;
+		for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+			count++;
+		return count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int zones = 10000000;
+	int threads = 4;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--zones") == 0)
+			zones = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--threads") == 0)
+			threads = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (zones < 1 || threads < 1)
+	{
+		fprintf(stderr, "zones and threads must be at least 1\n");
+		return 1;
+	}
+
+#if defined(PROFILER_DISABLED)
+	printf("built with PROFILER_DISABLED, zones compile to nothing\n");
+#endif
+
+	PROFILE_THREAD_NAME("bench main");
+
+	//the first zone on a thread sets up its ring, keep that out of the timing
+	TimeZones(Profiler::RING_SIZE);
+
+	//best of several runs, the loop overhead taken off, so one preempted run can't fail it
+	int runZones = std::max(zones / 2, 1);
+	double best = 1e300;
+	for (int run = 0; run < 10; run++)
+		best = std::min(best, (TimeZones(runZones) - TimeEmpty(runZones)) / runZones);
+	printf("%-24s %8.2f ns per zone, under %.2f to pass\n", "one thread", best, ZONE_BUDGET_NS);
+
+	//each thread only writes its own ring, so this should cost about the same
+	std::vector<double> perThread(threads);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread([&perThread, t, zones]()
+		{
+			std::string name = "bench " + std::to_string(t);
+			PROFILE_THREAD_NAME(name.c_str());
+			TimeZones(Profiler::RING_SIZE);
+
+			//short runs, so the best of them fits in a time slice when there are fewer cores than threads
+			int runZones = std::max(zones / 100, 1);
+			double fastest = 1e300;
+			for (int run = 0; run < 100; run++)
+				fastest = std::min(fastest, (TimeZones(runZones) - TimeEmpty(runZones)) / runZones);
+			perThread[t] = fastest;
+		}));
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+	double worst = *std::max_element(perThread.begin(), perThread.end());
+	bool threadsChecked = std::thread::hardware_concurrency() >= static_cast<unsigned int>(threads);
+	printf("%-24s %8.2f ns per zone, slowest thread, %s\n", (std::to_string(threads) + " threads").c_str(), worst,
+		threadsChecked ? "under the same to pass" : "not checked with fewer cores than threads");
+
+	//a fresh batch small enough to fit the ring has to come back whole
+	Profiler::Reset();
+	int kept = std::min(zones, static_cast<int>(Profiler::RING_SIZE) - 1);
+	TimeZones(kept);
+	std::string trace = Profiler::ChromeTrace();
+	int traced = CountOccurrences(trace, "\"ph\":\"X\"");
+	printf("%-24s %d of %d zones, %zu bytes\n", "trace", traced, kept, trace.size());
+	printf("\n%s", Profiler::Summary().c_str());
+
+	bool failed = false;
+#if !defined(PROFILER_DISABLED)
+	if (traced != kept)
+	{
+		printf("trace is missing zones\n");
+		failed = true;
+	}
+	if (!UnderBudget(best) || (threadsChecked && !UnderBudget(worst)))
+	{
+		printf("zones cost %.2f ns or more\n", ZONE_BUDGET_NS);
+		failed = true;
+	}
+#endif
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+﻿#include "RecordingRenderBackend.h"
+
+using namespace DirectX11_Game;
+
+RecordingRenderBackend::RecordingRenderBackend() :
+	m_recording(true),
+	m_keepUploads(false),
+	m_counts(),
+	m_bytesUploaded(0)
+{
+}
+
+void RecordingRenderBackend::Clear()
+{
+	m_commands.clear();
+	for (int i = 0; i < CommandTypeCount; i++)
+		m_counts[i] = 0;
+	m_bytesUploaded = 0;
+}
+
+unsigned long long RecordingRenderBackend::GetDrawCalls() const
+{
+	return m_counts[DrawIndexedCommand] + m_counts[DrawIndexedInstancedCommand];
+}
+
+const char* RecordingRenderBackend::GetCommandName(CommandType type)
+{
+	switch (type)
+	{
+	case UpdateBufferCommand:
+		return "UpdateBuffer";
+	case UpdateBufferRegionCommand:
+		return "UpdateBufferRegion";
+	case WriteDynamicBufferCommand:
+		return "WriteDynamicBuffer";
+	case SetVertexBufferCommand:
+		return "SetVertexBuffer";
+	case SetIndexBufferCommand:
+		return "SetIndexBuffer";
+	case SetPrimitiveTopologyCommand:
+		return "SetPrimitiveTopology";
+	case SetInputLayoutCommand:
+		return "SetInputLayout";
+	case SetVertexShaderCommand:
+		return "SetVertexShader";
+	case SetVertexConstantBufferCommand:
+		return "SetVertexConstantBuffer";
+	case SetPixelShaderCommand:
+		return "SetPixelShader";
+	case DrawIndexedCommand:
+		return "DrawIndexed";
+	case DrawIndexedInstancedCommand:
+		return "DrawIndexedInstanced";
+	default:
+		return "Unknown";
+	}
+}
+
+void RecordingRenderBackend::Record(CommandType type, const void* resource, unsigned int a0, unsigned int a1,
+	unsigned int a2, unsigned int a3, unsigned int a4)
+{
+	m_counts[type]++;
+	if (!m_recording)
+		return;
+
+	Command command;
+	command.type = type;
+	command.resource = resource;
+	command.args[0] = a0;
+	command.args[1] = a1;
+	command.args[2] = a2;
+	command.args[3] = a3;
+	command.args[4] = a4;
+	m_commands.push_back(command);
+}
+
+void RecordingRenderBackend::RecordUpload(CommandType type, void* buffer, const void* data, unsigned int size, unsigned int offset)
+{
+	m_bytesUploaded += size;
+	Record(type, buffer, size, offset);
+
+	if (m_recording && m_keepUploads)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		m_commands.back().data.assign(bytes, bytes + size);
+	}
+}
+
+void RecordingRenderBackend::UpdateBuffer(void* buffer, const void* data, unsigned int size)
+{
+	RecordUpload(UpdateBufferCommand, buffer, data, size);
+}
+
+void RecordingRenderBackend::UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	RecordUpload(UpdateBufferRegionCommand, buffer, data, size, offset);
+}
+
+void RecordingRenderBackend::WriteDynamicBuffer(void* buffer, const void* data, unsigned int size)
+{
+	RecordUpload(WriteDynamicBufferCommand, buffer, data, size);
+}
+
+void RecordingRenderBackend::SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset)
+{
+	Record(SetVertexBufferCommand, buffer, slot, stride, offset);
+}
+
+void RecordingRenderBackend::SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset)
+{
+	Record(SetIndexBufferCommand, buffer, static_cast<unsigned int>(format), offset);
+}
+
+void RecordingRenderBackend::SetPrimitiveTopology(PrimitiveTopology topology)
+{
+	Record(SetPrimitiveTopologyCommand, nullptr, static_cast<unsigned int>(topology));
+}
+
+void RecordingRenderBackend::SetInputLayout(void* inputLayout)
+{
+	Record(SetInputLayoutCommand, inputLayout);
+}
+
+void RecordingRenderBackend::SetVertexShader(void* shader)
+{
+	Record(SetVertexShaderCommand, shader);
+}
+
+void RecordingRenderBackend::SetVertexConstantBuffer(unsigned int slot, void* buffer)
+{
+	Record(SetVertexConstantBufferCommand, buffer, slot);
+}
+
+void RecordingRenderBackend::SetPixelShader(void* shader)
+{
+	Record(SetPixelShaderCommand, shader);
+}
+
+void RecordingRenderBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Record(DrawIndexedCommand, nullptr, indexCount, startIndex, static_cast<unsigned int>(baseVertex));
+}
+
+void RecordingRenderBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+	unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	Record(DrawIndexedInstancedCommand, nullptr, indexCount, instanceCount, startIndex,
+		static_cast<unsigned int>(baseVertex), startInstance);
+}
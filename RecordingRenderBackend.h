@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "RenderBackend.h"
+
+namespace DirectX11_Game
+{
+	//Backend that writes every call down instead of talking to a device, so the
+	//packing and submission in the renderer can be checked headless.
+	class RecordingRenderBackend : public RenderBackend
+	{
+	public:
+		enum CommandType
+		{
+			UpdateBufferCommand,
+			UpdateBufferRegionCommand,
+			WriteDynamicBufferCommand,
+			SetVertexBufferCommand,
+			SetIndexBufferCommand,
+			SetPrimitiveTopologyCommand,
+			SetInputLayoutCommand,
+			SetVertexShaderCommand,
+			SetVertexConstantBufferCommand,
+			SetPixelShaderCommand,
+			DrawIndexedCommand,
+			DrawIndexedInstancedCommand,
+			CommandTypeCount
+		};
+
+		struct Command
+		{
+			CommandType type;
+			const void* resource;
+			//call arguments in the order they were passed, unused ones are 0
+			unsigned int args[5];
+			//copy of the uploaded bytes, only kept when SetKeepUploads is on
+			std::vector<unsigned char> data;
+		};
+
+		RecordingRenderBackend();
+
+		//with recording off only the counters are kept, which makes it a null backend
+		void SetRecording(bool recording) { m_recording = recording; }
+		void SetKeepUploads(bool keepUploads) { m_keepUploads = keepUploads; }
+
+		void Clear();
+
+		const std::vector<Command>& GetCommands() const { return m_commands; }
+		unsigned long long GetCount(CommandType type) const { return m_counts[type]; }
+		unsigned long long GetDrawCalls() const;
+		unsigned long long GetBytesUploaded() const { return m_bytesUploaded; }
+
+		static const char* GetCommandName(CommandType type);
+
+		void UpdateBuffer(void* buffer, const void* data, unsigned int size) override;
+		void UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size) override;
+		void WriteDynamicBuffer(void* buffer, const void* data, unsigned int size) override;
+
+		void SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset) override;
+		void SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset) override;
+		void SetPrimitiveTopology(PrimitiveTopology topology) override;
+		void SetInputLayout(void* inputLayout) override;
+		void SetVertexShader(void* shader) override;
+		void SetVertexConstantBuffer(unsigned int slot, void* buffer) override;
+		void SetPixelShader(void* shader) override;
+
+		void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+		void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+			unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+
+	private:
+		void Record(CommandType type, const void* resource, unsigned int a0 = 0, unsigned int a1 = 0,
+			unsigned int a2 = 0, unsigned int a3 = 0, unsigned int a4 = 0);
+		void RecordUpload(CommandType type, void* buffer, const void* data, unsigned int size, unsigned int offset = 0);
+
+		bool m_recording;
+		bool m_keepUploads;
+		std::vector<Command> m_commands;
+		unsigned long long m_counts[CommandTypeCount];
+		unsigned long long m_bytesUploaded;
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+namespace DirectX11_Game
+{
+	enum class IndexFormat
+	{
+		Index16,
+		Index32
+	};
+
+	enum class PrimitiveTopology
+	{
+		TriangleList
+	};
+
+	//The handful of device context calls the grid renderer makes, so the draw
+	//logic can run against a recording backend on machines without a GPU.
+	//Resources are passed as opaque pointers, on Windows they are the D3D objects.
+	class RenderBackend
+	{
+	public:
+		virtual ~RenderBackend() {}
+
+		//copies into a default usage buffer, UpdateSubresource1
+		virtual void UpdateBuffer(void* buffer, const void* data, unsigned int size) = 0;
+		//copies into part of a default usage buffer, UpdateSubresource1 with a box
+		virtual void UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size) = 0;
+		//replaces the contents of a dynamic buffer, Map with WRITE_DISCARD
+		virtual void WriteDynamicBuffer(void* buffer, const void* data, unsigned int size) = 0;
+
+		virtual void SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset) = 0;
+		virtual void SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset) = 0;
+		virtual void SetPrimitiveTopology(PrimitiveTopology topology) = 0;
+		virtual void SetInputLayout(void* inputLayout) = 0;
+		virtual void SetVertexShader(void* shader) = 0;
+		virtual void SetVertexConstantBuffer(unsigned int slot, void* buffer) = 0;
+		virtual void SetPixelShader(void* shader) = 0;
+
+		virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+		virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+			unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+	};
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "SimMath.h"
+
+namespace DirectX11_Game
+{
+	//Constant buffer shared by every cube, register b0. Only rewritten when the
+	//window size or the eye changes.
+	struct ViewProjectionConstantBuffer
+	{
+		SimMath::Float4x4 view;
+		SimMath::Float4x4 projection;
+	};
+
+	//Per cube constant buffer for the non-instanced path, register b1. The
+	//instanced path carries the same matrix in its instance stream instead.
+	struct ModelConstantBuffer
+	{
+		SimMath::Float4x4 model;
+	};
+
+	static_assert(sizeof(ViewProjectionConstantBuffer) % 16 == 0, "constant buffers must be a multiple of 16 bytes");
+	static_assert(sizeof(ModelConstantBuffer) % 16 == 0, "constant buffers must be a multiple of 16 bytes");
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+//Small stand in for the parts of DirectXMath the grid simulation uses, so the
+//simulation can be built and profiled without the Windows SDK.
+//Matrices are row-major and use row vectors, the same as DirectXMath, and the
+//trig matches XMScalarSinCos so the transforms come out the same.
+
+#include <cmath>
+#include <cstring>
+
+namespace DirectX11_Game
+{
+	namespace SimMath
+	{
+		const float PI = 3.141592654f;
+		const float TWO_PI = 6.283185307f;
+		const float ONE_DIV_TWO_PI = 0.159154943f;
+		const float PI_DIV_TWO = 1.570796327f;
+
+		//layout compatible with XMFLOAT3
+		struct Float3
+		{
+			float x;
+			float y;
+			float z;
+		};
+
+		//layout compatible with XMFLOAT4X4
+		struct Float4x4
+		{
+			float m[4][4];
+		};
+
+		inline float ConvertToRadians(float degrees)
+		{
+			return degrees * (PI / 180.0f);
+		}
+
+		//port of XMScalarSinCos, 11/10 degree minimax approximations
+		inline void ScalarSinCos(float* sinOut, float* cosOut, float value)
+		{
+			//map value to y in [-pi,pi], x = 2*pi*quotient + remainder
+			float quotient = ONE_DIV_TWO_PI * value;
+			if (value >= 0.0f)
+				quotient = static_cast<float>(static_cast<int>(quotient + 0.5f));
+			else
+				quotient = static_cast<float>(static_cast<int>(quotient - 0.5f));
+			float y = value - TWO_PI * quotient;
+
+			//map y to [-pi/2,pi/2] with sin(y) = sin(value)
+			float sign;
+			if (y > PI_DIV_TWO)
+			{
+				y = PI - y;
+				sign = -1.0f;
+			}
+			else if (y < -PI_DIV_TWO)
+			{
+				y = -PI - y;
+				sign = -1.0f;
+			}
+			else
+			{
+				sign = +1.0f;
+			}
+
+			float y2 = y * y;
+
+			*sinOut = (((((-2.3889859e-08f * y2 + 2.7525562e-06f) * y2 - 0.00019840874f) * y2 + 0.0083333310f) * y2 - 0.16666667f) * y2 + 1.0f) * y;
+
+			float p = ((((-2.6051615e-07f * y2 + 2.4760495e-05f) * y2 - 0.0013888378f) * y2 + 0.041666638f) * y2 - 0.5f) * y2 + 1.0f;
+			*cosOut = sign * p;
+		}
+
+		inline Float4x4 MatrixIdentity()
+		{
+			Float4x4 result = { {
+				{ 1.0f, 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 1.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 1.0f, 0.0f },
+				{ 0.0f, 0.0f, 0.0f, 1.0f } } };
+			return result;
+		}
+
+		inline Float4x4 MatrixTranslation(float x, float y, float z)
+		{
+			Float4x4 result = MatrixIdentity();
+			result.m[3][0] = x;
+			result.m[3][1] = y;
+			result.m[3][2] = z;
+			return result;
+		}
+
+		inline Float4x4 MatrixScaling(float x, float y, float z)
+		{
+			Float4x4 result = MatrixIdentity();
+			result.m[0][0] = x;
+			result.m[1][1] = y;
+			result.m[2][2] = z;
+			return result;
+		}
+
+		inline Float4x4 MatrixRotationY(float radians)
+		{
+			float sinAngle;
+			float cosAngle;
+			ScalarSinCos(&sinAngle, &cosAngle, radians);
+
+			Float4x4 result = MatrixIdentity();
+			result.m[0][0] = cosAngle;
+			result.m[0][2] = -sinAngle;
+			result.m[2][0] = sinAngle;
+			result.m[2][2] = cosAngle;
+			return result;
+		}
+
+		//same summation order as XMMatrixMultiply, row * column
+		inline Float4x4 MatrixMultiply(const Float4x4& a, const Float4x4& b)
+		{
+			Float4x4 result;
+			for (int r = 0; r < 4; r++)
+			{
+				float x = a.m[r][0];
+				float y = a.m[r][1];
+				float z = a.m[r][2];
+				float w = a.m[r][3];
+				for (int c = 0; c < 4; c++)
+				{
+					float value = x * b.m[0][c];
+					value = y * b.m[1][c] + value;
+					value = z * b.m[2][c] + value;
+					value = w * b.m[3][c] + value;
+					result.m[r][c] = value;
+				}
+			}
+			return result;
+		}
+
+		inline Float4x4 operator*(const Float4x4& a, const Float4x4& b)
+		{
+			return MatrixMultiply(a, b);
+		}
+
+		inline Float4x4 MatrixTranspose(const Float4x4& a)
+		{
+			Float4x4 result;
+			for (int r = 0; r < 4; r++)
+				for (int c = 0; c < 4; c++)
+					result.m[r][c] = a.m[c][r];
+			return result;
+		}
+
+		//general inverse by cofactors, for unprojecting. A singular matrix comes back as all zeros.
+		inline Float4x4 MatrixInverse(const Float4x4& a)
+		{
+			const float (*m)[4] = a.m;
+			float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+			float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+			float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+			float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+			float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+			float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+			float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+			float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+			float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+			float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+			float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+			float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+			Float4x4 result = {};
+			float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+			if (determinant == 0.0f)
+				return result;
+			float inverse = 1.0f / determinant;
+
+			result.m[0][0] = (m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * inverse;
+			result.m[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * inverse;
+			result.m[0][2] = (m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * inverse;
+			result.m[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * inverse;
+			result.m[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * inverse;
+			result.m[1][1] = (m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * inverse;
+			result.m[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * inverse;
+			result.m[1][3] = (m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * inverse;
+			result.m[2][0] = (m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * inverse;
+			result.m[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * inverse;
+			result.m[2][2] = (m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * inverse;
+			result.m[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * inverse;
+			result.m[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * inverse;
+			result.m[3][1] = (m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * inverse;
+			result.m[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * inverse;
+			result.m[3][3] = (m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * inverse;
+			return result;
+		}
+
+		inline Float3 Subtract(const Float3& a, const Float3& b)
+		{
+			return Float3({ a.x - b.x, a.y - b.y, a.z - b.z });
+		}
+
+		inline float Dot(const Float3& a, const Float3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		inline Float3 Cross(const Float3& a, const Float3& b)
+		{
+			return Float3({ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x });
+		}
+
+		inline Float3 Normalize(const Float3& a)
+		{
+			float length = sqrtf(Dot(a, a));
+			if (length == 0.0f)
+				return a;
+			return Float3({ a.x / length, a.y / length, a.z / length });
+		}
+
+		//XMMatrixPerspectiveFovRH
+		inline Float4x4 MatrixPerspectiveFovRH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+		{
+			float sinFov;
+			float cosFov;
+			ScalarSinCos(&sinFov, &cosFov, 0.5f * fovAngleY);
+
+			float height = cosFov / sinFov;
+			float width = height / aspectRatio;
+			float range = farZ / (nearZ - farZ);
+
+			Float4x4 result = { {
+				{ width, 0.0f, 0.0f, 0.0f },
+				{ 0.0f, height, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, range, -1.0f },
+				{ 0.0f, 0.0f, range * nearZ, 0.0f } } };
+			return result;
+		}
+
+		//XMMatrixLookAtRH, built the same way through the left handed look-to
+		inline Float4x4 MatrixLookAtRH(const Float3& eye, const Float3& at, const Float3& up)
+		{
+			Float3 r2 = Normalize(Subtract(eye, at));
+			Float3 r0 = Normalize(Cross(up, r2));
+			Float3 r1 = Cross(r2, r0);
+			Float3 negEye = Float3({ -eye.x, -eye.y, -eye.z });
+
+			Float4x4 result = { {
+				{ r0.x, r1.x, r2.x, 0.0f },
+				{ r0.y, r1.y, r2.y, 0.0f },
+				{ r0.z, r1.z, r2.z, 0.0f },
+				{ Dot(r0, negEye), Dot(r1, negEye), Dot(r2, negEye), 1.0f } } };
+			return result;
+		}
+	}
+}
@@ -0,0 +1,395 @@
+﻿#include "SimulationThread.h"
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+namespace
+{
+	//when the thread falls further behind than this it stops trying to catch up
+	const int MAX_STEPS_BEHIND = 4;
+
+	//assign keeps the vectors' storage, so once the buffers have gone round a step copies without allocating
+	void CopyChunks(const GridSimulation& simulation, std::vector<TransformChunk>& chunks)
+	{
+		chunks.resize(simulation.GetChunkCount());
+		for (int i = 0; i < simulation.GetChunkCount(); i++)
+		{
+			const TransformChunk& from = simulation.GetChunk(i).transforms;
+			TransformChunk& to = chunks[i];
+			to.firstCell = from.firstCell;
+			to.x.assign(from.x.begin(), from.x.end());
+			to.y.assign(from.y.begin(), from.y.end());
+			to.z.assign(from.z.begin(), from.z.end());
+			to.yaw.assign(from.yaw.begin(), from.yaw.end());
+		}
+	}
+
+	//the part of a whole grid range in each chunk, the chunks already split the way the simulation's are
+	void CopyRange(const GridSimulation& simulation, std::vector<TransformChunk>& chunks, const CellRange& range)
+	{
+		for (int i = 0; i < simulation.GetChunkCount(); i++)
+		{
+			const TransformChunk& from = simulation.GetChunk(i).transforms;
+			int begin = std::max(range.begin - from.firstCell, 0);
+			int end = std::min(range.end - from.firstCell, from.GetCellCount());
+			if (begin >= end)
+				continue;
+
+			TransformChunk& to = chunks[i];
+			std::copy(from.x.begin() + begin, from.x.begin() + end, to.x.begin() + begin);
+			std::copy(from.y.begin() + begin, from.y.begin() + end, to.y.begin() + begin);
+			std::copy(from.z.begin() + begin, from.z.begin() + end, to.z.begin() + begin);
+			std::copy(from.yaw.begin() + begin, from.yaw.begin() + end, to.yaw.begin() + begin);
+		}
+	}
+}
+
+TransformBatch::Inputs FrameInterpolator::Blend(const SimulationFrame& frame, int chunk, float alpha)
+{
+	if (frame.previousSequence == 0)
+		return frame.GetInputs(chunk);
+
+	const TransformChunk& current = frame.chunks[chunk];
+	const TransformChunk& previous = frame.previousChunks[chunk];
+	int count = current.GetCellCount();
+	float* x = m_arena.Allocate<float>(count);
+	float* y = m_arena.Allocate<float>(count);
+	float* z = m_arena.Allocate<float>(count);
+	float* yaw = m_arena.Allocate<float>(count);
+
+	for (int i = 0; i < count; i++)
+	{
+		x[i] = previous.x[i] + (current.x[i] - previous.x[i]) * alpha;
+		y[i] = previous.y[i] + (current.y[i] - previous.y[i]) * alpha;
+		z[i] = previous.z[i] + (current.z[i] - previous.z[i]) * alpha;
+
+		//the short way round, the rotation wraps at two pi
+		float turn = current.yaw[i] - previous.yaw[i];
+		turn -= TWO_PI * floorf(turn / TWO_PI + 0.5f);
+		yaw[i] = previous.yaw[i] + turn * alpha;
+	}
+
+	TransformBatch::Inputs inputs;
+	inputs.x = x;
+	inputs.y = y;
+	inputs.z = z;
+	inputs.yaw = yaw;
+	inputs.scale = nullptr;
+	inputs.uniformScale = frame.previousScale + (frame.scale - frame.previousScale) * alpha;
+	return inputs;
+}
+
+SimulationThread::SimulationThread(int columns, int rows, double stepSeconds) :
+	m_simulation(columns, rows),
+	m_stepSeconds(stepSeconds),
+	m_time(0),
+	m_degreesPerSecond(0),
+	m_resized(false),
+	m_lastChangedSequence(0),
+	m_appliedInputs(0),
+	m_interpolate(false),
+	m_picking(false),
+	m_lastInputSequence(0),
+	m_layoutSequence(0),
+	m_inputsWaiting(false),
+	m_journal(nullptr),
+	m_columns(columns),
+	m_rows(rows),
+	m_queuedInputs(0),
+	m_hasFrame(false),
+	m_stopping(false),
+	m_stepCount(0)
+{
+	//frames only carry the transform inputs, the renderer expands what it draws
+	m_simulation.SetBuildModels(false);
+}
+
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+void SimulationThread::Start(bool paced, int maxSteps)
+{
+	if (IsStarted())
+		return;
+	m_stopping.store(false, std::memory_order_relaxed);
+	m_thread = std::thread(&SimulationThread::ThreadLoop, this, paced, maxSteps);
+}
+
+void SimulationThread::Stop()
+{
+	if (!IsStarted())
+		return;
+	m_stopping.store(true, std::memory_order_relaxed);
+	m_thread.join();
+}
+
+void SimulationThread::ThreadLoop(bool paced, int maxSteps)
+{
+	PROFILE_THREAD_NAME("simulation");
+
+	auto next = std::chrono::steady_clock::now();
+	auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_stepSeconds));
+	while (!m_stopping.load(std::memory_order_relaxed))
+	{
+		if (maxSteps > 0 && GetStepCount() >= maxSteps)
+			break;
+
+		if (paced)
+		{
+			std::this_thread::sleep_until(next);
+			next += step;
+
+			//after a long stall carry on from now rather than running a burst of steps
+			auto now = std::chrono::steady_clock::now();
+			if (now - next > step * MAX_STEPS_BEHIND)
+				next = now;
+		}
+
+		Step();
+	}
+}
+
+void SimulationThread::Step()
+{
+	PROFILE_ZONE("SimulationThread::Step");
+	bool changed = ApplyInputs() || m_inputsWaiting;
+	m_inputsWaiting = false;
+	if (changed)
+		m_lastInputSequence = GetStepCount() + 1;
+
+	//the same fixed step clock the game timer used to drive the rotation with
+	m_time += m_stepSeconds;
+	float radians = static_cast<float>(fmod(m_time * ConvertToRadians(m_degreesPerSecond), TWO_PI));
+
+	int sequence = GetStepCount() + 1;
+	SimulationFrame& frame = m_frames.GetBack();
+
+	//nothing was simulated before the first step or at this size, so no slot can be caught up
+	if (sequence == 1 || m_resized)
+	{
+		m_layoutSequence = sequence;
+		for (std::vector<CellRange>& ranges : m_changeHistory)
+			ranges.reserve(GridSimulation::GetDirtyRangeLimit(m_simulation.GetRowCount()));
+	}
+
+	//a slot that has been round once at this size already has room for everything,
+	//and with no input the simulation needs nothing new either
+	bool steady = !changed && frame.GetChunkCount() == m_simulation.GetChunkCount() &&
+		frame.columns == m_simulation.GetModAmount() && frame.rows == m_simulation.GetRowCount();
+	//an input can switch how the grid is picked, which needs room of its own the first time a slot builds it
+	if (m_picking && frame.sequence < m_lastInputSequence)
+		steady = false;
+	NoAllocationScope noAllocations("SimulationThread::Step", steady);
+
+	//the slot still holds what it was last published with, so only what changed since is copied
+	if (m_interpolate && sequence > m_layoutSequence)
+	{
+		frame.previousScale = m_simulation.GetAdditionalScaling();
+		CopyChangedCells(frame.previousChunks, frame.previousSequence, sequence - 1);
+		frame.previousSequence = sequence - 1;
+	}
+
+	m_simulation.Update(radians);
+	m_changeHistory[sequence % CHANGE_HISTORY] = m_simulation.GetDirtyRanges();
+
+	frame.columns = m_simulation.GetModAmount();
+	frame.rows = m_simulation.GetRowCount();
+	frame.scale = m_simulation.GetAdditionalScaling();
+	bool copied = CopyChangedCells(frame.chunks, frame.sequence, sequence);
+
+	//the picker's inputs point at the slot's chunks, so it only needs building again when they changed
+	if (m_picking && (copied || frame.picker.GetMethod() == GridPicker::Empty))
+	{
+		PROFILE_ZONE("SimulationThread::BuildPicker");
+		frame.picker.Clear(frame.columns, frame.rows);
+		for (int i = 0; i < frame.GetChunkCount(); i++)
+			frame.picker.AddChunk(frame.GetInputs(i), frame.chunks[i].GetCellCount(), frame.chunks[i].firstCell);
+		frame.picker.Finish();
+	}
+
+	if (!m_interpolate)
+	{
+		frame.previousScale = frame.scale;
+		frame.previousSequence = 0;
+	}
+	else if (sequence == m_layoutSequence)
+	{
+		//nothing to blend from
+		frame.previousScale = frame.scale;
+		CopyChunks(m_simulation, frame.previousChunks);
+		frame.previousSequence = sequence;
+	}
+	m_resized = false;
+
+	if (!steady)
+		frame.dirtyRanges.reserve(GridSimulation::GetDirtyRangeLimit(frame.rows));
+	frame.dirtyRanges = m_simulation.GetDirtyRanges();
+	frame.dirtyCellCount = m_simulation.GetDirtyCellCount();
+	if (frame.dirtyCellCount > 0)
+		m_lastChangedSequence = sequence;
+	frame.lastChangedSequence = m_lastChangedSequence;
+	frame.inputCount = m_appliedInputs;
+	frame.sequence = sequence;
+	frame.published = std::chrono::steady_clock::now();
+	m_frames.Publish();
+	m_stepCount.store(sequence, std::memory_order_relaxed);
+}
+
+//Brings chunks holding the grid after step from up to the simulation's after
+//step to, copying the cells each step in between changed.
+bool SimulationThread::CopyChangedCells(std::vector<TransformChunk>& chunks, int from, int to)
+{
+	if (from < m_layoutSequence || to - from > CHANGE_HISTORY || static_cast<int>(chunks.size()) != m_simulation.GetChunkCount())
+	{
+		CopyChunks(m_simulation, chunks);
+		return true;
+	}
+
+	bool copied = false;
+	for (int step = from + 1; step <= to; step++)
+	{
+		for (const CellRange& range : m_changeHistory[step % CHANGE_HISTORY])
+		{
+			CopyRange(m_simulation, chunks, range);
+			copied = true;
+		}
+	}
+	return copied;
+}
+
+const SimulationFrame* SimulationThread::AcquireFrame()
+{
+	if (m_frames.Acquire())
+		m_hasFrame = true;
+	return m_hasFrame ? &m_frames.GetFront() : nullptr;
+}
+
+void SimulationThread::QueueInput(InputType type, float amount, int value, int secondValue)
+{
+	Input input = { type, amount, value, secondValue };
+	while (!m_inputs.Push(input))
+	{
+		//with nothing else stepping this is the stepping thread, so it can make
+		//room itself, otherwise the thread empties the queue on its next step
+		if (IsStarted())
+			std::this_thread::yield();
+		else if (ApplyInputs())
+			m_inputsWaiting = true;
+	}
+	m_queuedInputs++;
+}
+
+//in the order they were queued, the same as when they were called straight on the
+//simulation, false when there were none
+bool SimulationThread::ApplyInputs()
+{
+	int applied = 0;
+	Input input;
+	while (m_inputs.Pop(input))
+	{
+		applied++;
+		//the step these go into, even when QueueInput applies them early to make room
+		if (m_journal)
+			m_journal->Add({ GetStepCount() + 1, static_cast<uint8_t>(input.type), input.amount, input.value, input.secondValue });
+		switch (input.type)
+		{
+		case CameraPosition:
+			m_simulation.ModifyCameraPosition(input.amount, input.value);
+			break;
+		case Perspective:
+			m_simulation.UpdatePerspective(input.amount);
+			break;
+		case PlaneManipulation:
+			m_simulation.SetPlaneManipulation(input.value);
+			break;
+		case DegreesPerSecond:
+			m_degreesPerSecond = input.amount;
+			break;
+		case WavePaused:
+			m_simulation.SetWavePaused(input.value != 0);
+			break;
+		case InvalidateAll:
+			m_simulation.Invalidate();
+			break;
+		case GridSize:
+			m_simulation.Resize(input.value, input.secondValue);
+			m_resized = true;
+			break;
+		}
+	}
+	m_appliedInputs += applied;
+	return applied > 0;
+}
+
+void SimulationThread::ModifyCameraPosition(float amount, int direction)
+{
+	QueueInput(CameraPosition, amount, direction);
+}
+
+void SimulationThread::UpdatePerspective(float amount)
+{
+	QueueInput(Perspective, amount, 0);
+}
+
+void SimulationThread::SetPlaneManipulation(int manipulationType)
+{
+	QueueInput(PlaneManipulation, 0, manipulationType);
+}
+
+void SimulationThread::SetDegreesPerSecond(float degreesPerSecond)
+{
+	QueueInput(DegreesPerSecond, degreesPerSecond, 0);
+}
+
+void SimulationThread::SetWavePaused(bool paused)
+{
+	QueueInput(WavePaused, 0, paused ? 1 : 0);
+}
+
+void SimulationThread::Invalidate()
+{
+	QueueInput(InvalidateAll, 0, 0);
+}
+
+void SimulationThread::SetJournal(InputJournal* journal)
+{
+	m_journal = journal;
+	if (m_journal)
+		m_journal->Begin({ GetColumnCount(), GetRowCount(), m_stepSeconds });
+}
+
+std::vector<uint8_t> SimulationThread::FinishJournal() const
+{
+	if (!m_journal)
+		return std::vector<uint8_t>();
+	return m_journal->Finish(GetStepCount(), GetChecksum());
+}
+
+bool SimulationThread::SaveJournal(const char* path) const
+{
+	return m_journal && m_journal->Save(path, GetStepCount(), GetChecksum());
+}
+
+void SimulationThread::Replay(const InputJournal::Record& record)
+{
+	if (record.type == GridSize)
+	{
+		Resize(record.value, record.secondValue);
+		return;
+	}
+	QueueInput(static_cast<InputType>(record.type), record.amount, record.value, record.secondValue);
+}
+
+void SimulationThread::Resize(int columns, int rows)
+{
+	m_columns.store(columns, std::memory_order_relaxed);
+	m_rows.store(rows, std::memory_order_relaxed);
+	QueueInput(GridSize, 0, columns, rows);
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "FrameArena.h"
+#include "GridPicker.h"
+#include "GridSimulation.h"
+#include "InputJournal.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+
+namespace DirectX11_Game
+{
+	//One fixed step of the grid as the renderer sees it, the transform inputs
+	//after the step and the ones before it so a frame can be drawn in between.
+	//Both are split into the simulation's chunks.
+	struct SimulationFrame
+	{
+		SimulationFrame() : sequence(0), columns(0), rows(0), scale(1), previousScale(1), previousSequence(0),
+			dirtyCellCount(0), lastChangedSequence(0), inputCount(0) {}
+
+		//steps since the simulation started, 1 for the first
+		int sequence;
+		//when it was published, for working out how far past it the renderer is
+		std::chrono::steady_clock::time_point published;
+
+		//the grid this step ran at, the chunks change with it
+		int columns;
+		int rows;
+
+		float scale;
+		std::vector<TransformChunk> chunks;
+
+		//The same as the step's own on the first step after a resize. Only kept
+		//while the thread is interpolating, see SimulationThread::SetInterpolation.
+		float previousScale;
+		std::vector<TransformChunk> previousChunks;
+		//the step previousChunks are from, 0 when they aren't kept
+		int previousSequence;
+
+		//what changed from the step before, see GridSimulation::GetDirtyRanges
+		std::vector<CellRange> dirtyRanges;
+		int dirtyCellCount;
+		//the newest step that changed any cell, this one's own sequence when it did
+		int lastChangedSequence;
+		//inputs applied up to and including this step, see GetQueuedInputCount
+		int inputCount;
+
+		//over this step's own chunks, only built while the thread is picking, see SimulationThread::SetPicking
+		GridPicker picker;
+
+		int GetCellCount() const { return columns * rows; }
+		int GetChunkCount() const { return static_cast<int>(chunks.size()); }
+		TransformBatch::Inputs GetInputs(int chunk) const { return chunks[chunk].GetInputs(scale); }
+	};
+
+	//Blends the two states in a frame, for rendering more often than the simulation
+	//steps. The blended positions and yaws only last a render, so they come out of
+	//a frame arena as cache line aligned arrays.
+	class FrameInterpolator
+	{
+	public:
+		FrameInterpolator(bool hugePages = false) : m_arena(0, hugePages) {}
+
+		//drops the last render's blends, call once before blending a new one
+		void BeginFrame() { m_arena.Reset(); }
+
+		//0 is the step before, 1 the frame's own step. The result stays valid
+		//until the next BeginFrame. A frame without the step before is its own step.
+		TransformBatch::Inputs Blend(const SimulationFrame& frame, int chunk, float alpha);
+
+		const FrameArena& GetArena() const { return m_arena; }
+
+	private:
+		FrameArena m_arena;
+	};
+
+	//Runs GridSimulation at a fixed step on its own thread and publishes every step
+	//through a triple buffer, so a slow step never holds up a render and a slow
+	//render never holds up the simulation. Step runs the same thing on the caller
+	//instead, for when the thread isn't started.
+	class SimulationThread
+	{
+	public:
+		SimulationThread(int columns, int rows, double stepSeconds = 1.0 / 60);
+		~SimulationThread();
+
+		SimulationThread(const SimulationThread&) = delete;
+		SimulationThread& operator=(const SimulationThread&) = delete;
+
+		//paced runs a step every stepSeconds, otherwise they run back to back.
+		//maxSteps stops stepping after that many, 0 keeps going until Stop.
+		void Start(bool paced = true, int maxSteps = 0);
+		void Stop();
+		bool IsStarted() const { return m_thread.joinable(); }
+
+		//one step on the calling thread, only while the thread isn't started
+		void Step();
+
+		//the newest published frame, nullptr before the first step. Never blocks,
+		//and the frame stays valid until the next call.
+		const SimulationFrame* AcquireFrame();
+
+		//From one thread at a time, whichever drives the renderer. Applied at the
+		//start of the next step, in the order they were called.
+		void ModifyCameraPosition(float amount, int direction);
+		void UpdatePerspective(float amount);
+		void SetPlaneManipulation(int manipulationType);
+		void SetDegreesPerSecond(float degreesPerSecond);
+		void SetWavePaused(bool paused);
+		void Invalidate();
+		//frames come out at the new size from the next step on
+		void Resize(int columns, int rows);
+
+		//only while the thread isn't started
+		void SetWorkerCount(int workerCount) { m_simulation.SetWorkerCount(workerCount); }
+		//keeps the step before in every frame for FrameInterpolator, off by default.
+		//Only while the thread isn't started.
+		void SetInterpolation(bool interpolate) { m_interpolate = interpolate; }
+		//Builds every frame's picker as part of the step, so a press is picked
+		//without building anything on the thread that reads the frame. Off by
+		//default, and only while the thread isn't started.
+		void SetPicking(bool picking) { m_picking = picking; }
+
+		//Records every input as it is applied from here on, before the first step
+		//so a replay starting from a new simulation ends up in the same place.
+		//The journal has to outlive the thread.
+		void SetJournal(InputJournal* journal);
+		//The journal up to the last step with its end record, only while the
+		//thread isn't started. Recording carries on after.
+		std::vector<uint8_t> FinishJournal() const;
+		bool SaveJournal(const char* path) const;
+		//queues a recorded input the same as the call that recorded it, for replaying a journal
+		void Replay(const InputJournal::Record& record);
+		//the grid after the last step, see InputJournal::Checksum. Only while the thread isn't started.
+		uint64_t GetChecksum() const { return InputJournal::Checksum(m_simulation); }
+
+		//the size last asked for, a frame already published can still be at the old one
+		int GetColumnCount() const { return m_columns.load(std::memory_order_relaxed); }
+		int GetRowCount() const { return m_rows.load(std::memory_order_relaxed); }
+		double GetStepSeconds() const { return m_stepSeconds; }
+		int GetStepCount() const { return m_stepCount.load(std::memory_order_relaxed); }
+		//inputs queued so far from the input side, a frame has applied them all once its inputCount reaches this
+		int GetQueuedInputCount() const { return m_queuedInputs; }
+
+	private:
+		enum InputType
+		{
+			CameraPosition,
+			Perspective,
+			PlaneManipulation,
+			DegreesPerSecond,
+			WavePaused,
+			InvalidateAll,
+			GridSize
+		};
+
+		struct Input
+		{
+			InputType type;
+			float amount;
+			int value;
+			int secondValue;
+		};
+
+		//more than a second of steps' worth of input, only fills when stepping has stopped
+		static const uint32_t INPUT_CAPACITY = 1024;
+		//steps of dirty ranges kept for catching a slot up, a slot the reader held longer is copied whole
+		static const int CHANGE_HISTORY = 4;
+
+		void QueueInput(InputType type, float amount, int value, int secondValue = 0);
+		bool ApplyInputs();
+		void ThreadLoop(bool paced, int maxSteps);
+		//false when none of the chunks needed anything copied
+		bool CopyChangedCells(std::vector<TransformChunk>& chunks, int from, int to);
+
+		GridSimulation m_simulation;
+		double m_stepSeconds;
+
+		//only touched by whichever thread is stepping
+		double m_time;
+		float m_degreesPerSecond;
+		bool m_resized;
+		int m_lastChangedSequence;
+		int m_appliedInputs;
+		bool m_interpolate;
+		bool m_picking;
+		//the last step that applied any input
+		int m_lastInputSequence;
+		//the first step at the current size, slots from before it are copied whole
+		int m_layoutSequence;
+		//each step's dirty ranges at its sequence % CHANGE_HISTORY
+		std::vector<CellRange> m_changeHistory[CHANGE_HISTORY];
+		//applied early by QueueInput to make room, owed to the next step
+		bool m_inputsWaiting;
+		//written as inputs are applied, read back only while stopped
+		InputJournal* m_journal;
+
+		std::atomic<int> m_columns;
+		std::atomic<int> m_rows;
+
+		SpscQueue<Input, INPUT_CAPACITY> m_inputs;
+		//only touched by the input side
+		int m_queuedInputs;
+
+		TripleBuffer<SimulationFrame> m_frames;
+		bool m_hasFrame;
+
+		std::thread m_thread;
+		std::atomic<bool> m_stopping;
+		std::atomic<int> m_stepCount;
+	};
+}
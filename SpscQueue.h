@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace DirectX11_Game
+{
+	//A fixed size ring that hands values from one writer thread to one reader
+	//thread in order, without locks and without either side waiting. Push fails
+	//when the ring is full and Pop when it is empty, what to do then is up to
+	//the caller.
+	//
+	//The positions only ever count up and wrap through uint32_t, the slot is the
+	//position masked by the capacity. Each side keeps a copy of the other's
+	//position and only reloads it when the copy says the ring is full or empty,
+	//so most calls touch no cache line the other thread is writing.
+	template<class T, uint32_t CAPACITY>
+	class SpscQueue
+	{
+		static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "the capacity has to be a power of two");
+
+	public:
+		SpscQueue() : m_head(0), m_tailCopy(0), m_tail(0), m_headCopy(0) {}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		//writer only
+		bool Push(const T& value)
+		{
+			uint32_t tail = m_tail.load(std::memory_order_relaxed);
+			if (tail - m_headCopy == CAPACITY)
+			{
+				m_headCopy = m_head.load(std::memory_order_acquire);
+				if (tail - m_headCopy == CAPACITY)
+					return false;
+			}
+			m_slots[tail & (CAPACITY - 1)] = value;
+			m_tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		//reader only
+		bool Pop(T& value)
+		{
+			uint32_t head = m_head.load(std::memory_order_relaxed);
+			if (head == m_tailCopy)
+			{
+				m_tailCopy = m_tail.load(std::memory_order_acquire);
+				if (head == m_tailCopy)
+					return false;
+			}
+			value = m_slots[head & (CAPACITY - 1)];
+			m_head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		//a snapshot from either side, only exact from a thread that isn't racing the other
+		uint32_t GetSize() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+		static uint32_t GetCapacity() { return CAPACITY; }
+
+	private:
+		//the reader's side and the writer's side on their own cache lines
+		alignas(64) std::atomic<uint32_t> m_head;
+		uint32_t m_tailCopy;
+		alignas(64) std::atomic<uint32_t> m_tail;
+		uint32_t m_headCopy;
+		alignas(64) T m_slots[CAPACITY];
+	};
+}
@@ -0,0 +1,162 @@
+﻿#include "StateTrackingBackend.h"
+
+using namespace DirectX11_Game;
+
+StateTrackingBackend::StateTrackingBackend(RenderBackend& target) :
+	m_target(target),
+	m_known(0),
+	m_vertexBuffers(),
+	m_indexBuffer(nullptr),
+	m_indexFormat(IndexFormat::Index16),
+	m_indexOffset(0),
+	m_topology(PrimitiveTopology::TriangleList),
+	m_inputLayout(nullptr),
+	m_vertexShader(nullptr),
+	m_constantBuffers(),
+	m_pixelShader(nullptr),
+	m_frame(),
+	m_lastFrame()
+{
+}
+
+void StateTrackingBackend::BeginFrame()
+{
+	m_lastFrame = m_frame;
+	m_frame = Counters();
+	Invalidate();
+}
+
+void StateTrackingBackend::Invalidate()
+{
+	m_known = 0;
+}
+
+bool StateTrackingBackend::NeedsBind(unsigned int bit, bool same)
+{
+	unsigned int mask = 1u << bit;
+	if ((m_known & mask) && same)
+	{
+		m_frame.skipped++;
+		return false;
+	}
+
+	m_known |= mask;
+	m_frame.issued++;
+	return true;
+}
+
+void StateTrackingBackend::UpdateBuffer(void* buffer, const void* data, unsigned int size)
+{
+	m_frame.uploads++;
+	m_target.UpdateBuffer(buffer, data, size);
+}
+
+void StateTrackingBackend::UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	m_frame.uploads++;
+	m_target.UpdateBufferRegion(buffer, offset, data, size);
+}
+
+void StateTrackingBackend::WriteDynamicBuffer(void* buffer, const void* data, unsigned int size)
+{
+	m_frame.uploads++;
+	m_target.WriteDynamicBuffer(buffer, data, size);
+}
+
+void StateTrackingBackend::SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset)
+{
+	//slots past the tracked ones are rare enough to always send
+	if (slot >= TRACKED_SLOTS)
+	{
+		m_frame.issued++;
+		m_target.SetVertexBuffer(slot, buffer, stride, offset);
+		return;
+	}
+
+	VertexBufferState& state = m_vertexBuffers[slot];
+	bool same = state.buffer == buffer && state.stride == stride && state.offset == offset;
+	if (NeedsBind(VERTEX_BUFFER_BITS + slot, same))
+	{
+		state.buffer = buffer;
+		state.stride = stride;
+		state.offset = offset;
+		m_target.SetVertexBuffer(slot, buffer, stride, offset);
+	}
+}
+
+void StateTrackingBackend::SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset)
+{
+	bool same = m_indexBuffer == buffer && m_indexFormat == format && m_indexOffset == offset;
+	if (NeedsBind(INDEX_BUFFER_BIT, same))
+	{
+		m_indexBuffer = buffer;
+		m_indexFormat = format;
+		m_indexOffset = offset;
+		m_target.SetIndexBuffer(buffer, format, offset);
+	}
+}
+
+void StateTrackingBackend::SetPrimitiveTopology(PrimitiveTopology topology)
+{
+	if (NeedsBind(TOPOLOGY_BIT, m_topology == topology))
+	{
+		m_topology = topology;
+		m_target.SetPrimitiveTopology(topology);
+	}
+}
+
+void StateTrackingBackend::SetInputLayout(void* inputLayout)
+{
+	if (NeedsBind(INPUT_LAYOUT_BIT, m_inputLayout == inputLayout))
+	{
+		m_inputLayout = inputLayout;
+		m_target.SetInputLayout(inputLayout);
+	}
+}
+
+void StateTrackingBackend::SetVertexShader(void* shader)
+{
+	if (NeedsBind(VERTEX_SHADER_BIT, m_vertexShader == shader))
+	{
+		m_vertexShader = shader;
+		m_target.SetVertexShader(shader);
+	}
+}
+
+void StateTrackingBackend::SetVertexConstantBuffer(unsigned int slot, void* buffer)
+{
+	if (slot >= TRACKED_SLOTS)
+	{
+		m_frame.issued++;
+		m_target.SetVertexConstantBuffer(slot, buffer);
+		return;
+	}
+
+	if (NeedsBind(CONSTANT_BUFFER_BITS + slot, m_constantBuffers[slot] == buffer))
+	{
+		m_constantBuffers[slot] = buffer;
+		m_target.SetVertexConstantBuffer(slot, buffer);
+	}
+}
+
+void StateTrackingBackend::SetPixelShader(void* shader)
+{
+	if (NeedsBind(PIXEL_SHADER_BIT, m_pixelShader == shader))
+	{
+		m_pixelShader = shader;
+		m_target.SetPixelShader(shader);
+	}
+}
+
+void StateTrackingBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	m_frame.draws++;
+	m_target.DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateTrackingBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+	unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	m_frame.draws++;
+	m_target.DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "RenderBackend.h"
+
+namespace DirectX11_Game
+{
+	//Sits between the renderer and a real backend and drops binds that would set
+	//what is already bound. Uploads and draws always go through.
+	//Other renderers share the immediate context (the sprite batch, the fps text)
+	//so the cached state has to be invalidated before the grid starts drawing.
+	class StateTrackingBackend : public RenderBackend
+	{
+	public:
+		struct Counters
+		{
+			unsigned int issued;
+			unsigned int skipped;
+			unsigned int uploads;
+			unsigned int draws;
+		};
+
+		StateTrackingBackend(RenderBackend& target);
+
+		//starts a new set of frame counters and forgets what is bound
+		void BeginFrame();
+		void Invalidate();
+
+		const Counters& GetFrameCounters() const { return m_frame; }
+		const Counters& GetLastFrameCounters() const { return m_lastFrame; }
+
+		void UpdateBuffer(void* buffer, const void* data, unsigned int size) override;
+		void UpdateBufferRegion(void* buffer, unsigned int offset, const void* data, unsigned int size) override;
+		void WriteDynamicBuffer(void* buffer, const void* data, unsigned int size) override;
+
+		void SetVertexBuffer(unsigned int slot, void* buffer, unsigned int stride, unsigned int offset) override;
+		void SetIndexBuffer(void* buffer, IndexFormat format, unsigned int offset) override;
+		void SetPrimitiveTopology(PrimitiveTopology topology) override;
+		void SetInputLayout(void* inputLayout) override;
+		void SetVertexShader(void* shader) override;
+		void SetVertexConstantBuffer(unsigned int slot, void* buffer) override;
+		void SetPixelShader(void* shader) override;
+
+		void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+		void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+			unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+
+	private:
+		static const unsigned int TRACKED_SLOTS = 8;
+
+		struct VertexBufferState
+		{
+			void* buffer;
+			unsigned int stride;
+			unsigned int offset;
+		};
+
+		//one bit per piece of state, set once it has been bound since the last invalidate
+		enum KnownBits
+		{
+			VERTEX_BUFFER_BITS = 0,
+			CONSTANT_BUFFER_BITS = VERTEX_BUFFER_BITS + TRACKED_SLOTS,
+			INDEX_BUFFER_BIT = CONSTANT_BUFFER_BITS + TRACKED_SLOTS,
+			TOPOLOGY_BIT,
+			INPUT_LAYOUT_BIT,
+			VERTEX_SHADER_BIT,
+			PIXEL_SHADER_BIT
+		};
+
+		//true when the bind has to be sent, counts it either way
+		bool NeedsBind(unsigned int bit, bool same);
+
+		RenderBackend& m_target;
+		unsigned int m_known;
+
+		VertexBufferState m_vertexBuffers[TRACKED_SLOTS];
+		void* m_indexBuffer;
+		IndexFormat m_indexFormat;
+		unsigned int m_indexOffset;
+		PrimitiveTopology m_topology;
+		void* m_inputLayout;
+		void* m_vertexShader;
+		void* m_constantBuffers[TRACKED_SLOTS];
+		void* m_pixelShader;
+
+		Counters m_frame;
+		Counters m_lastFrame;
+	};
+}
@@ -0,0 +1,232 @@
+﻿//Runs scripted bind sequences through StateTrackingBackend into a recording
+//backend and checks what was dropped, what went through and the order it went
+//through in. Registered with ctest, exits non zero on the first failed script.
+
+#include <cstdio>
+#include <vector>
+
+#include "InstanceBatch.h"
+#include "RecordingRenderBackend.h"
+#include "StateTrackingBackend.h"
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	typedef RecordingRenderBackend Recorder;
+
+	int g_failures = 0;
+
+	void Check(bool passed, const char* script, const char* what)
+	{
+		if (passed)
+			return;
+		printf("  %s: %s\n", script, what);
+		g_failures++;
+	}
+
+	void CheckCounters(const StateTrackingBackend& tracker, const char* script,
+		unsigned int issued, unsigned int skipped, unsigned int uploads, unsigned int draws)
+	{
+		const StateTrackingBackend::Counters& counters = tracker.GetFrameCounters();
+		if (counters.issued == issued && counters.skipped == skipped && counters.uploads == uploads && counters.draws == draws)
+			return;
+		printf("  %s: issued %u skipped %u uploads %u draws %u, expected %u %u %u %u\n", script,
+			counters.issued, counters.skipped, counters.uploads, counters.draws, issued, skipped, uploads, draws);
+		g_failures++;
+	}
+
+	//the recorded calls by type and resource, the arguments are checked where they matter
+	void CheckCommands(const Recorder& recorder, const char* script, const std::vector<Recorder::CommandType>& types,
+		const std::vector<const void*>& resources)
+	{
+		const std::vector<Recorder::Command>& commands = recorder.GetCommands();
+		bool same = commands.size() == types.size();
+		for (size_t i = 0; same && i < commands.size(); i++)
+			same = commands[i].type == types[i] && commands[i].resource == resources[i];
+		if (same)
+			return;
+
+		printf("  %s: recorded", script);
+		for (const Recorder::Command& command : commands)
+			printf(" %s", Recorder::GetCommandName(command.type));
+		printf("\n");
+		g_failures++;
+	}
+
+	//stand ins for the device objects, only their addresses are compared
+	char g_resources[16];
+	void* const VERTICES = &g_resources[0];
+	void* const INDICES = &g_resources[1];
+	void* const LAYOUT = &g_resources[2];
+	void* const VERTEX_SHADER = &g_resources[3];
+	void* const PIXEL_SHADER = &g_resources[4];
+	void* const FRAME_CONSTANTS = &g_resources[5];
+	void* const OBJECT_CONSTANTS = &g_resources[6];
+	void* const OTHER_LAYOUT = &g_resources[7];
+	void* const OTHER_SHADER = &g_resources[8];
+	void* const OTHER_CONSTANTS = &g_resources[9];
+
+	InstanceDrawBindings CubeBindings()
+	{
+		InstanceDrawBindings bindings = {};
+		bindings.vertexBuffer = VERTICES;
+		bindings.vertexStride = 24;
+		bindings.indexBuffer = INDICES;
+		bindings.indexFormat = IndexFormat::Index16;
+		bindings.indexCount = 36;
+		bindings.inputLayout = LAYOUT;
+		bindings.vertexShader = VERTEX_SHADER;
+		bindings.pixelShader = PIXEL_SHADER;
+		bindings.frameConstantBuffer = FRAME_CONSTANTS;
+		bindings.objectConstantBuffer = OBJECT_CONSTANTS;
+		bindings.objectConstantsSize = 64;
+		return bindings;
+	}
+
+	//the same cube drawn three times, only the first draw binds anything
+	void RepeatedCubes()
+	{
+		const char* script = "repeated cubes";
+		Recorder recorder;
+		StateTrackingBackend tracker(recorder);
+		tracker.BeginFrame();
+
+		float constants[16] = {};
+		InstanceDrawBindings bindings = CubeBindings();
+		for (int i = 0; i < 3; i++)
+			InstanceBatch::SubmitSingle(tracker, bindings, constants);
+
+		CheckCounters(tracker, script, 8, 16, 3, 3);
+		CheckCommands(recorder, script,
+			{ Recorder::UpdateBufferCommand, Recorder::SetVertexBufferCommand, Recorder::SetIndexBufferCommand,
+			Recorder::SetPrimitiveTopologyCommand, Recorder::SetInputLayoutCommand, Recorder::SetVertexShaderCommand,
+			Recorder::SetVertexConstantBufferCommand, Recorder::SetVertexConstantBufferCommand, Recorder::SetPixelShaderCommand,
+			Recorder::DrawIndexedCommand,
+			Recorder::UpdateBufferCommand, Recorder::DrawIndexedCommand,
+			Recorder::UpdateBufferCommand, Recorder::DrawIndexedCommand },
+			{ OBJECT_CONSTANTS, VERTICES, INDICES, nullptr, LAYOUT, VERTEX_SHADER, FRAME_CONSTANTS, OBJECT_CONSTANTS, PIXEL_SHADER,
+			nullptr, OBJECT_CONSTANTS, nullptr, OBJECT_CONSTANTS, nullptr });
+	}
+
+	//something else drew in between, so everything has to be bound again
+	void BeginFrameForgets()
+	{
+		const char* script = "begin frame";
+		Recorder recorder;
+		StateTrackingBackend tracker(recorder);
+		tracker.BeginFrame();
+		tracker.SetInputLayout(LAYOUT);
+		tracker.SetVertexShader(VERTEX_SHADER);
+		tracker.SetInputLayout(LAYOUT);
+		CheckCounters(tracker, script, 2, 1, 0, 0);
+
+		recorder.Clear();
+		tracker.BeginFrame();
+		const StateTrackingBackend::Counters& last = tracker.GetLastFrameCounters();
+		Check(last.issued == 2 && last.skipped == 1, script, "the last frame's counters were not kept");
+
+		tracker.SetInputLayout(LAYOUT);
+		tracker.SetVertexShader(VERTEX_SHADER);
+		tracker.SetVertexShader(VERTEX_SHADER);
+		CheckCounters(tracker, script, 2, 1, 0, 0);
+		CheckCommands(recorder, script, { Recorder::SetInputLayoutCommand, Recorder::SetVertexShaderCommand }, { LAYOUT, VERTEX_SHADER });
+	}
+
+	//Updating a buffer leaves it bound, so binding it again after is still
+	//dropped, while the update itself always goes through. A different buffer in
+	//the slot is sent, and so is switching back.
+	void RebindAfterUpdate()
+	{
+		const char* script = "rebind after update";
+		Recorder recorder;
+		StateTrackingBackend tracker(recorder);
+		tracker.BeginFrame();
+
+		float constants[16] = {};
+		tracker.SetVertexConstantBuffer(1, OBJECT_CONSTANTS);
+		tracker.UpdateBuffer(OBJECT_CONSTANTS, constants, sizeof(constants));
+		tracker.SetVertexConstantBuffer(1, OBJECT_CONSTANTS);
+		tracker.UpdateBufferRegion(OBJECT_CONSTANTS, 16, constants, 16);
+		tracker.SetVertexConstantBuffer(1, OBJECT_CONSTANTS);
+		tracker.SetVertexConstantBuffer(1, OTHER_CONSTANTS);
+		tracker.SetVertexConstantBuffer(1, OBJECT_CONSTANTS);
+		//the same buffer in another slot is its own bind
+		tracker.SetVertexConstantBuffer(0, OBJECT_CONSTANTS);
+
+		CheckCounters(tracker, script, 4, 2, 2, 0);
+		CheckCommands(recorder, script,
+			{ Recorder::SetVertexConstantBufferCommand, Recorder::UpdateBufferCommand, Recorder::UpdateBufferRegionCommand,
+			Recorder::SetVertexConstantBufferCommand, Recorder::SetVertexConstantBufferCommand, Recorder::SetVertexConstantBufferCommand },
+			{ OBJECT_CONSTANTS, OBJECT_CONSTANTS, OBJECT_CONSTANTS, OTHER_CONSTANTS, OBJECT_CONSTANTS, OBJECT_CONSTANTS });
+		Check(recorder.GetCommands().back().args[0] == 0, script, "the last bind went to the wrong slot");
+	}
+
+	//every argument of a vertex or index buffer bind counts, not just the buffer
+	void BufferArguments()
+	{
+		const char* script = "buffer arguments";
+		Recorder recorder;
+		StateTrackingBackend tracker(recorder);
+		tracker.BeginFrame();
+
+		tracker.SetVertexBuffer(0, VERTICES, 24, 0);
+		tracker.SetVertexBuffer(0, VERTICES, 24, 0);
+		tracker.SetVertexBuffer(0, VERTICES, 20, 0);
+		tracker.SetVertexBuffer(0, VERTICES, 20, 4);
+		tracker.SetVertexBuffer(1, VERTICES, 20, 4);
+		tracker.SetIndexBuffer(INDICES, IndexFormat::Index16, 0);
+		tracker.SetIndexBuffer(INDICES, IndexFormat::Index32, 0);
+		tracker.SetIndexBuffer(INDICES, IndexFormat::Index32, 0);
+		//slots past the tracked ones always go out
+		tracker.SetVertexBuffer(9, VERTICES, 24, 0);
+		tracker.SetVertexBuffer(9, VERTICES, 24, 0);
+
+		CheckCounters(tracker, script, 8, 2, 0, 0);
+		Check(recorder.GetCount(Recorder::SetVertexBufferCommand) == 6, script, "wrong number of vertex buffer binds");
+		Check(recorder.GetCount(Recorder::SetIndexBufferCommand) == 2, script, "wrong number of index buffer binds");
+	}
+
+	//a shader switch in the middle of a run only sends the binds that changed
+	void SwitchingShaders()
+	{
+		const char* script = "switching shaders";
+		Recorder recorder;
+		StateTrackingBackend tracker(recorder);
+		tracker.BeginFrame();
+
+		float constants[16] = {};
+		InstanceDrawBindings bindings = CubeBindings();
+		InstanceDrawBindings other = bindings;
+		other.inputLayout = OTHER_LAYOUT;
+		other.vertexShader = OTHER_SHADER;
+
+		InstanceBatch::SubmitSingle(tracker, bindings, constants);
+		recorder.Clear();
+		InstanceBatch::SubmitSingle(tracker, other, constants);
+		InstanceBatch::SubmitSingle(tracker, bindings, constants);
+
+		CheckCounters(tracker, script, 12, 12, 3, 3);
+		CheckCommands(recorder, script,
+			{ Recorder::UpdateBufferCommand, Recorder::SetInputLayoutCommand, Recorder::SetVertexShaderCommand, Recorder::DrawIndexedCommand,
+			Recorder::UpdateBufferCommand, Recorder::SetInputLayoutCommand, Recorder::SetVertexShaderCommand, Recorder::DrawIndexedCommand },
+			{ OBJECT_CONSTANTS, OTHER_LAYOUT, OTHER_SHADER, nullptr, OBJECT_CONSTANTS, LAYOUT, VERTEX_SHADER, nullptr });
+	}
+}
+
+int main()
+{
+	RepeatedCubes();
+	BeginFrameForgets();
+	RebindAfterUpdate();
+	BufferArguments();
+	SwitchingShaders();
+
+	if (g_failures > 0)
+	{
+		printf("%d checks failed\n", g_failures);
+		return 1;
+	}
+	printf("all bind scripts passed\n");
+	return 0;
+}
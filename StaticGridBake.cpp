@@ -0,0 +1,178 @@
+﻿#include "StaticGridBake.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+namespace
+{
+	//cells multiplied out at once, enough to keep TransformBatch on its vector path
+	const int BAKE_RUN = 1024;
+}
+
+StaticGridBake::StaticGridBake() :
+	m_cellsPerChunk(0),
+	m_baked(false),
+	m_cellCount(0),
+	m_bakedChange(-1),
+	m_lastChange(-1),
+	m_bakeMilliseconds(0),
+	m_bakeCount(0)
+{
+}
+
+void StaticGridBake::SetMesh(const Mesh& mesh)
+{
+	m_mesh = mesh;
+	int vertexCount = mesh.GetVertexCount();
+	m_cellsPerChunk = vertexCount > 0 && vertexCount <= MAX_CHUNK_VERTICES ? MAX_CHUNK_VERTICES / vertexCount : 0;
+	Clear();
+}
+
+bool StaticGridBake::Track(int sequence, int lastChangedSequence)
+{
+	m_lastChange = lastChangedSequence;
+	if (m_baked && lastChangedSequence != m_bakedChange)
+		Clear();
+	return sequence - lastChangedSequence >= STILL_STEPS;
+}
+
+bool StaticGridBake::IsWorthBaking(int cellCount, int liveDrawCalls) const
+{
+	if (m_cellsPerChunk == 0)
+		return false;
+	long long vertices = static_cast<long long>(cellCount) * m_mesh.GetVertexCount();
+	return vertices <= MAX_VERTICES && GetChunkCountFor(cellCount) < liveDrawCalls;
+}
+
+void StaticGridBake::Clear()
+{
+	m_chunks.clear();
+	m_baked = false;
+	m_cellCount = 0;
+	m_bakedChange = -1;
+}
+
+int StaticGridBake::GetChunkCountFor(int cellCount) const
+{
+	return m_cellsPerChunk > 0 ? (cellCount + m_cellsPerChunk - 1) / m_cellsPerChunk : 0;
+}
+
+void StaticGridBake::Begin()
+{
+	Clear();
+	m_bakeStart = std::chrono::steady_clock::now();
+}
+
+StaticGridBake::Chunk& StaticGridBake::NextChunk()
+{
+	m_chunks.emplace_back();
+	Chunk& chunk = m_chunks.back();
+	chunk.firstCell = m_cellCount;
+	chunk.cellCount = 0;
+	chunk.indexCount = 0;
+	chunk.vertexBuffer = nullptr;
+	chunk.indexBuffer = nullptr;
+	chunk.vertices.reserve(static_cast<size_t>(m_cellsPerChunk) * m_mesh.GetVertexCount());
+	chunk.indices.reserve(static_cast<size_t>(m_cellsPerChunk) * m_mesh.GetIndexCount());
+	return chunk;
+}
+
+void StaticGridBake::Add(const TransformBatch::Inputs& transforms, int count)
+{
+	PROFILE_ZONE("StaticGridBake::Add");
+	m_models.resize(BAKE_RUN);
+
+	for (int first = 0; first < count; first += BAKE_RUN)
+	{
+		int run = std::min(BAKE_RUN, count - first);
+		TransformBatch::Inputs inputs = transforms;
+		inputs.x += first;
+		inputs.y += first;
+		inputs.z += first;
+		inputs.yaw += first;
+		if (inputs.scale)
+			inputs.scale += first;
+		TransformBatch::Build(inputs, run, m_models.data());
+
+		for (int i = 0; i < run; i++)
+		{
+			if (m_chunks.empty() || m_chunks.back().cellCount == m_cellsPerChunk)
+				NextChunk();
+			Chunk& chunk = m_chunks.back();
+
+			//the models are transposed, so each row of the matrix is one output component
+			const Float4x4& model = m_models[i];
+			uint16_t base = static_cast<uint16_t>(chunk.vertices.size());
+			for (const MeshVertex& vertex : m_mesh.vertices)
+			{
+				const Float3& p = vertex.position;
+				MeshVertex baked;
+				baked.position.x = model.m[0][0] * p.x + model.m[0][1] * p.y + model.m[0][2] * p.z + model.m[0][3];
+				baked.position.y = model.m[1][0] * p.x + model.m[1][1] * p.y + model.m[1][2] * p.z + model.m[1][3];
+				baked.position.z = model.m[2][0] * p.x + model.m[2][1] * p.y + model.m[2][2] * p.z + model.m[2][3];
+				baked.color = vertex.color;
+				chunk.vertices.push_back(baked);
+			}
+			for (uint32_t index : m_mesh.indices)
+				chunk.indices.push_back(static_cast<uint16_t>(base + index));
+
+			chunk.cellCount++;
+			chunk.indexCount += m_mesh.GetIndexCount();
+			m_cellCount++;
+		}
+	}
+}
+
+void StaticGridBake::End()
+{
+	m_baked = true;
+	m_bakedChange = m_lastChange;
+	m_bakeCount++;
+	m_bakeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_bakeStart).count();
+}
+
+void StaticGridBake::ReleaseGeometry()
+{
+	for (Chunk& chunk : m_chunks)
+	{
+		std::vector<MeshVertex>().swap(chunk.vertices);
+		std::vector<uint16_t>().swap(chunk.indices);
+	}
+}
+
+void StaticGridBake::Submit(RenderBackend& backend, const InstanceDrawBindings& bindings) const
+{
+	PROFILE_ZONE("StaticGridBake::Submit");
+	//the vertices are already in world space
+	static const Float4x4 identity = { {
+		{ 1, 0, 0, 0 },
+		{ 0, 1, 0, 0 },
+		{ 0, 0, 1, 0 },
+		{ 0, 0, 0, 1 } } };
+	backend.UpdateBuffer(bindings.objectConstantBuffer, &identity, sizeof(identity));
+
+	backend.SetPrimitiveTopology(PrimitiveTopology::TriangleList);
+	backend.SetInputLayout(bindings.inputLayout);
+	backend.SetVertexShader(bindings.vertexShader);
+	backend.SetVertexConstantBuffer(0, bindings.frameConstantBuffer);
+	backend.SetVertexConstantBuffer(1, bindings.objectConstantBuffer);
+	backend.SetPixelShader(bindings.pixelShader);
+
+	for (const Chunk& chunk : m_chunks)
+	{
+		backend.SetVertexBuffer(0, chunk.vertexBuffer, sizeof(MeshVertex), 0);
+		backend.SetIndexBuffer(chunk.indexBuffer, IndexFormat::Index16, 0);
+		backend.DrawIndexed(chunk.indexCount, 0, 0);
+	}
+}
+
+size_t StaticGridBake::GetMemoryBytes() const
+{
+	size_t bytes = m_models.capacity() * sizeof(Float4x4);
+	for (const Chunk& chunk : m_chunks)
+		bytes += chunk.vertices.capacity() * sizeof(MeshVertex) + chunk.indices.capacity() * sizeof(uint16_t);
+	return bytes;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "InstanceBatch.h"
+#include "MeshBuilder.h"
+#include "RenderBackend.h"
+#include "TransformBatch.h"
+
+namespace DirectX11_Game
+{
+	//The whole grid as plain pre-transformed triangles, for when nothing on it
+	//has moved for a while. Every cell's copy of the mesh is multiplied out once
+	//into large vertex and index buffers, so a still grid goes out in a handful
+	//of DrawIndexed calls with no per cube constants or instance stream.
+	//
+	//Chunks hold at most MAX_CHUNK_VERTICES vertices so their indices stay 16
+	//bit. The bake is thrown away as soon as a step moves any cell, which covers
+	//the camera, scale and mode too since those rebuild the whole grid.
+	class StaticGridBake
+	{
+	public:
+		static const int MAX_CHUNK_VERTICES = 0x10000;
+		//about 100MB of vertices, past that it isn't worth the memory
+		static const int MAX_VERTICES = 1 << 22;
+		//steps the grid has to stay still first, a short pause between inputs isn't worth a bake
+		static const int STILL_STEPS = 30;
+
+		struct Chunk
+		{
+			int firstCell;
+			int cellCount;
+			int indexCount;
+			//emptied by ReleaseGeometry once the device has its own copy
+			std::vector<MeshVertex> vertices;
+			std::vector<uint16_t> indices;
+			//the device copies, set by whoever owns them
+			void* vertexBuffer;
+			void* indexBuffer;
+		};
+
+		StaticGridBake();
+
+		//the mesh every cell is a copy of, drops the bake
+		void SetMesh(const Mesh& mesh);
+
+		//Call with every frame before drawing. Drops the bake when a step has
+		//moved anything since it was made, and returns true once the grid has
+		//been still for STILL_STEPS.
+		// lastChangedSequence	- the newest step that changed any cell
+		bool Track(int sequence, int lastChangedSequence);
+		//fewer draws than the live path took, and small enough to hold
+		bool IsWorthBaking(int cellCount, int liveDrawCalls) const;
+		void Clear();
+
+		//bakes the grid a run of cells at a time, in cell order from 0
+		void Begin();
+		void Add(const TransformBatch::Inputs& transforms, int count);
+		void End();
+
+		bool IsBaked() const { return m_baked; }
+		int GetChunkCount() const { return static_cast<int>(m_chunks.size()); }
+		Chunk& GetChunk(int chunk) { return m_chunks[chunk]; }
+		const Chunk& GetChunk(int chunk) const { return m_chunks[chunk]; }
+		//the chunks a grid of this size would bake into
+		int GetChunkCountFor(int cellCount) const;
+		int GetCellsPerChunk() const { return m_cellsPerChunk; }
+
+		//frees the cpu side of every chunk, the counts and buffers stay
+		void ReleaseGeometry();
+
+		//binds the non instanced pipeline with an identity model and draws every chunk
+		void Submit(RenderBackend& backend, const InstanceDrawBindings& bindings) const;
+
+		double GetBakeMilliseconds() const { return m_bakeMilliseconds; }
+		int GetBakeCount() const { return m_bakeCount; }
+		size_t GetMemoryBytes() const;
+
+	private:
+		Chunk& NextChunk();
+
+		Mesh m_mesh;
+		int m_cellsPerChunk;
+		std::vector<Chunk> m_chunks;
+		//matrices for one run of cells, reused between Add calls
+		std::vector<SimMath::Float4x4> m_models;
+
+		bool m_baked;
+		int m_cellCount;
+		//the step that last changed anything, when the bake was made and as of the last Track
+		int m_bakedChange;
+		int m_lastChange;
+
+		double m_bakeMilliseconds;
+		int m_bakeCount;
+		std::chrono::steady_clock::time_point m_bakeStart;
+	};
+}
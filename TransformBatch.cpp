@@ -0,0 +1,257 @@
+﻿#include "TransformBatch.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRANSFORM_BATCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+namespace
+{
+	//Multiplying T * R * S out leaves a lot of 0 * x + y terms behind. They never
+	//change a value, but they do turn a -0 into +0, so every entry that came out
+	//of a sum gets + 0.0f here to keep the bits the same as the matrix path.
+	inline void BuildCell(float x, float y, float z, float yaw, float scale, Float4x4* transposed)
+	{
+		float sine, cosine;
+		ScalarSinCos(&sine, &cosine, yaw);
+
+		//Translation * RotationY, the rows that are not just 0 and 1
+		float rotatedCos = cosine + 0.0f;
+		float rotatedSin = sine + 0.0f;
+		float rotatedNegSin = -sine + 0.0f;
+		float translateX = (x * cosine + z * sine) + 0.0f;
+		float translateY = y + 0.0f;
+		float translateZ = (x * -sine + z * cosine) + 0.0f;
+
+		//then the uniform scale, written out already transposed
+		float* out = &transposed->m[0][0];
+		out[0] = rotatedCos * scale + 0.0f;
+		out[1] = 0.0f;
+		out[2] = rotatedSin * scale + 0.0f;
+		out[3] = translateX * scale + 0.0f;
+
+		out[4] = 0.0f;
+		out[5] = scale + 0.0f;
+		out[6] = 0.0f;
+		out[7] = translateY * scale + 0.0f;
+
+		out[8] = rotatedNegSin * scale + 0.0f;
+		out[9] = 0.0f;
+		out[10] = out[0];
+		out[11] = translateZ * scale + 0.0f;
+
+		out[12] = 0.0f;
+		out[13] = 0.0f;
+		out[14] = 0.0f;
+		out[15] = 1.0f;
+	}
+
+	inline void BuildCenter(float x, float y, float z, float yaw, float scale, float* centerX, float* centerY, float* centerZ)
+	{
+		float sine, cosine;
+		ScalarSinCos(&sine, &cosine, yaw);
+
+		*centerX = ((x * cosine + z * sine) + 0.0f) * scale + 0.0f;
+		*centerY = (y + 0.0f) * scale + 0.0f;
+		*centerZ = ((x * -sine + z * cosine) + 0.0f) * scale + 0.0f;
+	}
+
+#if defined(TRANSFORM_BATCH_SSE2)
+	inline __m128 Select(__m128 mask, __m128 whenSet, __m128 whenClear)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, whenSet), _mm_andnot_ps(mask, whenClear));
+	}
+
+	//ScalarSinCos four lanes at a time, the branches become selects and the
+	//operations run in the same order so every lane matches the scalar result
+	inline void SinCos4(__m128 value, __m128* sinOut, __m128* cosOut)
+	{
+		__m128 quotient = _mm_mul_ps(_mm_set1_ps(ONE_DIV_TWO_PI), value);
+		__m128 rounding = Select(_mm_cmpge_ps(value, _mm_setzero_ps()), _mm_set1_ps(0.5f), _mm_set1_ps(-0.5f));
+		quotient = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(quotient, rounding)));
+		__m128 y = _mm_sub_ps(value, _mm_mul_ps(_mm_set1_ps(TWO_PI), quotient));
+
+		__m128 above = _mm_cmpgt_ps(y, _mm_set1_ps(PI_DIV_TWO));
+		__m128 below = _mm_cmplt_ps(y, _mm_set1_ps(-PI_DIV_TWO));
+		y = Select(above, _mm_sub_ps(_mm_set1_ps(PI), y), Select(below, _mm_sub_ps(_mm_set1_ps(-PI), y), y));
+		__m128 sign = Select(_mm_or_ps(above, below), _mm_set1_ps(-1.0f), _mm_set1_ps(1.0f));
+
+		__m128 y2 = _mm_mul_ps(y, y);
+
+		__m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-2.3889859e-08f), y2), _mm_set1_ps(2.7525562e-06f));
+		s = _mm_sub_ps(_mm_mul_ps(s, y2), _mm_set1_ps(0.00019840874f));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(0.0083333310f));
+		s = _mm_sub_ps(_mm_mul_ps(s, y2), _mm_set1_ps(0.16666667f));
+		s = _mm_add_ps(_mm_mul_ps(s, y2), _mm_set1_ps(1.0f));
+		*sinOut = _mm_mul_ps(s, y);
+
+		__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-2.6051615e-07f), y2), _mm_set1_ps(2.4760495e-05f));
+		p = _mm_sub_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.0013888378f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.041666638f));
+		p = _mm_sub_ps(_mm_mul_ps(p, y2), _mm_set1_ps(0.5f));
+		p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(1.0f));
+		*cosOut = _mm_mul_ps(sign, p);
+	}
+
+	//four cells from lanes of x, y, z, yaw and scale, same steps as BuildCell
+	inline void BuildCells4(__m128 x, __m128 y, __m128 z, __m128 yaw, __m128 scale, Float4x4* transposed)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 sine, cosine;
+		SinCos4(yaw, &sine, &cosine);
+		__m128 negSine = _mm_xor_ps(sine, _mm_set1_ps(-0.0f));
+
+		__m128 rotatedCos = _mm_add_ps(cosine, zero);
+		__m128 rotatedSin = _mm_add_ps(sine, zero);
+		__m128 rotatedNegSin = _mm_add_ps(negSine, zero);
+		__m128 translateX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, cosine), _mm_mul_ps(z, sine)), zero);
+		__m128 translateY = _mm_add_ps(y, zero);
+		__m128 translateZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, negSine), _mm_mul_ps(z, cosine)), zero);
+
+		__m128 m00 = _mm_add_ps(_mm_mul_ps(rotatedCos, scale), zero);
+		__m128 m02 = _mm_add_ps(_mm_mul_ps(rotatedSin, scale), zero);
+		__m128 m03 = _mm_add_ps(_mm_mul_ps(translateX, scale), zero);
+		__m128 m11 = _mm_add_ps(scale, zero);
+		__m128 m13 = _mm_add_ps(_mm_mul_ps(translateY, scale), zero);
+		__m128 m20 = _mm_add_ps(_mm_mul_ps(rotatedNegSin, scale), zero);
+		__m128 m23 = _mm_add_ps(_mm_mul_ps(translateZ, scale), zero);
+
+		//each set of lanes is one entry for four cells, turn them into one row per cell
+		__m128 row0[4] = { m00, zero, m02, m03 };
+		__m128 row1[4] = { zero, m11, zero, m13 };
+		__m128 row2[4] = { m20, zero, m00, m23 };
+		_MM_TRANSPOSE4_PS(row0[0], row0[1], row0[2], row0[3]);
+		_MM_TRANSPOSE4_PS(row1[0], row1[1], row1[2], row1[3]);
+		_MM_TRANSPOSE4_PS(row2[0], row2[1], row2[2], row2[3]);
+
+		const __m128 row3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			_mm_storeu_ps(transposed[lane].m[0], row0[lane]);
+			_mm_storeu_ps(transposed[lane].m[1], row1[lane]);
+			_mm_storeu_ps(transposed[lane].m[2], row2[lane]);
+			_mm_storeu_ps(transposed[lane].m[3], row3);
+		}
+	}
+
+	inline void BuildCenters4(__m128 x, __m128 y, __m128 z, __m128 yaw, __m128 scale, float* centerX, float* centerY, float* centerZ)
+	{
+		const __m128 zero = _mm_setzero_ps();
+
+		__m128 sine, cosine;
+		SinCos4(yaw, &sine, &cosine);
+		__m128 negSine = _mm_xor_ps(sine, _mm_set1_ps(-0.0f));
+
+		__m128 translateX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, cosine), _mm_mul_ps(z, sine)), zero);
+		__m128 translateY = _mm_add_ps(y, zero);
+		__m128 translateZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, negSine), _mm_mul_ps(z, cosine)), zero);
+
+		_mm_storeu_ps(centerX, _mm_add_ps(_mm_mul_ps(translateX, scale), zero));
+		_mm_storeu_ps(centerY, _mm_add_ps(_mm_mul_ps(translateY, scale), zero));
+		_mm_storeu_ps(centerZ, _mm_add_ps(_mm_mul_ps(translateZ, scale), zero));
+	}
+#endif
+}
+
+void TransformBatch::Build(const Inputs& inputs, int count, Float4x4* transposed)
+{
+	int i = 0;
+
+#if defined(TRANSFORM_BATCH_SSE2)
+	__m128 uniformScale = _mm_set1_ps(inputs.uniformScale);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 scale = inputs.scale ? _mm_loadu_ps(inputs.scale + i) : uniformScale;
+		BuildCells4(
+			_mm_loadu_ps(inputs.x + i),
+			_mm_loadu_ps(inputs.y + i),
+			_mm_loadu_ps(inputs.z + i),
+			_mm_loadu_ps(inputs.yaw + i),
+			scale,
+			transposed + i);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float scale = inputs.scale ? inputs.scale[i] : inputs.uniformScale;
+		BuildCell(inputs.x[i], inputs.y[i], inputs.z[i], inputs.yaw[i], scale, &transposed[i]);
+	}
+}
+
+void TransformBatch::BuildScalar(const Inputs& inputs, int count, Float4x4* transposed)
+{
+	for (int i = 0; i < count; i++)
+	{
+		float scale = inputs.scale ? inputs.scale[i] : inputs.uniformScale;
+		BuildCell(inputs.x[i], inputs.y[i], inputs.z[i], inputs.yaw[i], scale, &transposed[i]);
+	}
+}
+
+void TransformBatch::Expand(const CompactInstance* instances, int count, Float4x4* transposed)
+{
+	for (int i = 0; i < count; i++)
+	{
+		const CompactInstance& instance = instances[i];
+		BuildCell(instance.x, instance.y, instance.z, instance.yaw, instance.scale, &transposed[i]);
+	}
+}
+
+void TransformBatch::BuildCenters(const Inputs& inputs, int count, float* centerX, float* centerY, float* centerZ)
+{
+	int i = 0;
+
+#if defined(TRANSFORM_BATCH_SSE2)
+	__m128 uniformScale = _mm_set1_ps(inputs.uniformScale);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 scale = inputs.scale ? _mm_loadu_ps(inputs.scale + i) : uniformScale;
+		BuildCenters4(
+			_mm_loadu_ps(inputs.x + i),
+			_mm_loadu_ps(inputs.y + i),
+			_mm_loadu_ps(inputs.z + i),
+			_mm_loadu_ps(inputs.yaw + i),
+			scale,
+			centerX + i, centerY + i, centerZ + i);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float scale = inputs.scale ? inputs.scale[i] : inputs.uniformScale;
+		BuildCenter(inputs.x[i], inputs.y[i], inputs.z[i], inputs.yaw[i], scale, &centerX[i], &centerY[i], &centerZ[i]);
+	}
+}
+
+Float4x4 TransformBatch::BuildReference(float x, float y, float z, float yaw, float scale)
+{
+	return MatrixTranspose(
+		MatrixTranslation(x, y, z) *
+		MatrixRotationY(yaw) *
+		MatrixScaling(scale, scale, scale));
+}
+
+void TransformChunk::Resize(int firstCellIndex, int cellCount)
+{
+	firstCell = firstCellIndex;
+	x.resize(cellCount);
+	y.resize(cellCount);
+	z.resize(cellCount);
+	yaw.resize(cellCount);
+}
+
+TransformBatch::Inputs TransformChunk::GetInputs(float uniformScale) const
+{
+	TransformBatch::Inputs inputs;
+	inputs.x = x.data();
+	inputs.y = y.data();
+	inputs.z = z.data();
+	inputs.yaw = yaw.data();
+	inputs.scale = nullptr;
+	inputs.uniformScale = uniformScale;
+	return inputs;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include "SimMath.h"
+
+namespace DirectX11_Game
+{
+	//Position, yaw and scale for one cube, the whole transform in 20 bytes
+	//rather than a 64 byte matrix. Expanded in the compact instanced shader.
+	struct CompactInstance
+	{
+		float x;
+		float y;
+		float z;
+		float yaw;
+		float scale;
+	};
+
+	//A run of consecutive cells, end is one past the last.
+	struct CellRange
+	{
+		int begin;
+		int end;
+	};
+
+	//Builds the transposed Translation * RotationY * Scaling matrix for a batch
+	//of cells straight from structure of arrays input, without the three full
+	//matrices and two multiplies per cell. The results are bit for bit the same
+	//as multiplying the matrices out with SimMath, down to the sign of zeros.
+	class TransformBatch
+	{
+	public:
+		struct Inputs
+		{
+			const float* x;
+			const float* y;
+			const float* z;
+			const float* yaw;
+			//per cell scale, when null every cell uses uniformScale
+			const float* scale;
+			float uniformScale;
+		};
+
+		//uses sse2 four cells at a time where available
+		static void Build(const Inputs& inputs, int count, SimMath::Float4x4* transposed);
+		static void BuildScalar(const Inputs& inputs, int count, SimMath::Float4x4* transposed);
+
+		static void Expand(const CompactInstance* instances, int count, SimMath::Float4x4* transposed);
+
+		//only the world position of each cell's origin, the translation column of
+		//the matrix Build would write, for the culling bounds
+		static void BuildCenters(const Inputs& inputs, int count, float* centerX, float* centerY, float* centerZ);
+
+		//the matrix path this replaces, kept as the reference for the benchmark
+		static SimMath::Float4x4 BuildReference(float x, float y, float z, float yaw, float scale);
+	};
+
+	//Position and yaw for a run of cells starting at firstCell, each in its own
+	//array, so a large grid can be held as several of these rather than one block.
+	struct TransformChunk
+	{
+		int firstCell;
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> yaw;
+
+		int GetCellCount() const { return static_cast<int>(x.size()); }
+		void Resize(int firstCellIndex, int cellCount);
+		TransformBatch::Inputs GetInputs(float uniformScale) const;
+		size_t GetMemoryBytes() const { return x.capacity() * sizeof(float) * 4; }
+	};
+}
@@ -0,0 +1,110 @@
+﻿//Microbenchmark for the per-cell transform, runs the same grid through the old
+//matrix multiply path and each TransformBatch path, checks every result against
+//the matrix path and reports cells per second.
+//
+//	TransformBench [--grid side] [--repeat count]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "TransformBatch.h"
+
+using namespace DirectX11_Game;
+using namespace DirectX11_Game::SimMath;
+
+int main(int argc, char** argv)
+{
+	int gridSide = 512;
+	int repeat = 20;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--grid") == 0)
+			gridSide = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--repeat") == 0)
+			repeat = atoi(argv[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (gridSide < 4 || repeat < 1)
+	{
+		fprintf(stderr, "grid must be at least 4 and repeat at least 1\n");
+		return 1;
+	}
+
+	//a centered grid with a height and spin that change from cell to cell, like the rotating modes
+	int halfSide = gridSide >> 1;
+	int cells = gridSide * gridSide;
+	float scale = 0.1f;
+	std::vector<float> x(cells);
+	std::vector<float> y(cells);
+	std::vector<float> z(cells);
+	std::vector<float> yaw(cells);
+	std::vector<CompactInstance> compact(cells);
+	for (int i = 0; i < cells; i++)
+	{
+		x[i] = static_cast<float>((i % gridSide) - halfSide);
+		z[i] = static_cast<float>((i / gridSide) - halfSide);
+		y[i] = (x[i] * z[i]) / cells;
+		yaw[i] = ConvertToRadians(x[i] * 7 + z[i] * 3);
+		compact[i] = { x[i], y[i], z[i], yaw[i], scale };
+	}
+
+	std::vector<Float4x4> expected(cells);
+	std::vector<Float4x4> models(cells);
+	TransformBatch::Inputs inputs = { x.data(), y.data(), z.data(), yaw.data(), nullptr, scale };
+
+	printf("grid %d x %d\n", gridSide, gridSide);
+	printf("%-8s %14s %10s %s\n", "path", "cells/sec", "speedup", "result");
+
+	enum Path { Matrix, Scalar, Batched, Compact, PathCount };
+	static const char* names[PathCount] = { "matrix", "scalar", "batched", "compact" };
+
+	double matrixRate = 0;
+	int failures = 0;
+	for (int path = Matrix; path < PathCount; path++)
+	{
+		Float4x4* out = path == Matrix ? expected.data() : models.data();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeat; r++)
+		{
+			switch (path)
+			{
+			case Matrix:
+				for (int i = 0; i < cells; i++)
+					out[i] = TransformBatch::BuildReference(x[i], y[i], z[i], yaw[i], scale);
+				break;
+			case Scalar:
+				TransformBatch::BuildScalar(inputs, cells, out);
+				break;
+			case Batched:
+				TransformBatch::Build(inputs, cells, out);
+				break;
+			case Compact:
+				TransformBatch::Expand(compact.data(), cells, out);
+				break;
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool matches = path == Matrix || memcmp(models.data(), expected.data(), sizeof(Float4x4) * cells) == 0;
+		if (!matches)
+			failures++;
+
+		double rate = static_cast<double>(cells) * repeat / seconds;
+		if (path == Matrix)
+			matrixRate = rate;
+
+		printf("%-8s %14.0f %9.2fx %s\n", names[path], rate, rate / matrixRate, matches ? "exact" : "MISMATCH");
+	}
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace DirectX11_Game
+{
+	//Hands whole values from one writer thread to one reader thread without either
+	//waiting on the other. The writer fills GetBack and publishes it, the reader
+	//takes the newest published value with Acquire and reads it through GetFront
+	//until it acquires again. Values published in between are skipped, never torn.
+	//
+	//Three slots, one each for the writer and the reader and one in the middle
+	//being handed over. Publish and Acquire swap their slot with the middle one.
+	template<class T>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer() : m_middle(2), m_back(0), m_front(1) {}
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+		//writer only, holds whatever was published two or more times ago
+		T& GetBack() { return m_slots[m_back]; }
+		void Publish()
+		{
+			uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_back | FRESH), std::memory_order_acq_rel);
+			m_back = previous & INDEX;
+		}
+
+		//reader only, false when nothing new has been published since the last call
+		bool Acquire()
+		{
+			if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+				return false;
+			uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+			m_front = previous & INDEX;
+			return true;
+		}
+		const T& GetFront() const { return m_slots[m_front]; }
+
+	private:
+		static const uint8_t INDEX = 3;
+		static const uint8_t FRESH = 4;
+
+		T m_slots[3];
+		//slot index in the low bits, FRESH once published and until acquired
+		std::atomic<uint8_t> m_middle;
+		uint8_t m_back;
+		uint8_t m_front;
+	};
+}
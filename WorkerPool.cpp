@@ -0,0 +1,220 @@
+﻿#include "WorkerPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace DirectX11_Game;
+
+namespace
+{
+	uint64_t PackRange(uint32_t begin, uint32_t end)
+	{
+		return static_cast<uint64_t>(begin) | (static_cast<uint64_t>(end) << 32);
+	}
+
+	uint32_t RangeBegin(uint64_t range)
+	{
+		return static_cast<uint32_t>(range);
+	}
+
+	uint32_t RangeEnd(uint64_t range)
+	{
+		return static_cast<uint32_t>(range >> 32);
+	}
+}
+
+WorkerPool::WorkerPool(int workerCount) :
+	m_generation(0),
+	m_running(0),
+	m_stopping(false),
+	m_function(nullptr),
+	m_context(nullptr),
+	m_count(0),
+	m_blockSize(1),
+	m_stolenBlocks(0)
+{
+	StartThreads(workerCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+	StopThreads();
+}
+
+void WorkerPool::SetWorkerCount(int workerCount)
+{
+	if (workerCount < 0)
+		workerCount = 0;
+	if (workerCount == GetWorkerCount())
+		return;
+
+	StopThreads();
+	StartThreads(workerCount);
+}
+
+void WorkerPool::StartThreads(int workerCount)
+{
+	//slot 0 belongs to the calling thread
+	m_ranges.reset(new BlockRange[workerCount + 1]);
+	for (int i = 0; i <= workerCount; i++)
+		m_ranges[i].range.store(0, std::memory_order_relaxed);
+
+	m_stopping = false;
+	m_threads.reserve(workerCount);
+	for (int i = 0; i < workerCount; i++)
+		m_threads.push_back(std::thread(&WorkerPool::WorkerLoop, this, i + 1, m_generation));
+}
+
+void WorkerPool::StopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+	m_threads.clear();
+}
+
+void WorkerPool::Run(int count, int blockSize, TaskFunction function, void* context)
+{
+	if (count <= 0)
+		return;
+
+	blockSize = std::max(blockSize, 1);
+	int blocks = (count + blockSize - 1) / blockSize;
+	int participants = GetWorkerCount() + 1;
+
+	m_function = function;
+	m_context = context;
+	m_count = count;
+	m_blockSize = blockSize;
+	m_stolenBlocks.store(0, std::memory_order_relaxed);
+
+	//not worth waking anyone for a single block
+	if (participants == 1 || blocks == 1)
+	{
+		for (int block = 0; block < blocks; block++)
+			RunBlock(block);
+		return;
+	}
+
+	//even contiguous shares to start with, stealing evens out the rest
+	for (int p = 0; p < participants; p++)
+	{
+		uint32_t begin = static_cast<uint32_t>(static_cast<int64_t>(blocks) * p / participants);
+		uint32_t end = static_cast<uint32_t>(static_cast<int64_t>(blocks) * (p + 1) / participants);
+		m_ranges[p].range.store(PackRange(begin, end), std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = GetWorkerCount();
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	Participate(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_running == 0; });
+}
+
+//seenGeneration is passed in rather than read here, so a job started before the
+//thread gets going isn't missed
+void WorkerPool::WorkerLoop(int participant, uint64_t seenGeneration)
+{
+	std::string name = "worker " + std::to_string(participant);
+	PROFILE_THREAD_NAME(name.c_str());
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_stopping || m_generation != seenGeneration; });
+			if (m_stopping)
+				return;
+			seenGeneration = m_generation;
+		}
+
+		Participate(participant);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_running == 0)
+				m_done.notify_one();
+		}
+	}
+}
+
+//works through its own blocks, then steals until there is nothing left anywhere
+void WorkerPool::Participate(int participant)
+{
+	for (;;)
+	{
+		int block;
+		while (TakeOwnBlock(participant, block))
+			RunBlock(block);
+
+		if (!StealBlocks(participant))
+			return;
+	}
+}
+
+bool WorkerPool::TakeOwnBlock(int participant, int& block)
+{
+	std::atomic<uint64_t>& slot = m_ranges[participant].range;
+	uint64_t range = slot.load(std::memory_order_acquire);
+	for (;;)
+	{
+		uint32_t begin = RangeBegin(range);
+		uint32_t end = RangeEnd(range);
+		if (begin >= end)
+			return false;
+
+		if (slot.compare_exchange_weak(range, PackRange(begin + 1, end), std::memory_order_acq_rel))
+		{
+			block = static_cast<int>(begin);
+			return true;
+		}
+	}
+}
+
+//takes the back half of the first participant that still has blocks left
+bool WorkerPool::StealBlocks(int participant)
+{
+	int participants = GetWorkerCount() + 1;
+	for (int offset = 1; offset < participants; offset++)
+	{
+		int victim = (participant + offset) % participants;
+		std::atomic<uint64_t>& slot = m_ranges[victim].range;
+		uint64_t range = slot.load(std::memory_order_acquire);
+		for (;;)
+		{
+			uint32_t begin = RangeBegin(range);
+			uint32_t end = RangeEnd(range);
+			if (begin >= end)
+				break;
+
+			uint32_t take = (end - begin + 1) / 2;
+			if (slot.compare_exchange_weak(range, PackRange(begin, end - take), std::memory_order_acq_rel))
+			{
+				//our own slot is empty, so no one else is writing to it
+				m_ranges[participant].range.store(PackRange(end - take, end), std::memory_order_release);
+				m_stolenBlocks.fetch_add(static_cast<int>(take), std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void WorkerPool::RunBlock(int block)
+{
+	int begin = block * m_blockSize;
+	int end = std::min(begin + m_blockSize, m_count);
+	m_function(m_context, begin, end);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace DirectX11_Game
+{
+	//Persistent threads for splitting the grid update across cores. The threads
+	//are created once and sleep between jobs, so running a job never creates a
+	//thread or allocates. Each participant starts with an even share of the blocks
+	//and steals half of someone else's remaining blocks once its own run out.
+	class WorkerPool
+	{
+	public:
+		// workerCount	- threads besides the caller, 0 runs everything on the caller
+		WorkerPool(int workerCount = 0);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		//stops and restarts the threads, not meant to be called every frame
+		void SetWorkerCount(int workerCount);
+		int GetWorkerCount() const { return static_cast<int>(m_threads.size()); }
+
+		//calls task(begin, end) over [0, count) in blocks of blockSize and returns
+		//once every block has run, the caller works on blocks as well
+		template<typename Task>
+		void ParallelFor(int count, int blockSize, Task& task)
+		{
+			Run(count, blockSize, &RunTask<Task>, &task);
+		}
+
+		//blocks taken from another participant's share during the last job
+		int GetStolenBlocks() const { return m_stolenBlocks.load(std::memory_order_relaxed); }
+
+	private:
+		typedef void (*TaskFunction)(void* context, int begin, int end);
+
+		template<typename Task>
+		static void RunTask(void* context, int begin, int end)
+		{
+			(*static_cast<Task*>(context))(begin, end);
+		}
+
+		//one per participant, begin in the low 32 bits and end in the high 32 bits,
+		//padded so owners and thieves don't share a cache line
+		struct alignas(64) BlockRange
+		{
+			std::atomic<uint64_t> range;
+		};
+
+		void Run(int count, int blockSize, TaskFunction function, void* context);
+		void StartThreads(int workerCount);
+		void StopThreads();
+		void WorkerLoop(int participant, uint64_t seenGeneration);
+		void Participate(int participant);
+		bool TakeOwnBlock(int participant, int& block);
+		bool StealBlocks(int participant);
+		void RunBlock(int block);
+
+		std::vector<std::thread> m_threads;
+		std::unique_ptr<BlockRange[]> m_ranges;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		uint64_t m_generation;
+		int m_running;
+		bool m_stopping;
+
+		//the current job
+		TaskFunction m_function;
+		void* m_context;
+		int m_count;
+		int m_blockSize;
+		std::atomic<int> m_stolenBlocks;
+	};
+}